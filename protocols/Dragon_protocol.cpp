@@ -0,0 +1,416 @@
+#include "Dragon_protocol.h"
+#include "../sim/event_log.h"
+#include "../sim/mreq.h"
+#include "../sim/sim.h"
+#include "../sim/hash_table.h"
+
+/*************************
+ * Constructor/Destructor.
+ *************************/
+Dragon_protocol::Dragon_protocol (Hash_table *my_table)
+: Protocol (my_table)
+{
+    /** Updates are broadcast, a directory would have to forward each one.  */
+    if (sim->settings.dir_enabled)
+        fatal_error ("Dragon_protocol: update protocols need the bus, not dir_enabled\n");
+
+    this->initial_state = DRAGON_CACHE_I;
+}
+
+Dragon_protocol::~Dragon_protocol ()
+{
+}
+
+void Dragon_protocol::dump (Hash_entry *entry)
+{
+    const char *block_states[] = {"X","I","E","SC","SM","M", "IS", "IM", "SC_U", "SM_U", "UW", "MI_A", "II_A"};
+    sim->log->text (stderr, "Dragon_protocol - state: %s\n", block_states[entry->state]);
+}
+
+bool Dragon_protocol::is_stable (Hash_entry *entry)
+{
+    return (entry->state == DRAGON_CACHE_I ||
+            entry->state == DRAGON_CACHE_E ||
+            entry->state == DRAGON_CACHE_SC ||
+            entry->state == DRAGON_CACHE_SM ||
+            entry->state == DRAGON_CACHE_M);
+}
+
+bool Dragon_protocol::is_invalid (Hash_entry *entry)
+{
+    return entry->state == DRAGON_CACHE_I;
+}
+
+void Dragon_protocol::evict (Hash_entry *entry)
+{
+    switch (entry->state)
+    {
+        case DRAGON_CACHE_M:
+        case DRAGON_CACHE_SM:
+            send_PUT(PUTM, entry->tag);//memory is stale while there is an owner, the line goes back
+            entry->state = DRAGON_CACHE_MI_A;
+            break;
+        case DRAGON_CACHE_E:
+        case DRAGON_CACHE_SC:
+            entry->state = DRAGON_CACHE_I;//clean, memory or the owner still has it
+            break;
+        default:
+            fatal_error ("Dragon_protocol: cannot evict a line in state %d\n", entry->state);
+    }
+}
+
+void Dragon_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
+{
+    switch (entry->state)
+    {
+        case DRAGON_CACHE_I:  do_cache_I (entry, request); break;
+        case DRAGON_CACHE_E:  do_cache_E (entry, request); break;
+        case DRAGON_CACHE_SC: do_cache_SC (entry, request); break;
+        case DRAGON_CACHE_SM: do_cache_SM (entry, request); break;
+        case DRAGON_CACHE_M:  do_cache_M (entry, request); break;
+        case DRAGON_CACHE_IS:
+        case DRAGON_CACHE_IM:
+        case DRAGON_CACHE_SC_U:
+        case DRAGON_CACHE_SM_U:
+        case DRAGON_CACHE_UW:
+        request->print_msg (my_table->moduleID, "ERROR");
+        fatal_error("Should only have one outstanding request per processor!");
+            break;
+        default:
+            fatal_error ("Invalid Cache State for Dragon Protocol\n");
+            break;
+    }
+}
+
+void Dragon_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
+{
+    switch (entry->state) {
+        case DRAGON_CACHE_I:    do_snoop_I (entry, request); break;
+        case DRAGON_CACHE_E:    do_snoop_E (entry, request); break;
+        case DRAGON_CACHE_SC:   do_snoop_SC (entry, request); break;
+        case DRAGON_CACHE_SM:   do_snoop_SM (entry, request); break;
+        case DRAGON_CACHE_M:    do_snoop_M (entry, request); break;
+        case DRAGON_CACHE_IS:   do_snoop_IS (entry, request); break;
+        case DRAGON_CACHE_IM:   do_snoop_IM (entry, request); break;
+        case DRAGON_CACHE_SC_U: do_snoop_SC_U (entry, request); break;
+        case DRAGON_CACHE_SM_U: do_snoop_SM_U (entry, request); break;
+        case DRAGON_CACHE_UW:   do_snoop_UW (entry, request); break;
+        case DRAGON_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+        case DRAGON_CACHE_II_A: do_snoop_II_A (entry, request); break;
+        default:
+            fatal_error ("Invalid Cache State for Dragon Protocol!\n");
+    }
+}
+
+inline void Dragon_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+            send_GETS(request->addr);//send out a GETS and wait for data
+            entry->state = DRAGON_CACHE_IS;
+            sim->cache_misses++;
+            break;
+        case STORE:
+            send_GETS(request->addr);//no GETM in Dragon: read the line, then update any other copies
+            entry->state = DRAGON_CACHE_IM;
+            sim->cache_misses++;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: I State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_cache_E (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+            send_DATA_to_proc(request->addr);
+            break;
+        case STORE:
+            send_DATA_to_proc(request->addr);
+            entry->state = DRAGON_CACHE_M;//nobody else has it, nothing to tell them
+            sim->silent_upgrades++;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: E State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_cache_SC (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+            send_DATA_to_proc(request->addr);
+            break;
+        case STORE:
+            send_BUSUPD(request->addr);//the other copies take the word and we become the owner
+            entry->state = DRAGON_CACHE_SC_U;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SC State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_cache_SM (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+            send_DATA_to_proc(request->addr);
+            break;
+        case STORE:
+            send_BUSUPD(request->addr);//the other copies take the word
+            entry->state = DRAGON_CACHE_SM_U;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SM State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+        case STORE:
+            send_DATA_to_proc(request->addr);
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: M State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://not ours, nothing to do
+        case BUSUPD:
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: I State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_E (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();//clean, memory answers
+            entry->state = DRAGON_CACHE_SC;
+            break;
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: E State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_SC (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case BUSUPD:
+            set_shared_line();//take the new word, the writer is still not alone
+            break;
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SC State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_SM (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);//we own the line, memory is stale
+            break;
+        case BUSUPD:
+            set_shared_line();
+            entry->state = DRAGON_CACHE_SC;//the writer owns the line now
+            break;
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SM State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = DRAGON_CACHE_SM;//memory is not updated, we stay the owner
+            break;
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: M State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_IS (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://wait for data
+        case BUSUPD:
+            break;
+        case DATA:
+            send_DATA_to_proc(request->addr);
+            entry->state = get_shared_line() ? DRAGON_CACHE_SC : DRAGON_CACHE_E;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: IS State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://wait for data
+        case BUSUPD:
+            break;
+        case DATA:
+            if (get_shared_line())
+            {
+                send_BUSUPD(request->addr);//others have it, they take the word before the store is done
+                entry->state = DRAGON_CACHE_SC_U;
+            }
+            else
+            {
+                send_DATA_to_proc(request->addr);
+                entry->state = DRAGON_CACHE_M;
+            }
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: IM State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_SC_U (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case BUSUPD:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_WORD(request->addr);//our update is on the bus, drive the word
+                entry->state = DRAGON_CACHE_UW;
+            }
+            else
+                set_shared_line();//another store got there first, take its word
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SC_U State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_SM_U (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);//still the owner until our update goes
+            break;
+        case BUSUPD:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_WORD(request->addr);//our update is on the bus, drive the word
+                entry->state = DRAGON_CACHE_UW;
+            }
+            else
+            {
+                set_shared_line();
+                entry->state = DRAGON_CACHE_SC_U;//another store got there first and took ownership
+            }
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SM_U State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_UW (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case WORD:
+            send_DATA_to_proc(request->addr);
+            entry->state = get_shared_line() ? DRAGON_CACHE_SM : DRAGON_CACHE_M;//nobody took the word, stop updating
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: UW State shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still the owner, answer like SM
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            break;
+        case BUSUPD:
+            entry->state = DRAGON_CACHE_II_A;//the writer owns the line now, our PUT is stale
+            break;
+        case PUTM:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = DRAGON_CACHE_I;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void Dragon_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://someone else answers for the line now
+        case BUSUPD:
+            break;
+        case PUTM:
+            send_writeback(request->addr, false);//our stale PUT, tell memory there is nothing to write
+            entry->state = DRAGON_CACHE_I;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef _DRAGON_CACHE_H
+#define _DRAGON_CACHE_H
+
+#include "../sim/types.h"
+#include "../sim/enums.h"
+#include "../sim/module.h"
+#include "../sim/mreq.h"
+#include "protocol.h"
+
+/** Cache states.  SC and SM are shared clean and shared modified, the SM
+ *  copy owns the line and answers for it.  */
+typedef enum {
+    DRAGON_CACHE_I = 1,
+    DRAGON_CACHE_E,
+    DRAGON_CACHE_SC,
+    DRAGON_CACHE_SM,
+    DRAGON_CACHE_M,
+    DRAGON_CACHE_IS,
+    DRAGON_CACHE_IM,
+    DRAGON_CACHE_SC_U,
+    DRAGON_CACHE_SM_U,
+    DRAGON_CACHE_UW,
+    DRAGON_CACHE_MI_A,
+    DRAGON_CACHE_II_A
+} Dragon_cache_state_t;
+
+/** Update based: a store to a shared line sends the new word to the
+ *  other copies with a BUSUPD instead of invalidating them.  */
+class Dragon_protocol : public Protocol {
+public:
+    Dragon_protocol (Hash_table *my_table);
+    ~Dragon_protocol ();
+    
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
+    
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_E (Hash_entry *entry, Mreq *request);
+    inline void do_cache_SC (Hash_entry *entry, Mreq *request);
+    inline void do_cache_SM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
+    
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_E (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SC (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IS (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SC_U (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SM_U (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_UW (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
+    
+};
+
+#endif // _DRAGON_CACHE_H
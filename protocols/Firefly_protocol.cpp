@@ -0,0 +1,345 @@
+#include "Firefly_protocol.h"
+#include "../sim/event_log.h"
+#include "../sim/mreq.h"
+#include "../sim/sim.h"
+#include "../sim/hash_table.h"
+
+/*************************
+ * Constructor/Destructor.
+ *************************/
+Firefly_protocol::Firefly_protocol (Hash_table *my_table)
+: Protocol (my_table)
+{
+    /** Updates are broadcast, a directory would have to forward each one.  */
+    if (sim->settings.dir_enabled)
+        fatal_error ("Firefly_protocol: update protocols need the bus, not dir_enabled\n");
+
+    this->initial_state = FIREFLY_CACHE_I;
+}
+
+Firefly_protocol::~Firefly_protocol ()
+{
+}
+
+void Firefly_protocol::dump (Hash_entry *entry)
+{
+    const char *block_states[] = {"X","I","E","S","M", "IS", "IM", "S_U", "UW", "MI_A", "II_A"};
+    sim->log->text (stderr, "Firefly_protocol - state: %s\n", block_states[entry->state]);
+}
+
+bool Firefly_protocol::is_stable (Hash_entry *entry)
+{
+    return (entry->state == FIREFLY_CACHE_I ||
+            entry->state == FIREFLY_CACHE_E ||
+            entry->state == FIREFLY_CACHE_S ||
+            entry->state == FIREFLY_CACHE_M);
+}
+
+bool Firefly_protocol::is_invalid (Hash_entry *entry)
+{
+    return entry->state == FIREFLY_CACHE_I;
+}
+
+void Firefly_protocol::evict (Hash_entry *entry)
+{
+    switch (entry->state)
+    {
+        case FIREFLY_CACHE_M:
+            send_PUT(PUTM, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = FIREFLY_CACHE_MI_A;
+            break;
+        case FIREFLY_CACHE_E:
+        case FIREFLY_CACHE_S:
+            entry->state = FIREFLY_CACHE_I;//clean, every update went through to memory
+            break;
+        default:
+            fatal_error ("Firefly_protocol: cannot evict a line in state %d\n", entry->state);
+    }
+}
+
+void Firefly_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
+{
+    switch (entry->state)
+    {
+        case FIREFLY_CACHE_I:  do_cache_I (entry, request); break;
+        case FIREFLY_CACHE_E:  do_cache_E (entry, request); break;
+        case FIREFLY_CACHE_S:  do_cache_S (entry, request); break;
+        case FIREFLY_CACHE_M:  do_cache_M (entry, request); break;
+        case FIREFLY_CACHE_IS:
+        case FIREFLY_CACHE_IM:
+        case FIREFLY_CACHE_S_U:
+        case FIREFLY_CACHE_UW:
+        request->print_msg (my_table->moduleID, "ERROR");
+        fatal_error("Should only have one outstanding request per processor!");
+            break;
+        default:
+            fatal_error ("Invalid Cache State for Firefly Protocol\n");
+            break;
+    }
+}
+
+void Firefly_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
+{
+    switch (entry->state) {
+        case FIREFLY_CACHE_I:    do_snoop_I (entry, request); break;
+        case FIREFLY_CACHE_E:    do_snoop_E (entry, request); break;
+        case FIREFLY_CACHE_S:    do_snoop_S (entry, request); break;
+        case FIREFLY_CACHE_M:    do_snoop_M (entry, request); break;
+        case FIREFLY_CACHE_IS:   do_snoop_IS (entry, request); break;
+        case FIREFLY_CACHE_IM:   do_snoop_IM (entry, request); break;
+        case FIREFLY_CACHE_S_U:  do_snoop_S_U (entry, request); break;
+        case FIREFLY_CACHE_UW:   do_snoop_UW (entry, request); break;
+        case FIREFLY_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+        case FIREFLY_CACHE_II_A: do_snoop_II_A (entry, request); break;
+        default:
+            fatal_error ("Invalid Cache State for Firefly Protocol!\n");
+    }
+}
+
+inline void Firefly_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+            send_GETS(request->addr);//send out a GETS and wait for data
+            entry->state = FIREFLY_CACHE_IS;
+            sim->cache_misses++;
+            break;
+        case STORE:
+            send_GETS(request->addr);//no GETM in Firefly: read the line, then update any other copies
+            entry->state = FIREFLY_CACHE_IM;
+            sim->cache_misses++;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: I State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_cache_E (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+            send_DATA_to_proc(request->addr);
+            break;
+        case STORE:
+            send_DATA_to_proc(request->addr);
+            entry->state = FIREFLY_CACHE_M;//nobody else has it, nothing to tell them
+            sim->silent_upgrades++;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: E State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_cache_S (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+            send_DATA_to_proc(request->addr);
+            break;
+        case STORE:
+            send_BUSUPD(request->addr);//write through to memory and the other copies
+            entry->state = FIREFLY_CACHE_S_U;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: S State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
+{
+    switch (request->msg)
+    {
+        case LOAD:
+        case STORE:
+            send_DATA_to_proc(request->addr);
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: M State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://not ours, nothing to do
+        case BUSUPD:
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: I State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_E (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();//clean, memory answers
+            entry->state = FIREFLY_CACHE_S;
+            break;
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: E State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_S (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case BUSUPD:
+            set_shared_line();//take the new word, the writer is still not alone
+            break;
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: S State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);//memory picks the line up as it goes by
+            entry->state = FIREFLY_CACHE_S;
+            break;
+        case DATA:
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: M State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_IS (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://wait for data
+        case BUSUPD:
+            break;
+        case DATA:
+            send_DATA_to_proc(request->addr);
+            entry->state = get_shared_line() ? FIREFLY_CACHE_S : FIREFLY_CACHE_E;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: IS State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://wait for data
+        case BUSUPD:
+            break;
+        case DATA:
+            if (get_shared_line())
+            {
+                send_BUSUPD(request->addr);//others have it, write the store through to them
+                entry->state = FIREFLY_CACHE_S_U;
+            }
+            else
+            {
+                send_DATA_to_proc(request->addr);
+                entry->state = FIREFLY_CACHE_M;
+            }
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: IM State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_S_U (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case BUSUPD:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_WORD(request->addr);//our update is on the bus, drive the word
+                entry->state = FIREFLY_CACHE_UW;
+            }
+            else
+                set_shared_line();//another store got there first, take its word
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: S_U State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_UW (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case WORD:
+            send_DATA_to_proc(request->addr);
+            entry->state = get_shared_line() ? FIREFLY_CACHE_S : FIREFLY_CACHE_E;//memory has the word too, the line stays clean
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: UW State shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still dirty, answer like M
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = FIREFLY_CACHE_II_A;//memory took the line along with the reader, our PUT is stale
+            break;
+        case PUTM:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = FIREFLY_CACHE_I;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void Firefly_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://memory answers for the line now
+        case BUSUPD:
+            break;
+        case PUTM:
+            send_writeback(request->addr, false);//our stale PUT, tell memory there is nothing to write
+            entry->state = FIREFLY_CACHE_I;
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
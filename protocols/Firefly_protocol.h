@@ -0,0 +1,56 @@
+#ifndef _FIREFLY_CACHE_H
+#define _FIREFLY_CACHE_H
+
+#include "../sim/types.h"
+#include "../sim/enums.h"
+#include "../sim/module.h"
+#include "../sim/mreq.h"
+#include "protocol.h"
+
+/** Cache states.  S is always clean: updates to it go through to memory.  */
+typedef enum {
+    FIREFLY_CACHE_I = 1,
+    FIREFLY_CACHE_E,
+    FIREFLY_CACHE_S,
+    FIREFLY_CACHE_M,
+    FIREFLY_CACHE_IS,
+    FIREFLY_CACHE_IM,
+    FIREFLY_CACHE_S_U,
+    FIREFLY_CACHE_UW,
+    FIREFLY_CACHE_MI_A,
+    FIREFLY_CACHE_II_A
+} Firefly_cache_state_t;
+
+/** Update based: a store to a shared line is written through to memory
+ *  and to the other copies with a BUSUPD instead of invalidating them.  */
+class Firefly_protocol : public Protocol {
+public:
+    Firefly_protocol (Hash_table *my_table);
+    ~Firefly_protocol ();
+    
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
+    
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_E (Hash_entry *entry, Mreq *request);
+    inline void do_cache_S (Hash_entry *entry, Mreq *request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
+    
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_E (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_S (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IS (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_S_U (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_UW (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
+    
+};
+
+#endif // _FIREFLY_CACHE_H
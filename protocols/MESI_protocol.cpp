@@ -1,38 +1,69 @@
 #include "MESI_protocol.h"
+#include "../sim/event_log.h"
 #include "../sim/mreq.h"
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
-
 /*************************
  * Constructor/Destructor.
  *************************/
-MESI_protocol::MESI_protocol (Hash_table *my_table, Hash_entry *my_entry)
-: Protocol (my_table, my_entry)
+MESI_protocol::MESI_protocol (Hash_table *my_table)
+: Protocol (my_table)
 {
    
-    this->state = MESI_CACHE_I;
+    this->initial_state = MESI_CACHE_I;
 }
 
 MESI_protocol::~MESI_protocol ()
 {
 }
 
-void MESI_protocol::dump (void)
+void MESI_protocol::dump (Hash_entry *entry)
+{
+    const char *block_states[] = {"X","I","S","E","M", "IS", "IM", "SM", "MI_A", "EI_A", "SI_A", "II_A"};
+    sim->log->text (stderr, "MESI_protocol - state: %s\n", block_states[entry->state]);
+}
+
+bool MESI_protocol::is_stable (Hash_entry *entry)
+{
+    return (entry->state == MESI_CACHE_I ||
+            entry->state == MESI_CACHE_S ||
+            entry->state == MESI_CACHE_E ||
+            entry->state == MESI_CACHE_M);
+}
+
+bool MESI_protocol::is_invalid (Hash_entry *entry)
+{
+    return entry->state == MESI_CACHE_I;
+}
+
+void MESI_protocol::evict (Hash_entry *entry)
 {
-    const char *block_states[] = {"X","I","S","E","M", "IS", "IM", "SM"};
-    fprintf (stderr, "MESI_protocol - state: %s\n", block_states[state]);
+    switch (entry->state)
+    {
+        case MESI_CACHE_M:
+            send_PUT(PUTM, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MESI_CACHE_MI_A;
+            break;
+        case MESI_CACHE_E:
+            entry->state = send_PUT(PUTE, entry->tag) ? MESI_CACHE_EI_A : MESI_CACHE_I;//clean, only a directory needs telling
+            break;
+        case MESI_CACHE_S:
+            entry->state = send_PUT(PUTS, entry->tag) ? MESI_CACHE_SI_A : MESI_CACHE_I;//clean, only a directory needs telling
+            break;
+        default:
+            fatal_error ("MESI_protocol: cannot evict a line in state %d\n", entry->state);
+    }
 }
 
-void MESI_protocol::process_cache_request (Mreq *request)
+void MESI_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
 {
-    switch (state)
+    switch (entry->state)
     {
-        case MESI_CACHE_I:  do_cache_I (request); break;
-        case MESI_CACHE_S:  do_cache_S (request); break;
-        case MESI_CACHE_E:  do_cache_E (request); break;
-        case MESI_CACHE_M:  do_cache_M (request); break;
+        case MESI_CACHE_I:  do_cache_I (entry, request); break;
+        case MESI_CACHE_S:  do_cache_S (entry, request); break;
+        case MESI_CACHE_E:  do_cache_E (entry, request); break;
+        case MESI_CACHE_M:  do_cache_M (entry, request); break;
         case MESI_CACHE_IM:
         case MESI_CACHE_IS:
         case MESI_CACHE_SM:
@@ -45,34 +76,38 @@ void MESI_protocol::process_cache_request (Mreq *request)
     }
 }
 
-void MESI_protocol::process_snoop_request (Mreq *request)
+void MESI_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
 {
-    switch (state) {
-        case MESI_CACHE_I:  do_snoop_I (request); break;
-        case MESI_CACHE_S:  do_snoop_S (request); break;
-        case MESI_CACHE_E:  do_snoop_E (request); break;
-        case MESI_CACHE_M:  do_snoop_M (request); break;
-        case MESI_CACHE_IS:  do_snoop_IS (request); break;
-        case MESI_CACHE_IM:  do_snoop_IM (request); break;
-        case MESI_CACHE_SM:  do_snoop_SM (request); break;
+    switch (entry->state) {
+        case MESI_CACHE_I:  do_snoop_I (entry, request); break;
+        case MESI_CACHE_S:  do_snoop_S (entry, request); break;
+        case MESI_CACHE_E:  do_snoop_E (entry, request); break;
+        case MESI_CACHE_M:  do_snoop_M (entry, request); break;
+        case MESI_CACHE_IS:  do_snoop_IS (entry, request); break;
+        case MESI_CACHE_IM:  do_snoop_IM (entry, request); break;
+        case MESI_CACHE_SM:  do_snoop_SM (entry, request); break;
+        case MESI_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+        case MESI_CACHE_EI_A: do_snoop_EI_A (entry, request); break;
+        case MESI_CACHE_SI_A: do_snoop_SI_A (entry, request); break;
+        case MESI_CACHE_II_A: do_snoop_II_A (entry, request); break;
         default:
             fatal_error ("Invalid Cache State for MESI Protocol!\n");
     }
 }
 
-inline void MESI_protocol::do_cache_I (Mreq *request)
+inline void MESI_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
         case LOAD:
             send_GETS(request->addr);//send out a GETS and wait for data to come from memory
-            state = MESI_CACHE_IS;//go to transition state IS
-            Sim->cache_misses++; //we sent out a GETS. It's a cache miss,
+            entry->state = MESI_CACHE_IS;//go to transition state IS
+            sim->cache_misses++; //we sent out a GETS. It's a cache miss,
             break;
         case STORE:
             send_GETM(request->addr);//send out a GETM and wait for data
-            state = MESI_CACHE_IM;//go to transition state IM
-            Sim->cache_misses++;//It's a cache miss
+            entry->state = MESI_CACHE_IM;//go to transition state IM
+            sim->cache_misses++;//It's a cache miss
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -80,7 +115,7 @@ inline void MESI_protocol::do_cache_I (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_cache_S (Mreq *request)
+inline void MESI_protocol::do_cache_S (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -88,9 +123,9 @@ inline void MESI_protocol::do_cache_S (Mreq *request)
             send_DATA_to_proc(request->addr);//send data to proc
             break;
         case STORE:
-            send_GETM(request->addr);//from S we get a request to M. Send out a GETM
-            state = MESI_CACHE_SM;//go to transtion state
-            Sim->cache_misses++;//its a cache miss
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MESI_CACHE_SM;//go to transtion state
+            sim->cache_misses++;//its a cache miss
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -98,7 +133,7 @@ inline void MESI_protocol::do_cache_S (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_cache_E (Mreq *request)
+inline void MESI_protocol::do_cache_E (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -107,8 +142,8 @@ inline void MESI_protocol::do_cache_E (Mreq *request)
             break;
         case STORE:
             send_DATA_to_proc(request->addr);//send data to proc
-            state = MESI_CACHE_M;//go to M
-            Sim->silent_upgrades++;//it's a silent upgrade since other procs dont know about it.
+            entry->state = MESI_CACHE_M;//go to M
+            sim->silent_upgrades++;//it's a silent upgrade since other procs dont know about it.
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -116,7 +151,7 @@ inline void MESI_protocol::do_cache_E (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_cache_M (Mreq *request)
+inline void MESI_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -130,11 +165,12 @@ inline void MESI_protocol::do_cache_M (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_snoop_I (Mreq *request)
+inline void MESI_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS: // do nothing when snopping. Already in I. Dont care about signals
+        case UPGRADE:
         case GETM:
         case DATA:
             break;
@@ -144,15 +180,16 @@ inline void MESI_protocol::do_snoop_I (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_snoop_S (Mreq *request)
+inline void MESI_protocol::do_snoop_S (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
             set_shared_line(); //set shared line. We're not the only ones with the cache block.
             break;
+        case UPGRADE:
         case GETM:
-            state = MESI_CACHE_I;//WE see a GETM. Go to invalid
+            entry->state = MESI_CACHE_I;//WE see a GETM. Go to invalid
             break;
         case DATA:
             break;
@@ -162,19 +199,19 @@ inline void MESI_protocol::do_snoop_S (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_snoop_E (Mreq *request)
+inline void MESI_protocol::do_snoop_E (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
             set_shared_line();//set shared line. We're not the only ones with the cache block.
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MESI_CACHE_S;// Transition to S
+            entry->state = MESI_CACHE_S;// Transition to S
             break;
         case GETM:
             set_shared_line();//set shared line. We're not the only ones with the cache block.
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MESI_CACHE_I;//Transition to invalid
+            entry->state = MESI_CACHE_I;//Transition to invalid
             break;
         case DATA:
             break;
@@ -184,19 +221,24 @@ inline void MESI_protocol::do_snoop_E (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_snoop_M (Mreq *request)
+inline void MESI_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
+            if (send_DATA_migratory(request))
+            {
+                entry->state = MESI_CACHE_I;//migratory: the reader takes the line and will write it
+                break;
+            }
             set_shared_line();//set shared line. We're not the only ones with the cache block.
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MESI_CACHE_S;//Transition to shared state
+            entry->state = MESI_CACHE_S;//Transition to shared state
             break;
         case GETM:
             set_shared_line();//set shared line. We're not the only ones with the cache block.
             send_DATA_on_bus(request->addr,request->src_mid);//send data on bus. Save the other processor from going to main memory
-            state = MESI_CACHE_I;// it's a GETM. Go invalid
+            entry->state = MESI_CACHE_I;// it's a GETM. Go invalid
             break;
         case DATA:
             break;
@@ -206,22 +248,27 @@ inline void MESI_protocol::do_snoop_M (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_snoop_IS (Mreq *request)
+inline void MESI_protocol::do_snoop_IS (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://wait for data
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);//send data to proc no matter what we transition to
-            if (get_shared_line())//if shared line is set
+            if (request->migratory)
+            {
+                entry->state = MESI_CACHE_M;//handed over exclusively, and still dirty
+            }
+            else if (get_shared_line())//if shared line is set
             {
-                state = MESI_CACHE_S;//go to S state!
+                entry->state = MESI_CACHE_S;//go to S state!
             }
             else
             {
-                state = MESI_CACHE_E;//we are exclusive! since shared line is not set.
+                entry->state = MESI_CACHE_E;//we are exclusive! since shared line is not set.
             }
             break;
         default:
@@ -230,16 +277,17 @@ inline void MESI_protocol::do_snoop_IS (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_snoop_IM (Mreq *request)
+inline void MESI_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://wait for data
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MESI_CACHE_M;// WE finally go to M on getting the data from memory
+            entry->state = MESI_CACHE_M;// WE finally go to M on getting the data from memory
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -247,7 +295,7 @@ inline void MESI_protocol::do_snoop_IM (Mreq *request)
     }
 }
 
-inline void MESI_protocol::do_snoop_SM (Mreq *request)
+inline void MESI_protocol::do_snoop_SM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
@@ -255,12 +303,116 @@ inline void MESI_protocol::do_snoop_SM (Mreq *request)
             set_shared_line();//set the shared line. WE have th block now.
         case GETM:
             break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MESI_CACHE_M;
+            }
+            //else another core got the line first and ours went out as a GETM
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MESI_CACHE_M;
+            break;
         case DATA:
             send_DATA_to_proc(request->addr);//send data to proc
-            state = MESI_CACHE_M;//Go to M on getting data from memory!
+            entry->state = MESI_CACHE_M;//Go to M on getting data from memory!
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
             fatal_error ("Client: SM State shouldn't see this message\n");
     }
 }
+
+inline void MESI_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still ours and still dirty, answer like M
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            break;
+        case GETM:
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MESI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MESI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MESI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MESI_protocol::do_snoop_EI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://answer like E
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MESI_CACHE_SI_A;
+            break;
+        case GETM:
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MESI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MESI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: EI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MESI_protocol::do_snoop_SI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case UPGRADE:
+        case GETM:
+            entry->state = MESI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MESI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MESI_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://the line is gone, nothing to answer
+        case UPGRADE:
+        case GETM:
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, false);//our stale PUT, tell memory there is nothing to write
+            entry->state = MESI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MESI_CACHE_I;//directory mode: the home has caught the stale PUT
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
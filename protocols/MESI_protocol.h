@@ -15,32 +15,41 @@ typedef enum {
     MESI_CACHE_M,
     MESI_CACHE_IS,
     MESI_CACHE_IM,
-    MESI_CACHE_SM
+    MESI_CACHE_SM,
+    MESI_CACHE_MI_A,
+    MESI_CACHE_EI_A,
+    MESI_CACHE_SI_A,
+    MESI_CACHE_II_A
 } MESI_cache_state_t;
 
 class MESI_protocol : public Protocol {
 public:
-    MESI_protocol (Hash_table *my_table, Hash_entry *my_entry);
+    MESI_protocol (Hash_table *my_table);
     ~MESI_protocol ();
     
-    MESI_cache_state_t state;
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
     
-    void process_cache_request (Mreq *request);
-    void process_snoop_request (Mreq *request);
-    void dump (void);
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_S (Hash_entry *entry, Mreq *request);
+    inline void do_cache_E (Hash_entry *entry, Mreq *request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
     
-    inline void do_cache_I (Mreq *request);
-    inline void do_cache_S (Mreq *request);
-    inline void do_cache_E (Mreq *request);
-    inline void do_cache_M (Mreq *request);
-    
-    inline void do_snoop_I (Mreq *request);
-    inline void do_snoop_S (Mreq *request);
-    inline void do_snoop_E (Mreq *request);
-    inline void do_snoop_M (Mreq *request);
-    inline void do_snoop_IM (Mreq *request);
-    inline void do_snoop_SM (Mreq *request);
-    inline void do_snoop_IS (Mreq *request);
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_S (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_E (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IS (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_EI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
     
 };
 
@@ -1,57 +1,84 @@
  #include "MI_protocol.h"
+#include "../sim/event_log.h"
 #include "../sim/mreq.h"
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
-
 /*************************
  * Constructor/Destructor.
  *************************/
-MI_protocol::MI_protocol (Hash_table *my_table, Hash_entry *my_entry)
-    : Protocol (my_table, my_entry)
+MI_protocol::MI_protocol (Hash_table *my_table)
+    : Protocol (my_table)
 {
 	// Initialize lines to not have the data yet!
-    this->state = MI_CACHE_I;
+    this->initial_state = MI_CACHE_I;
 }
 
 MI_protocol::~MI_protocol ()
 {    
 }
 
-void MI_protocol::dump (void)
+void MI_protocol::dump (Hash_entry *entry)
 {
 	/* This is used to dump the cache state as debug information.  The block_states
 	 * variable should be the same size and order as the state enum in the header.
 	 */
-    const char *block_states[4] = {"X","I","IM","M"};
-    fprintf (stderr, "MI_protocol - state: %s\n", block_states[state]);
+    const char *block_states[6] = {"X","I","IM","M","MI_A","II_A"};
+    sim->log->text (stderr, "MI_protocol - state: %s\n", block_states[entry->state]);
+}
+
+bool MI_protocol::is_stable (Hash_entry *entry)
+{
+    return (entry->state == MI_CACHE_I ||
+            entry->state == MI_CACHE_M);
 }
 
-void MI_protocol::process_cache_request (Mreq *request)
+bool MI_protocol::is_invalid (Hash_entry *entry)
 {
-	switch (state)
+    return entry->state == MI_CACHE_I;
+}
+
+void MI_protocol::evict (Hash_entry *entry)
+{
+    switch (entry->state) {
+    case MI_CACHE_M:
+    	/* Our copy is the only one, so it has to go back to memory.  The line
+    	 * waits in the writeback buffer for the PUTM to come round on the bus.
+    	 */
+    	send_PUT(PUTM, entry->tag);
+    	entry->state = MI_CACHE_MI_A;
+    	break;
+    default:
+        fatal_error ("MI_protocol: cannot evict a line in state %d\n", entry->state);
+    }
+}
+
+void MI_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
+{
+	switch (entry->state)
     {
-    case MI_CACHE_I:  do_cache_I (request); break;
-    case MI_CACHE_IM: do_cache_IM (request); break;
-    case MI_CACHE_M:  do_cache_M (request); break;
+    case MI_CACHE_I:  do_cache_I (entry, request); break;
+    case MI_CACHE_IM: do_cache_IM (entry, request); break;
+    case MI_CACHE_M:  do_cache_M (entry, request); break;
     default:
         fatal_error ("MI_protocol->state not valid?\n");
     }
 }
 
-void MI_protocol::process_snoop_request (Mreq *request)
+void MI_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
 {
-	switch (state) {
-    case MI_CACHE_I:  do_snoop_I (request); break;
-    case MI_CACHE_IM: do_snoop_IM (request); break;
-    case MI_CACHE_M:  do_snoop_M (request); break;
+	switch (entry->state) {
+    case MI_CACHE_I:  do_snoop_I (entry, request); break;
+    case MI_CACHE_IM: do_snoop_IM (entry, request); break;
+    case MI_CACHE_M:  do_snoop_M (entry, request); break;
+    case MI_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+    case MI_CACHE_II_A: do_snoop_II_A (entry, request); break;
     default:
         fatal_error ("MI_protocol->state not valid?\n");
     }
 }
 
-inline void MI_protocol::do_cache_I (Mreq *request)
+inline void MI_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg) {
     // If we get a request from the processor we need to get the data
@@ -62,9 +89,9 @@ inline void MI_protocol::do_cache_I (Mreq *request)
     	/* The IM state means that we have sent the GET message and we are now waiting
     	 * on DATA
     	 */
-    	state = MI_CACHE_IM;
+    	entry->state = MI_CACHE_IM;
     	/* This is a cache miss */
-    	Sim->cache_misses++;
+    	sim->cache_misses++;
     	break;
     default:
         request->print_msg (my_table->moduleID, "ERROR");
@@ -72,7 +99,7 @@ inline void MI_protocol::do_cache_I (Mreq *request)
     }
 }
 
-inline void MI_protocol::do_cache_IM (Mreq *request)
+inline void MI_protocol::do_cache_IM (Hash_entry *entry, Mreq *request)
 {
 	switch (request->msg) {
 	/* If the block is in the IM state that means it sent out a GET message
@@ -90,7 +117,7 @@ inline void MI_protocol::do_cache_IM (Mreq *request)
 	}
 }
 
-inline void MI_protocol::do_cache_M (Mreq *request)
+inline void MI_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg) {
     /* The M state means we have the data and we can modify it.  Therefore any request
@@ -108,7 +135,7 @@ inline void MI_protocol::do_cache_M (Mreq *request)
     }
 }
 
-inline void MI_protocol::do_snoop_I (Mreq *request)
+inline void MI_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
     case GETS:
@@ -126,7 +153,7 @@ inline void MI_protocol::do_snoop_I (Mreq *request)
     }
 }
 
-inline void MI_protocol::do_snoop_IM (Mreq *request)
+inline void MI_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
 {
 	switch (request->msg) {
 	case GETS:
@@ -148,7 +175,7 @@ inline void MI_protocol::do_snoop_IM (Mreq *request)
 		 * means here is whether a cache sent the data or the memory controller.
 		 */
 		send_DATA_to_proc(request->addr);
-		state = MI_CACHE_M;
+		entry->state = MI_CACHE_M;
 		if (get_shared_line())
 		{
 			// Nothing to do for MI protocol
@@ -160,7 +187,7 @@ inline void MI_protocol::do_snoop_IM (Mreq *request)
 	}
 }
 
-inline void MI_protocol::do_snoop_M (Mreq *request)
+inline void MI_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
     case GETS:
@@ -179,7 +206,7 @@ inline void MI_protocol::do_snoop_M (Mreq *request)
     	 */
     	set_shared_line();
     	send_DATA_on_bus(request->addr,request->src_mid);
-    	state = MI_CACHE_I;
+    	entry->state = MI_CACHE_I;
     	break;
     case DATA:
     	fatal_error ("Should not see data for this line!  I have the line!");
@@ -190,3 +217,51 @@ inline void MI_protocol::do_snoop_M (Mreq *request)
     }
 }
 
+inline void MI_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg) {
+    case GETS:
+    case GETM:
+    	/**
+    	 * Another cache asked for the line before our PUTM got the bus.  We
+    	 * still own it, so we answer just like M.  The PUTM is stale now and
+    	 * will carry nothing when it comes round.
+    	 */
+    	set_shared_line();
+    	send_DATA_on_bus(request->addr,request->src_mid);
+    	entry->state = MI_CACHE_II_A;
+    	break;
+    case PUTM:
+    	/** Our own PUTM, the line follows it to memory.  */
+    	send_writeback(request->addr, true);
+    	entry->state = MI_CACHE_I;
+    	break;
+    case ACK:
+    	/** Directory mode: the home has the line.  */
+    	entry->state = MI_CACHE_I;
+    	break;
+    default:
+        request->print_msg (my_table->moduleID, "ERROR");
+        fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MI_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg) {
+    case GETS:
+    case GETM:
+    	break;
+    case PUTM:
+    	/** Our stale PUTM, its data phase tells memory there is nothing to write.  */
+    	send_writeback(request->addr, false);
+    	entry->state = MI_CACHE_I;
+    	break;
+    case ACK:
+    	entry->state = MI_CACHE_I;
+    	break;
+    default:
+        request->print_msg (my_table->moduleID, "ERROR");
+        fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
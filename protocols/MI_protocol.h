@@ -12,33 +12,37 @@ typedef enum {
     MI_CACHE_I = 1,
     MI_CACHE_IM,
     MI_CACHE_M,
+    MI_CACHE_MI_A,
+    MI_CACHE_II_A,
 } MI_cache_state_t;
 
 class MI_protocol : public Protocol {
 public:
-    MI_protocol (Hash_table *my_table, Hash_entry *my_entry);
+    MI_protocol (Hash_table *my_table);
     ~MI_protocol ();
-
-    // Cache state for this line
-    MI_cache_state_t state;
     
-    void process_cache_request (Mreq *request);
-    void process_snoop_request (Mreq *request);
-    void dump (void);
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
 
     /* Functions that specify the actions to take on requests from the processor
      * when the cache is in various states
      */
-    inline void do_cache_I (Mreq *request);
-    inline void do_cache_IM (Mreq * request);
-    inline void do_cache_M (Mreq *request);
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_IM (Hash_entry *entry, Mreq * request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
 
     /* Functions that specify the actions to take on snooped requests
      * when the cache is in various states
      */
-    inline void do_snoop_I (Mreq *request);
-    inline void do_snoop_IM (Mreq * request);
-    inline void do_snoop_M (Mreq *request);
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IM (Hash_entry *entry, const Mreq * request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
 };
 
 #endif // _MI_CACHE_H
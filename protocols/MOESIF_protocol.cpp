@@ -1,38 +1,78 @@
 #include "MOESIF_protocol.h"
+#include "../sim/event_log.h"
 #include "../sim/mreq.h"
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
-
 /*************************
  * Constructor/Destructor.
  *************************/
-MOESIF_protocol::MOESIF_protocol (Hash_table *my_table, Hash_entry *my_entry)
-: Protocol (my_table, my_entry)
+MOESIF_protocol::MOESIF_protocol (Hash_table *my_table)
+: Protocol (my_table)
 {
-    this->state = MOESIF_CACHE_I;
+    this->initial_state = MOESIF_CACHE_I;
 }
 
 MOESIF_protocol::~MOESIF_protocol ()
 {
 }
 
-void MOESIF_protocol::dump (void)
+void MOESIF_protocol::dump (Hash_entry *entry)
+{
+    const char *block_states[] = {"X","I","S","E","O","M","F", "IM", "IS", "SM", "OM", "FM", "MI_A", "OI_A", "EI_A", "FI_A", "SI_A", "II_A"};
+    sim->log->text (stderr, "MOESIF_protocol - state: %s\n", block_states[entry->state]);
+}
+
+bool MOESIF_protocol::is_stable (Hash_entry *entry)
 {
-    const char *block_states[12] = {"X","I","S","E","O","M","F", "IM", "IS", "SM", "OM", "FM"};
-    fprintf (stderr, "MOESIF_protocol - state: %s\n", block_states[state]);
+    return (entry->state == MOESIF_CACHE_I ||
+            entry->state == MOESIF_CACHE_S ||
+            entry->state == MOESIF_CACHE_E ||
+            entry->state == MOESIF_CACHE_O ||
+            entry->state == MOESIF_CACHE_M ||
+            entry->state == MOESIF_CACHE_F);
 }
 
-void MOESIF_protocol::process_cache_request (Mreq *request)
+bool MOESIF_protocol::is_invalid (Hash_entry *entry)
 {
-    switch (state) {
-        case MOESIF_CACHE_F:  do_cache_F (request); break;
-        case MOESIF_CACHE_I:  do_cache_I (request); break;
-        case MOESIF_CACHE_E:  do_cache_E (request); break;
-        case MOESIF_CACHE_M:  do_cache_M (request); break;
-        case MOESIF_CACHE_S:  do_cache_S (request); break;
-        case MOESIF_CACHE_O:  do_cache_O (request); break;
+    return entry->state == MOESIF_CACHE_I;
+}
+
+void MOESIF_protocol::evict (Hash_entry *entry)
+{
+    switch (entry->state)
+    {
+        case MOESIF_CACHE_M:
+            send_PUT(PUTM, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MOESIF_CACHE_MI_A;
+            break;
+        case MOESIF_CACHE_O:
+            send_PUT(PUTO, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MOESIF_CACHE_OI_A;
+            break;
+        case MOESIF_CACHE_E:
+            entry->state = send_PUT(PUTE, entry->tag) ? MOESIF_CACHE_EI_A : MOESIF_CACHE_I;//clean, only a directory needs telling
+            break;
+        case MOESIF_CACHE_F:
+            entry->state = send_PUT(PUTS, entry->tag) ? MOESIF_CACHE_FI_A : MOESIF_CACHE_I;//clean, only a directory needs telling
+            break;
+        case MOESIF_CACHE_S:
+            entry->state = send_PUT(PUTS, entry->tag) ? MOESIF_CACHE_SI_A : MOESIF_CACHE_I;//clean, only a directory needs telling
+            break;
+        default:
+            fatal_error ("MOESIF_protocol: cannot evict a line in state %d\n", entry->state);
+    }
+}
+
+void MOESIF_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
+{
+    switch (entry->state) {
+        case MOESIF_CACHE_F:  do_cache_F (entry, request); break;
+        case MOESIF_CACHE_I:  do_cache_I (entry, request); break;
+        case MOESIF_CACHE_E:  do_cache_E (entry, request); break;
+        case MOESIF_CACHE_M:  do_cache_M (entry, request); break;
+        case MOESIF_CACHE_S:  do_cache_S (entry, request); break;
+        case MOESIF_CACHE_O:  do_cache_O (entry, request); break;
         case MOESIF_CACHE_OM:
         case MOESIF_CACHE_FM:
         case MOESIF_CACHE_IS:
@@ -45,38 +85,44 @@ void MOESIF_protocol::process_cache_request (Mreq *request)
     }
 }
 
-void MOESIF_protocol::process_snoop_request (Mreq *request)
+void MOESIF_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
 {
-    switch (state) {
-        case MOESIF_CACHE_I: do_snoop_I (request); break;
-        case MOESIF_CACHE_M: do_snoop_M (request); break;
-        case MOESIF_CACHE_S: do_snoop_S (request); break;
-        case MOESIF_CACHE_O: do_snoop_O (request); break;
-        case MOESIF_CACHE_E: do_snoop_E (request); break;
-        case MOESIF_CACHE_F: do_snoop_F (request); break;
-        case MOESIF_CACHE_IM: do_snoop_IM (request); break;
-        case MOESIF_CACHE_SM: do_snoop_SM (request); break;
-        case MOESIF_CACHE_OM: do_snoop_OM (request); break;
-        case MOESIF_CACHE_IS: do_snoop_IS (request); break;
-        case MOESIF_CACHE_FM: do_snoop_FM (request); break;
+    switch (entry->state) {
+        case MOESIF_CACHE_I: do_snoop_I (entry, request); break;
+        case MOESIF_CACHE_M: do_snoop_M (entry, request); break;
+        case MOESIF_CACHE_S: do_snoop_S (entry, request); break;
+        case MOESIF_CACHE_O: do_snoop_O (entry, request); break;
+        case MOESIF_CACHE_E: do_snoop_E (entry, request); break;
+        case MOESIF_CACHE_F: do_snoop_F (entry, request); break;
+        case MOESIF_CACHE_IM: do_snoop_IM (entry, request); break;
+        case MOESIF_CACHE_SM: do_snoop_SM (entry, request); break;
+        case MOESIF_CACHE_OM: do_snoop_OM (entry, request); break;
+        case MOESIF_CACHE_IS: do_snoop_IS (entry, request); break;
+        case MOESIF_CACHE_FM: do_snoop_FM (entry, request); break;
+        case MOESIF_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+        case MOESIF_CACHE_OI_A: do_snoop_OI_A (entry, request); break;
+        case MOESIF_CACHE_EI_A: do_snoop_EI_A (entry, request); break;
+        case MOESIF_CACHE_FI_A: do_snoop_FI_A (entry, request); break;
+        case MOESIF_CACHE_SI_A: do_snoop_SI_A (entry, request); break;
+        case MOESIF_CACHE_II_A: do_snoop_II_A (entry, request); break;
         default:
             fatal_error ("Invalid Cache State for MOESIF Protocol\n");
     }
 }
 
-inline void MOESIF_protocol::do_cache_I (Mreq *request)
+inline void MOESIF_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
 {   switch (request->msg)
     {
             
         case LOAD:
             send_GETS(request->addr);// send a GETS signal
-            state = MOESIF_CACHE_IS;//move to intermediate state
-            Sim->cache_misses++;//increment cache misses
+            entry->state = MOESIF_CACHE_IS;//move to intermediate state
+            sim->cache_misses++;//increment cache misses
             break;
         case STORE:
             send_GETM(request->addr);//send a GETM signal
-            state = MOESIF_CACHE_IM;//go to IM intermediate stage
-            Sim->cache_misses++;//increment cache misses
+            entry->state = MOESIF_CACHE_IM;//go to IM intermediate stage
+            sim->cache_misses++;//increment cache misses
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -85,7 +131,7 @@ inline void MOESIF_protocol::do_cache_I (Mreq *request)
     
 }
 
-inline void MOESIF_protocol::do_cache_S (Mreq *request)
+inline void MOESIF_protocol::do_cache_S (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -93,9 +139,9 @@ inline void MOESIF_protocol::do_cache_S (Mreq *request)
             send_DATA_to_proc(request->addr);//send data to proc on LOAD
             break;
         case STORE:
-            send_GETM(request->addr);//send a GETM signal
-            state = MOESIF_CACHE_SM;//go to intermediate state SM
-            Sim->cache_misses++;//increment cache misses
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MOESIF_CACHE_SM;//go to intermediate state SM
+            sim->cache_misses++;//increment cache misses
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -105,7 +151,7 @@ inline void MOESIF_protocol::do_cache_S (Mreq *request)
     
 }
 
-inline void MOESIF_protocol::do_cache_O (Mreq *request)
+inline void MOESIF_protocol::do_cache_O (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -114,9 +160,9 @@ inline void MOESIF_protocol::do_cache_O (Mreq *request)
             break;
         case STORE:
             //  flag =request->src_mid.nodeID;
-            send_GETM(request->addr);//send a GETM signal
-            state = MOESIF_CACHE_OM;
-            Sim->cache_misses++;
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MOESIF_CACHE_OM;
+            sim->cache_misses++;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -126,7 +172,7 @@ inline void MOESIF_protocol::do_cache_O (Mreq *request)
     
 }
 
-inline void MOESIF_protocol::do_cache_M (Mreq *request)
+inline void MOESIF_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -144,7 +190,7 @@ inline void MOESIF_protocol::do_cache_M (Mreq *request)
     
 }
 
-inline void MOESIF_protocol::do_cache_E (Mreq *request)
+inline void MOESIF_protocol::do_cache_E (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -153,8 +199,8 @@ inline void MOESIF_protocol::do_cache_E (Mreq *request)
             break;
         case STORE:
             send_DATA_to_proc(request->addr);
-            state = MOESIF_CACHE_M;// go to M state dorectly. It is a silent upgrade.
-            Sim->silent_upgrades++;//increment silent upgrades
+            entry->state = MOESIF_CACHE_M;// go to M state dorectly. It is a silent upgrade.
+            sim->silent_upgrades++;//increment silent upgrades
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -162,16 +208,16 @@ inline void MOESIF_protocol::do_cache_E (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_cache_F (Mreq *request)
+inline void MOESIF_protocol::do_cache_F (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg) {
         case LOAD:
             send_DATA_to_proc(request->addr);
             break;
         case STORE:
-            send_GETM(request->addr);//send out a getM signal
-            state = MOESIF_CACHE_FM;//go to intermediate state FM and wait for data
-            Sim->cache_misses++;
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MOESIF_CACHE_FM;//go to intermediate state FM and wait for data
+            sim->cache_misses++;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -180,11 +226,12 @@ inline void MOESIF_protocol::do_cache_F (Mreq *request)
 } 	
 
 
-inline void MOESIF_protocol::do_snoop_I (Mreq *request)
+inline void MOESIF_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://do nothing. Already in invalid state
+        case UPGRADE:
         case GETM:
         case DATA:
             break;
@@ -197,16 +244,17 @@ inline void MOESIF_protocol::do_snoop_I (Mreq *request)
 
 
 
-inline void MOESIF_protocol::do_snoop_IM (Mreq *request)
+inline void MOESIF_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOESIF_CACHE_M;
+            entry->state = MOESIF_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -214,19 +262,20 @@ inline void MOESIF_protocol::do_snoop_IM (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_IS (Mreq *request)
+inline void MOESIF_protocol::do_snoop_IS (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOESIF_CACHE_E;
+            entry->state = MOESIF_CACHE_E;
             if (get_shared_line())
             {
-                state = MOESIF_CACHE_S;
+                entry->state = MOESIF_CACHE_S;
             }
             break;
         default:
@@ -235,7 +284,7 @@ inline void MOESIF_protocol::do_snoop_IS (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_SM (Mreq *request)
+inline void MOESIF_protocol::do_snoop_SM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
@@ -244,9 +293,21 @@ inline void MOESIF_protocol::do_snoop_SM (Mreq *request)
             break;
         case GETM:
             break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MOESIF_CACHE_M;
+            }
+            //else another core got the line first and ours went out as a GETM
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MOESIF_CACHE_M;
+            break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOESIF_CACHE_M;
+            entry->state = MOESIF_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -254,7 +315,7 @@ inline void MOESIF_protocol::do_snoop_SM (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_OM (Mreq *request)
+inline void MOESIF_protocol::do_snoop_OM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
@@ -263,12 +324,25 @@ inline void MOESIF_protocol::do_snoop_OM (Mreq *request)
             send_DATA_on_bus(request->addr,request->src_mid);
             break;
         case GETM:
-            state=MOESIF_CACHE_IM;
+            entry->state=MOESIF_CACHE_IM;
             send_DATA_on_bus(request->addr,request->src_mid);
             break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MOESIF_CACHE_M;
+            }
+            else
+                entry->state = MOESIF_CACHE_IM;//another sharer upgraded first, it needs no data from us
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MOESIF_CACHE_M;
+            break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOESIF_CACHE_M;
+            entry->state = MOESIF_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -276,7 +350,7 @@ inline void MOESIF_protocol::do_snoop_OM (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_FM (Mreq *request)
+inline void MOESIF_protocol::do_snoop_FM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
@@ -285,12 +359,25 @@ inline void MOESIF_protocol::do_snoop_FM (Mreq *request)
             send_DATA_on_bus(request->addr,request->src_mid);
             break;
         case GETM:
-            state=MOESIF_CACHE_IM;
+            entry->state=MOESIF_CACHE_IM;
             send_DATA_on_bus(request->addr,request->src_mid);
             break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MOESIF_CACHE_M;
+            }
+            else
+                entry->state = MOESIF_CACHE_IM;//another sharer upgraded first, it needs no data from us
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MOESIF_CACHE_M;
+            break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOESIF_CACHE_M;
+            entry->state = MOESIF_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -298,16 +385,17 @@ inline void MOESIF_protocol::do_snoop_FM (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_S (Mreq *request)
+inline void MOESIF_protocol::do_snoop_S (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
             set_shared_line();//set shared line on seeing a GETS
-            state = MOESIF_CACHE_S;//transition to state S
+            entry->state = MOESIF_CACHE_S;//transition to state S
             break;
+        case UPGRADE:
         case GETM:
-            state = MOESIF_CACHE_I;//go invalid if somebody else wants to modify
+            entry->state = MOESIF_CACHE_I;//go invalid if somebody else wants to modify
             break;
         case DATA:
             fatal_error ("Should not see data for this line!  I have the line!");
@@ -318,18 +406,18 @@ inline void MOESIF_protocol::do_snoop_S (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_M (Mreq *request)
+inline void MOESIF_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
             set_shared_line();//set the shared line on seeing a GETS signal
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MOESIF_CACHE_O;//transition from M to owner state!
+            entry->state = MOESIF_CACHE_O;//transition from M to owner state!
             break;
         case GETM:
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MOESIF_CACHE_I;//go invalid if you see a GETM
+            entry->state = MOESIF_CACHE_I;//go invalid if you see a GETM
             break;
         case DATA:
             fatal_error ("Should not see data for this line!  I have the line!");
@@ -340,7 +428,7 @@ inline void MOESIF_protocol::do_snoop_M (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_O (Mreq *request)
+inline void MOESIF_protocol::do_snoop_O (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
@@ -350,7 +438,10 @@ inline void MOESIF_protocol::do_snoop_O (Mreq *request)
             break;
         case GETM:	
             send_DATA_on_bus(request->addr,request->src_mid);//send data on bus
-            state = MOESIF_CACHE_I;//go invalid if you a GETM
+            entry->state = MOESIF_CACHE_I;//go invalid if you a GETM
+            break;
+        case UPGRADE:
+            entry->state = MOESIF_CACHE_I;//the upgrading sharer has the data already
             break;
         case DATA:
             fatal_error ("Should not see data for this line!  I have the line!");
@@ -361,7 +452,7 @@ inline void MOESIF_protocol::do_snoop_O (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_F (Mreq *request)
+inline void MOESIF_protocol::do_snoop_F (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
@@ -371,7 +462,10 @@ inline void MOESIF_protocol::do_snoop_F (Mreq *request)
             break;
         case GETM:	
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MOESIF_CACHE_I;//go invalid on seeing GETM
+            entry->state = MOESIF_CACHE_I;//go invalid on seeing GETM
+            break;
+        case UPGRADE:
+            entry->state = MOESIF_CACHE_I;//the upgrading sharer has the data already
             break;
         case DATA:
             fatal_error ("Should not see data for this line!  I have the line!");
@@ -382,18 +476,18 @@ inline void MOESIF_protocol::do_snoop_F (Mreq *request)
     }
 }
 
-inline void MOESIF_protocol::do_snoop_E (Mreq *request)
+inline void MOESIF_protocol::do_snoop_E (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
             set_shared_line();//set ahred line on seeing GES
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MOESIF_CACHE_F;//become the forwarder if you have to share a block we were previously exclusive
+            entry->state = MOESIF_CACHE_F;//become the forwarder if you have to share a block we were previously exclusive
             break;
         case GETM:	
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MOESIF_CACHE_I;//go invalid on seeing a GETM
+            entry->state = MOESIF_CACHE_I;//go invalid on seeing a GETM
             break;
         case DATA:
             fatal_error ("Should not see data for this line!  I have the line!");
@@ -403,3 +497,147 @@ inline void MOESIF_protocol::do_snoop_E (Mreq *request)
             fatal_error ("Client: E state shouldn't see this message\n");
     }
 }
+
+inline void MOESIF_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still ours and still dirty, answer like M
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESIF_CACHE_OI_A;
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESIF_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MOESIF_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MOESIF_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESIF_protocol::do_snoop_OI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still the owner, answer like O
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESIF_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MOESIF_CACHE_I;
+            break;
+        case UPGRADE:
+            entry->state = MOESIF_CACHE_II_A;//the upgrading sharer has the data already
+            break;
+        case ACK:
+            entry->state = MOESIF_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: OI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESIF_protocol::do_snoop_EI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://answer like E
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESIF_CACHE_FI_A;
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESIF_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MOESIF_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: EI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESIF_protocol::do_snoop_FI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still the forwarder, answer like F
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESIF_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case UPGRADE:
+            entry->state = MOESIF_CACHE_II_A;//the upgrading sharer has the data already
+            break;
+        case ACK:
+            entry->state = MOESIF_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: FI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESIF_protocol::do_snoop_SI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case UPGRADE:
+        case GETM:
+            entry->state = MOESIF_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MOESIF_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESIF_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://the line is gone, nothing to answer
+        case UPGRADE:
+        case GETM:
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, false);//our stale PUT, tell memory there is nothing to write
+            entry->state = MOESIF_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MOESIF_CACHE_I;//directory mode: the home has caught the stale PUT
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
@@ -19,45 +19,58 @@ typedef enum {
     MOESIF_CACHE_IS,
     MOESIF_CACHE_SM,
     MOESIF_CACHE_OM,
-    MOESIF_CACHE_FM
+    MOESIF_CACHE_FM,
+    MOESIF_CACHE_MI_A,
+    MOESIF_CACHE_OI_A,
+    MOESIF_CACHE_EI_A,
+    MOESIF_CACHE_FI_A,
+    MOESIF_CACHE_SI_A,
+    MOESIF_CACHE_II_A
 
 } MOESIF_cache_state_t;
 
 class MOESIF_protocol : public Protocol {
 public:
-    MOESIF_protocol (Hash_table *my_table, Hash_entry *my_entry);
+    MOESIF_protocol (Hash_table *my_table);
     ~MOESIF_protocol ();
-
-    MOESIF_cache_state_t state;
     
-    void process_cache_request (Mreq *request);
-    void process_snoop_request (Mreq *request);
-    void dump (void);
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
 
-    inline void do_cache_F (Mreq *request);
-    inline void do_cache_I (Mreq *request);
-    inline void do_cache_S (Mreq *request);
-    inline void do_cache_E (Mreq *request);
-    inline void do_cache_O (Mreq *request);
-    inline void do_cache_M (Mreq *request);
-    inline void do_cache_IM (Mreq *request);
-    inline void do_cache_SM (Mreq *request);
-    inline void do_cache_FM (Mreq *request);
-    inline void do_cache_OM (Mreq *request);
-    inline void do_cache_IS (Mreq *request);
+    inline void do_cache_F (Hash_entry *entry, Mreq *request);
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_S (Hash_entry *entry, Mreq *request);
+    inline void do_cache_E (Hash_entry *entry, Mreq *request);
+    inline void do_cache_O (Hash_entry *entry, Mreq *request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
+    inline void do_cache_IM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_SM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_FM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_OM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_IS (Hash_entry *entry, Mreq *request);
 
 
-    inline void do_snoop_F (Mreq *request);
-    inline void do_snoop_I (Mreq *request);
-    inline void do_snoop_S (Mreq *request);
-    inline void do_snoop_E (Mreq *request);
-    inline void do_snoop_O (Mreq *request);
-    inline void do_snoop_M (Mreq *request);
-    inline void do_snoop_IM (Mreq *request);
-    inline void do_snoop_SM (Mreq *request);
-    inline void do_snoop_OM (Mreq *request);
-    inline void do_snoop_FM (Mreq *request);
-    inline void do_snoop_IS (Mreq *request);
+    inline void do_snoop_F (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_S (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_E (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_O (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_OM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_FM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IS (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_OI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_EI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_FI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
 
 };
 
@@ -1,16 +1,16 @@
 #include "MOESI_protocol.h"
+#include "../sim/event_log.h"
 #include "../sim/mreq.h"
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
 /*************************
  * Constructor/Destructor.
  *************************/
-MOESI_protocol::MOESI_protocol (Hash_table *my_table, Hash_entry *my_entry)
-: Protocol (my_table, my_entry)
+MOESI_protocol::MOESI_protocol (Hash_table *my_table)
+: Protocol (my_table)
 {
-    this->state = MOESI_CACHE_I;
+    this->initial_state = MOESI_CACHE_I;
     
 }
 
@@ -18,22 +18,59 @@ MOESI_protocol::~MOESI_protocol ()
 {
 }
 
-void MOESI_protocol::dump (void)
+void MOESI_protocol::dump (Hash_entry *entry)
 {
-    const char *block_states[] = {"X","I","S","E", "O","M", "IM", "IS", "SM","OM"};
-    fprintf (stderr, "MOESI_protocol - state: %s\n", block_states[state]);
+    const char *block_states[] = {"X","I","S","E","O","M", "OM", "SM", "IM", "IS", "MI_A", "OI_A", "EI_A", "SI_A", "II_A"};
+    sim->log->text (stderr, "MOESI_protocol - state: %s\n", block_states[entry->state]);
 }
 
-void MOESI_protocol::process_cache_request (Mreq *request)
+bool MOESI_protocol::is_stable (Hash_entry *entry)
 {
-    switch (state)
+    return (entry->state == MOESI_CACHE_I ||
+            entry->state == MOESI_CACHE_S ||
+            entry->state == MOESI_CACHE_E ||
+            entry->state == MOESI_CACHE_O ||
+            entry->state == MOESI_CACHE_M);
+}
+
+bool MOESI_protocol::is_invalid (Hash_entry *entry)
+{
+    return entry->state == MOESI_CACHE_I;
+}
+
+void MOESI_protocol::evict (Hash_entry *entry)
+{
+    switch (entry->state)
+    {
+        case MOESI_CACHE_M:
+            send_PUT(PUTM, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MOESI_CACHE_MI_A;
+            break;
+        case MOESI_CACHE_O:
+            send_PUT(PUTO, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MOESI_CACHE_OI_A;
+            break;
+        case MOESI_CACHE_E:
+            entry->state = send_PUT(PUTE, entry->tag) ? MOESI_CACHE_EI_A : MOESI_CACHE_I;//clean, only a directory needs telling
+            break;
+        case MOESI_CACHE_S:
+            entry->state = send_PUT(PUTS, entry->tag) ? MOESI_CACHE_SI_A : MOESI_CACHE_I;//clean, only a directory needs telling
+            break;
+        default:
+            fatal_error ("MOESI_protocol: cannot evict a line in state %d\n", entry->state);
+    }
+}
+
+void MOESI_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
+{
+    switch (entry->state)
     {
             
-        case MOESI_CACHE_I:  do_cache_I (request); break;
-        case MOESI_CACHE_E:  do_cache_E (request); break;
-        case MOESI_CACHE_S:  do_cache_S (request); break;
-        case MOESI_CACHE_O:  do_cache_O (request); break;
-        case MOESI_CACHE_M:  do_cache_M (request); break;
+        case MOESI_CACHE_I:  do_cache_I (entry, request); break;
+        case MOESI_CACHE_E:  do_cache_E (entry, request); break;
+        case MOESI_CACHE_S:  do_cache_S (entry, request); break;
+        case MOESI_CACHE_O:  do_cache_O (entry, request); break;
+        case MOESI_CACHE_M:  do_cache_M (entry, request); break;
         case MOESI_CACHE_IM:
         case MOESI_CACHE_IS:
         case MOESI_CACHE_SM:
@@ -47,36 +84,41 @@ void MOESI_protocol::process_cache_request (Mreq *request)
     }
 }
 
-void MOESI_protocol::process_snoop_request (Mreq *request)
+void MOESI_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
 {
-    switch (state) {
-        case MOESI_CACHE_I:  do_snoop_I (request); break;
-        case MOESI_CACHE_S:  do_snoop_S (request); break;
-        case MOESI_CACHE_O:  do_snoop_O (request); break;
-        case MOESI_CACHE_M:  do_snoop_M (request); break;
-        case MOESI_CACHE_E: do_snoop_E (request); break;
-        case MOESI_CACHE_IS:  do_snoop_IS (request); break;
-        case MOESI_CACHE_IM:  do_snoop_IM (request); break;
-        case MOESI_CACHE_SM:  do_snoop_SM (request); break;
-        case MOESI_CACHE_OM: do_snoop_OM (request); break;
+    switch (entry->state) {
+        case MOESI_CACHE_I:  do_snoop_I (entry, request); break;
+        case MOESI_CACHE_S:  do_snoop_S (entry, request); break;
+        case MOESI_CACHE_O:  do_snoop_O (entry, request); break;
+        case MOESI_CACHE_M:  do_snoop_M (entry, request); break;
+        case MOESI_CACHE_E: do_snoop_E (entry, request); break;
+        case MOESI_CACHE_IS:  do_snoop_IS (entry, request); break;
+        case MOESI_CACHE_IM:  do_snoop_IM (entry, request); break;
+        case MOESI_CACHE_SM:  do_snoop_SM (entry, request); break;
+        case MOESI_CACHE_OM: do_snoop_OM (entry, request); break;
+        case MOESI_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+        case MOESI_CACHE_OI_A: do_snoop_OI_A (entry, request); break;
+        case MOESI_CACHE_EI_A: do_snoop_EI_A (entry, request); break;
+        case MOESI_CACHE_SI_A: do_snoop_SI_A (entry, request); break;
+        case MOESI_CACHE_II_A: do_snoop_II_A (entry, request); break;
         default:
             fatal_error ("Invalid Cache State for MOESI Protocol\n");
     }
 }
 
-inline void MOESI_protocol::do_cache_I (Mreq *request)
+inline void MOESI_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
 {   switch (request->msg)
     {
             
         case LOAD:
             send_GETS(request->addr);// send a GETS signal
-            state = MOESI_CACHE_IS;//move to intermediate state
-            Sim->cache_misses++;//increment cache misses
+            entry->state = MOESI_CACHE_IS;//move to intermediate state
+            sim->cache_misses++;//increment cache misses
             break;
         case STORE:
             send_GETM(request->addr);//send a GETM signal
-            state = MOESI_CACHE_IM;//go to IM intermediate stage
-            Sim->cache_misses++;//increment cache misses
+            entry->state = MOESI_CACHE_IM;//go to IM intermediate stage
+            sim->cache_misses++;//increment cache misses
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -85,7 +127,7 @@ inline void MOESI_protocol::do_cache_I (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_cache_S (Mreq *request)
+inline void MOESI_protocol::do_cache_S (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -93,9 +135,9 @@ inline void MOESI_protocol::do_cache_S (Mreq *request)
             send_DATA_to_proc(request->addr);//send data to proc on LOAD
             break;
         case STORE:
-            send_GETM(request->addr);//send a GETM signal
-            state = MOESI_CACHE_SM;//go to intermediate state SM
-            Sim->cache_misses++;//increment cache misses
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MOESI_CACHE_SM;//go to intermediate state SM
+            sim->cache_misses++;//increment cache misses
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -105,7 +147,7 @@ inline void MOESI_protocol::do_cache_S (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_cache_O (Mreq *request)
+inline void MOESI_protocol::do_cache_O (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -114,9 +156,9 @@ inline void MOESI_protocol::do_cache_O (Mreq *request)
             break;
         case STORE:
             //  flag =request->src_mid.nodeID;
-            send_GETM(request->addr);//send a GETM signal
-            state = MOESI_CACHE_OM;
-            Sim->cache_misses++;
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MOESI_CACHE_OM;
+            sim->cache_misses++;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -126,7 +168,7 @@ inline void MOESI_protocol::do_cache_O (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_cache_M (Mreq *request)
+inline void MOESI_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -144,7 +186,7 @@ inline void MOESI_protocol::do_cache_M (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_cache_E (Mreq *request)
+inline void MOESI_protocol::do_cache_E (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -153,8 +195,8 @@ inline void MOESI_protocol::do_cache_E (Mreq *request)
             break;
         case STORE:
             send_DATA_to_proc(request->addr);
-            state = MOESI_CACHE_M;
-            Sim->silent_upgrades++;
+            entry->state = MOESI_CACHE_M;
+            sim->silent_upgrades++;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -163,11 +205,12 @@ inline void MOESI_protocol::do_cache_E (Mreq *request)
 }
 
 
-inline void MOESI_protocol::do_snoop_I (Mreq *request)
+inline void MOESI_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://do nothing. Already in invalid state
+        case UPGRADE:
         case GETM:
         case DATA:
             break;
@@ -180,18 +223,19 @@ inline void MOESI_protocol::do_snoop_I (Mreq *request)
 
 
 
-inline void MOESI_protocol::do_snoop_S (Mreq *request)
+inline void MOESI_protocol::do_snoop_S (Hash_entry *entry, const Mreq *request)
 {
     
     switch (request->msg)
     {
         case GETS:
             set_shared_line();//GETS signal. Set the shared line
-            state=MOESI_CACHE_S;
+            entry->state=MOESI_CACHE_S;
             break;
+        case UPGRADE:
         case GETM:
             set_shared_line();//set the shared line
-            state = MOESI_CACHE_I; // Invalidate if we see a GetM
+            entry->state = MOESI_CACHE_I; // Invalidate if we see a GetM
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -204,7 +248,7 @@ inline void MOESI_protocol::do_snoop_S (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_snoop_O (Mreq *request)
+inline void MOESI_protocol::do_snoop_O (Hash_entry *entry, const Mreq *request)
 {
     
     switch (request->msg)
@@ -216,7 +260,10 @@ inline void MOESI_protocol::do_snoop_O (Mreq *request)
         case GETM:
             send_DATA_on_bus(request->addr,request->src_mid);
           //  set_shared_line();
-            state = MOESI_CACHE_I; // Invalidate if we see a GetM
+            entry->state = MOESI_CACHE_I; // Invalidate if we see a GetM
+            break;
+        case UPGRADE:
+            entry->state = MOESI_CACHE_I;//the upgrading sharer has the data already
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -229,18 +276,18 @@ inline void MOESI_protocol::do_snoop_O (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_snoop_E (Mreq *request)
+inline void MOESI_protocol::do_snoop_E (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS:
             set_shared_line();//set the shared line
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MOESI_CACHE_S;//transition to S state
+            entry->state = MOESI_CACHE_S;//transition to S state
             break;
         case GETM:
             send_DATA_on_bus(request->addr,request->src_mid);
-            state = MOESI_CACHE_I;//transition to invalid state. Somebody else wants to modify.
+            entry->state = MOESI_CACHE_I;//transition to invalid state. Somebody else wants to modify.
             break;
         case DATA:
             fatal_error ("Should not see data for this line!  I have the line!");
@@ -252,18 +299,23 @@ inline void MOESI_protocol::do_snoop_E (Mreq *request)
 }
 
 
-inline void MOESI_protocol::do_snoop_M (Mreq *request)
+inline void MOESI_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
         case GETS:
+            if (send_DATA_migratory(request))
+            {
+                entry->state = MOESI_CACHE_I; // Migratory: the reader takes the line and will write it
+                break;
+            }
             set_shared_line();
             send_DATA_on_bus(request->addr, request->src_mid); // Write back
-            state = MOESI_CACHE_O; // Go to owner state!
+            entry->state = MOESI_CACHE_O; // Go to owner state!
             break;
         case GETM:
             // set_shared_line();
             send_DATA_on_bus(request->addr, request->src_mid); // Write back
-            state = MOESI_CACHE_I; // Invalidate
+            entry->state = MOESI_CACHE_I; // Invalidate
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -276,16 +328,17 @@ inline void MOESI_protocol::do_snoop_M (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_snoop_IM (Mreq *request)
+inline void MOESI_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://wait for data
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);//send data to proc and go to M state
-            state = MOESI_CACHE_M;
+            entry->state = MOESI_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -294,7 +347,7 @@ inline void MOESI_protocol::do_snoop_IM (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_snoop_SM (Mreq *request)
+inline void MOESI_protocol::do_snoop_SM (Hash_entry *entry, const Mreq *request)
 {
     
     switch (request->msg)
@@ -304,9 +357,21 @@ inline void MOESI_protocol::do_snoop_SM (Mreq *request)
             break;
         case GETM:
             break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MOESI_CACHE_M;
+            }
+            //else another core got the line first and ours went out as a GETM
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MOESI_CACHE_M;
+            break;
         case DATA:
             send_DATA_to_proc(request->addr);//send data to proc and fo to M
-            state = MOESI_CACHE_M;
+            entry->state = MOESI_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -316,7 +381,7 @@ inline void MOESI_protocol::do_snoop_SM (Mreq *request)
     
 }
 
-inline void MOESI_protocol::do_snoop_OM (Mreq *request)
+inline void MOESI_protocol::do_snoop_OM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
         case GETS:
@@ -324,13 +389,26 @@ inline void MOESI_protocol::do_snoop_OM (Mreq *request)
             send_DATA_on_bus(request->addr,request->src_mid);//send data on bus to other proc.
             break;
         case GETM:
-            state=MOESI_CACHE_IM;//go to intemediate state
+            entry->state=MOESI_CACHE_IM;//go to intemediate state
             send_DATA_on_bus(request->addr,request->src_mid);//send data on bus
-           // Sim->cache_misses++;//increment cache misses
+           // sim->cache_misses++;//increment cache misses
+            break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MOESI_CACHE_M;
+            }
+            else
+                entry->state = MOESI_CACHE_IM;//another sharer upgraded first, it needs no data from us
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MOESI_CACHE_M;
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOESI_CACHE_M;//transition to M state
+            entry->state = MOESI_CACHE_M;//transition to M state
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -338,19 +416,24 @@ inline void MOESI_protocol::do_snoop_OM (Mreq *request)
     }
 }
 
-inline void MOESI_protocol::do_snoop_IS (Mreq *request)
+inline void MOESI_protocol::do_snoop_IS (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://wait for data
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOESI_CACHE_E;//go to exclusive state
-            if (get_shared_line()) //if it is a shared line
+            entry->state = MOESI_CACHE_E;//go to exclusive state
+            if (request->migratory)
+            {
+                entry->state = MOESI_CACHE_M;//handed over exclusively, and still dirty
+            }
+            else if (get_shared_line()) //if it is a shared line
             {
-                state = MOESI_CACHE_S;//go to shared state> WE are not alone!
+                entry->state = MOESI_CACHE_S;//go to shared state> WE are not alone!
             }
             break;
         default:
@@ -359,3 +442,124 @@ inline void MOESI_protocol::do_snoop_IS (Mreq *request)
     }
     
 }
+
+inline void MOESI_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still ours and still dirty, answer like M
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESI_CACHE_OI_A;
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MOESI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MOESI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESI_protocol::do_snoop_OI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still the owner, answer like O
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MOESI_CACHE_I;
+            break;
+        case UPGRADE:
+            entry->state = MOESI_CACHE_II_A;//the upgrading sharer has the data already
+            break;
+        case ACK:
+            entry->state = MOESI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: OI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESI_protocol::do_snoop_EI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://answer like E
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESI_CACHE_SI_A;
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOESI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MOESI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: EI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESI_protocol::do_snoop_SI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case UPGRADE:
+        case GETM:
+            set_shared_line();
+            entry->state = MOESI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MOESI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOESI_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://the line is gone, nothing to answer
+        case UPGRADE:
+        case GETM:
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, false);//our stale PUT, tell memory there is nothing to write
+            entry->state = MOESI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MOESI_CACHE_I;//directory mode: the home has caught the stale PUT
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
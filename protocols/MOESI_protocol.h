@@ -17,40 +17,51 @@ typedef enum {
     MOESI_CACHE_OM,
     MOESI_CACHE_SM,
     MOESI_CACHE_IM,
-    MOESI_CACHE_IS
+    MOESI_CACHE_IS,
+    MOESI_CACHE_MI_A,
+    MOESI_CACHE_OI_A,
+    MOESI_CACHE_EI_A,
+    MOESI_CACHE_SI_A,
+    MOESI_CACHE_II_A
 } MOESI_cache_state_t;
 
 class MOESI_protocol : public Protocol {
 public:
-    MOESI_protocol (Hash_table *my_table, Hash_entry *my_entry);
+    MOESI_protocol (Hash_table *my_table);
     ~MOESI_protocol ();
-
-    MOESI_cache_state_t state;
     
-    void process_cache_request (Mreq *request);
-    void process_snoop_request (Mreq *request);
-    void dump (void);
-
-    inline void do_cache_I (Mreq *request);
-    inline void do_cache_S (Mreq *request);
-    inline void do_cache_E (Mreq *request);
-    inline void do_cache_O (Mreq *request);
-    inline void do_cache_M (Mreq *request);
-    inline void do_cache_IM (Mreq *request);
-    inline void do_cache_SM (Mreq *request);
-    inline void do_cache_IS (Mreq *request);
-    inline void do_cache_OM (Mreq *request);
-
-
-    inline void do_snoop_I (Mreq *request);
-    inline void do_snoop_S (Mreq *request);
-    inline void do_snoop_E (Mreq *request);
-    inline void do_snoop_O (Mreq *request);
-    inline void do_snoop_M (Mreq *request);
-    inline void do_snoop_IM (Mreq *request);
-    inline void do_snoop_SM (Mreq *request);
-    inline void do_snoop_IS (Mreq *request);
-    inline void do_snoop_OM (Mreq *request);
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
+
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_S (Hash_entry *entry, Mreq *request);
+    inline void do_cache_E (Hash_entry *entry, Mreq *request);
+    inline void do_cache_O (Hash_entry *entry, Mreq *request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
+    inline void do_cache_IM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_SM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_IS (Hash_entry *entry, Mreq *request);
+    inline void do_cache_OM (Hash_entry *entry, Mreq *request);
+
+
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_S (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_E (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_O (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IS (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_OM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_OI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_EI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
 
 };
 
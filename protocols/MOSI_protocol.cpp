@@ -1,16 +1,16 @@
 #include "MOSI_protocol.h"
+#include "../sim/event_log.h"
 #include "../sim/mreq.h"
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
 /*************************
  * Constructor/Destructor.
  *************************/
-MOSI_protocol::MOSI_protocol (Hash_table *my_table, Hash_entry *my_entry)
-: Protocol (my_table, my_entry)
+MOSI_protocol::MOSI_protocol (Hash_table *my_table)
+: Protocol (my_table)
 {
-    this->state = MOSI_CACHE_I;
+    this->initial_state = MOSI_CACHE_I;
     //flag=-1;
 
 }
@@ -19,21 +19,54 @@ MOSI_protocol::~MOSI_protocol ()
 {
 }
 
-void MOSI_protocol::dump (void)
+void MOSI_protocol::dump (Hash_entry *entry)
 {
-    const char *block_states[8] = {"X","I","S","O","M", "IM", "IS", "SM"};
-    fprintf (stderr, "MOSI_protocol - state: %s\n", block_states[state]);
+    const char *block_states[] = {"X","I","S","O","M", "IM", "IS", "SM", "OM", "MO", "MI_A", "OI_A", "SI_A", "II_A"};
+    sim->log->text (stderr, "MOSI_protocol - state: %s\n", block_states[entry->state]);
 }
 
-void MOSI_protocol::process_cache_request (Mreq *request)
+bool MOSI_protocol::is_stable (Hash_entry *entry)
 {
-    switch (state)
+    return (entry->state == MOSI_CACHE_I ||
+            entry->state == MOSI_CACHE_S ||
+            entry->state == MOSI_CACHE_O ||
+            entry->state == MOSI_CACHE_M);
+}
+
+bool MOSI_protocol::is_invalid (Hash_entry *entry)
+{
+    return entry->state == MOSI_CACHE_I;
+}
+
+void MOSI_protocol::evict (Hash_entry *entry)
+{
+    switch (entry->state)
+    {
+        case MOSI_CACHE_M:
+            send_PUT(PUTM, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MOSI_CACHE_MI_A;
+            break;
+        case MOSI_CACHE_O:
+            send_PUT(PUTO, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MOSI_CACHE_OI_A;
+            break;
+        case MOSI_CACHE_S:
+            entry->state = send_PUT(PUTS, entry->tag) ? MOSI_CACHE_SI_A : MOSI_CACHE_I;//clean, only a directory needs telling
+            break;
+        default:
+            fatal_error ("MOSI_protocol: cannot evict a line in state %d\n", entry->state);
+    }
+}
+
+void MOSI_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
+{
+    switch (entry->state)
     {
             
-        case MOSI_CACHE_I:  do_cache_I (request); break;
-        case MOSI_CACHE_S:  do_cache_S (request); break;
-        case MOSI_CACHE_O:  do_cache_O (request); break;
-        case MOSI_CACHE_M:  do_cache_M (request); break;
+        case MOSI_CACHE_I:  do_cache_I (entry, request); break;
+        case MOSI_CACHE_S:  do_cache_S (entry, request); break;
+        case MOSI_CACHE_O:  do_cache_O (entry, request); break;
+        case MOSI_CACHE_M:  do_cache_M (entry, request); break;
         case MOSI_CACHE_IM:
         case MOSI_CACHE_IS:
         case MOSI_CACHE_SM:
@@ -47,35 +80,39 @@ void MOSI_protocol::process_cache_request (Mreq *request)
     }
 }
 
-void MOSI_protocol::process_snoop_request (Mreq *request)
+void MOSI_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
 {
-    switch (state) {
-        case MOSI_CACHE_I:  do_snoop_I (request); break;
-        case MOSI_CACHE_S:  do_snoop_S (request); break;
-        case MOSI_CACHE_O:  do_snoop_O (request); break;
-        case MOSI_CACHE_M:  do_snoop_M (request); break;
-        case MOSI_CACHE_IS:  do_snoop_IS (request); break;
-        case MOSI_CACHE_IM:  do_snoop_IM (request); break;
-        case MOSI_CACHE_SM:  do_snoop_SM (request); break;
-        case MOSI_CACHE_OM: do_snoop_OM (request); break;
+    switch (entry->state) {
+        case MOSI_CACHE_I:  do_snoop_I (entry, request); break;
+        case MOSI_CACHE_S:  do_snoop_S (entry, request); break;
+        case MOSI_CACHE_O:  do_snoop_O (entry, request); break;
+        case MOSI_CACHE_M:  do_snoop_M (entry, request); break;
+        case MOSI_CACHE_IS:  do_snoop_IS (entry, request); break;
+        case MOSI_CACHE_IM:  do_snoop_IM (entry, request); break;
+        case MOSI_CACHE_SM:  do_snoop_SM (entry, request); break;
+        case MOSI_CACHE_OM: do_snoop_OM (entry, request); break;
+        case MOSI_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+        case MOSI_CACHE_OI_A: do_snoop_OI_A (entry, request); break;
+        case MOSI_CACHE_SI_A: do_snoop_SI_A (entry, request); break;
+        case MOSI_CACHE_II_A: do_snoop_II_A (entry, request); break;
         default:
             fatal_error ("Invalid Cache State for MOSI Protocol\n");
     }
 }
 
-inline void MOSI_protocol::do_cache_I (Mreq *request)
+inline void MOSI_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
 {   switch (request->msg)
     {
             
         case LOAD:
             send_GETS(request->addr);// send a GETS signal
-            state = MOSI_CACHE_IS;//move to intermediate state
-            Sim->cache_misses++;//increment cache misses
+            entry->state = MOSI_CACHE_IS;//move to intermediate state
+            sim->cache_misses++;//increment cache misses
             break;
         case STORE:
             send_GETM(request->addr);//send a GETM signal
-            state = MOSI_CACHE_IM;//go to IM intermediate stage
-            Sim->cache_misses++;//increment cache misses
+            entry->state = MOSI_CACHE_IM;//go to IM intermediate stage
+            sim->cache_misses++;//increment cache misses
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -84,7 +121,7 @@ inline void MOSI_protocol::do_cache_I (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_cache_S (Mreq *request)
+inline void MOSI_protocol::do_cache_S (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -92,9 +129,9 @@ inline void MOSI_protocol::do_cache_S (Mreq *request)
             send_DATA_to_proc(request->addr);//send data to proc on LOAD
             break;
         case STORE:
-            send_GETM(request->addr);//send a GETM signal
-            state = MOSI_CACHE_SM;//go to intermediate state SM
-            Sim->cache_misses++;//increment cache misses
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MOSI_CACHE_SM;//go to intermediate state SM
+            sim->cache_misses++;//increment cache misses
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -104,7 +141,7 @@ inline void MOSI_protocol::do_cache_S (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_cache_O (Mreq *request)
+inline void MOSI_protocol::do_cache_O (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -113,9 +150,9 @@ inline void MOSI_protocol::do_cache_O (Mreq *request)
             break;
         case STORE:
           //  flag =request->src_mid.nodeID;
-            send_GETM(request->addr);//send a GETM signal
-            state = MOSI_CACHE_OM;
-            Sim->cache_misses++;
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MOSI_CACHE_OM;
+            sim->cache_misses++;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -125,7 +162,7 @@ inline void MOSI_protocol::do_cache_O (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_cache_M (Mreq *request)
+inline void MOSI_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -143,11 +180,12 @@ inline void MOSI_protocol::do_cache_M (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_snoop_I (Mreq *request)
+inline void MOSI_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://do nothing. Already in invalid state
+        case UPGRADE:
         case GETM:
         case DATA:
             break;
@@ -158,18 +196,19 @@ inline void MOSI_protocol::do_snoop_I (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_snoop_S (Mreq *request)
+inline void MOSI_protocol::do_snoop_S (Hash_entry *entry, const Mreq *request)
 {
     
     switch (request->msg)
     {
         case GETS:
             set_shared_line();//GETS signal. Set the shared line
-            state=MOSI_CACHE_S;
+            entry->state=MOSI_CACHE_S;
             break;
+        case UPGRADE:
         case GETM:
             set_shared_line();//set the shared line
-            state = MOSI_CACHE_I; // Invalidate if we see a GetM
+            entry->state = MOSI_CACHE_I; // Invalidate if we see a GetM
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -182,7 +221,7 @@ inline void MOSI_protocol::do_snoop_S (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_snoop_O (Mreq *request)
+inline void MOSI_protocol::do_snoop_O (Hash_entry *entry, const Mreq *request)
 {
     
     switch (request->msg)
@@ -194,7 +233,10 @@ inline void MOSI_protocol::do_snoop_O (Mreq *request)
         case GETM:
             send_DATA_on_bus(request->addr,request->src_mid);
             set_shared_line();
-            state = MOSI_CACHE_I; // Invalidate if we see a GetM
+            entry->state = MOSI_CACHE_I; // Invalidate if we see a GetM
+            break;
+        case UPGRADE:
+            entry->state = MOSI_CACHE_I;//the upgrading sharer has the data already
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -207,18 +249,18 @@ inline void MOSI_protocol::do_snoop_O (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_snoop_M (Mreq *request)
+inline void MOSI_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
         case GETS:
             set_shared_line();
             send_DATA_on_bus(request->addr, request->src_mid); // Write back
-            state = MOSI_CACHE_O; // Go to owner state!
+            entry->state = MOSI_CACHE_O; // Go to owner state!
             break;
         case GETM:
            // set_shared_line();
             send_DATA_on_bus(request->addr, request->src_mid); // Write back
-            state = MOSI_CACHE_I; // Invalidate
+            entry->state = MOSI_CACHE_I; // Invalidate
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -231,16 +273,17 @@ inline void MOSI_protocol::do_snoop_M (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_snoop_IM (Mreq *request)
+inline void MOSI_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://wait for data
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);//send data to proc and go to M state
-            state = MOSI_CACHE_M;
+            entry->state = MOSI_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -249,7 +292,7 @@ inline void MOSI_protocol::do_snoop_IM (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_snoop_SM (Mreq *request)
+inline void MOSI_protocol::do_snoop_SM (Hash_entry *entry, const Mreq *request)
 {
     
     switch (request->msg)
@@ -257,10 +300,22 @@ inline void MOSI_protocol::do_snoop_SM (Mreq *request)
         case GETS:
         case GETM:
             break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MOSI_CACHE_M;
+            }
+            //else another core got the line first and ours went out as a GETM
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MOSI_CACHE_M;
+            break;
         case DATA:
             set_shared_line();
             send_DATA_to_proc(request->addr);//send data to proc and fo to M
-            state = MOSI_CACHE_M;
+            entry->state = MOSI_CACHE_M;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -270,20 +325,33 @@ inline void MOSI_protocol::do_snoop_SM (Mreq *request)
     
 }
 
-inline void MOSI_protocol::do_snoop_OM (Mreq *request)
+inline void MOSI_protocol::do_snoop_OM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
         case GETS:
             send_DATA_on_bus(request->addr,request->src_mid);//send data on bus to other proc.
             break;
         case GETM:
-            state=MOSI_CACHE_IM;
+            entry->state=MOSI_CACHE_IM;
             send_DATA_on_bus(request->addr,request->src_mid);
-           // Sim->cache_misses++;
+           // sim->cache_misses++;
+            break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MOSI_CACHE_M;
+            }
+            else
+                entry->state = MOSI_CACHE_IM;//another sharer upgraded first, it needs no data from us
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MOSI_CACHE_M;
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOSI_CACHE_M;
+            entry->state = MOSI_CACHE_M;
                         break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -291,16 +359,17 @@ inline void MOSI_protocol::do_snoop_OM (Mreq *request)
     }
 }
 
-inline void MOSI_protocol::do_snoop_IS (Mreq *request)
+inline void MOSI_protocol::do_snoop_IS (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://wait for data
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MOSI_CACHE_S;
+            entry->state = MOSI_CACHE_S;
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -308,3 +377,103 @@ inline void MOSI_protocol::do_snoop_IS (Mreq *request)
     }
     
 }
+
+inline void MOSI_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still ours and still dirty, answer like M
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOSI_CACHE_OI_A;
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MOSI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MOSI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MOSI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOSI_protocol::do_snoop_OI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still the owner, answer like O
+            set_shared_line();
+            send_DATA_on_bus(request->addr,request->src_mid);
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            set_shared_line();
+            entry->state = MOSI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MOSI_CACHE_I;
+            break;
+        case UPGRADE:
+            entry->state = MOSI_CACHE_II_A;//the upgrading sharer has the data already
+            break;
+        case ACK:
+            entry->state = MOSI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: OI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOSI_protocol::do_snoop_SI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            set_shared_line();
+            break;
+        case UPGRADE:
+        case GETM:
+            set_shared_line();
+            entry->state = MOSI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MOSI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MOSI_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://the line is gone, nothing to answer
+        case UPGRADE:
+        case GETM:
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, false);//our stale PUT, tell memory there is nothing to write
+            entry->state = MOSI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MOSI_CACHE_I;//directory mode: the home has caught the stale PUT
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
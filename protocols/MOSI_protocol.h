@@ -20,38 +20,47 @@ typedef enum {
     MOSI_CACHE_SM,
     MOSI_CACHE_OM,
     MOSI_CACHE_MO,
+    MOSI_CACHE_MI_A,
+    MOSI_CACHE_OI_A,
+    MOSI_CACHE_SI_A,
+    MOSI_CACHE_II_A
 } MOSI_cache_state_t;
 
 class MOSI_protocol : public Protocol {
 public:
-    MOSI_protocol (Hash_table *my_table, Hash_entry *my_entry);
+    MOSI_protocol (Hash_table *my_table);
     ~MOSI_protocol ();
     
-    MOSI_cache_state_t state;
-    
-    void process_cache_request (Mreq *request);
-    void process_snoop_request (Mreq *request);
-    void dump (void);
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
     
     int flag;
     
-    inline void do_cache_I (Mreq *request);
-    inline void do_cache_S (Mreq * request);
-    inline void do_cache_O (Mreq * request);
-    inline void do_cache_M (Mreq *request);
-    inline void do_cache_IM (Mreq *request);
-    inline void do_cache_IS (Mreq *request);
-    inline void do_cache_SM (Mreq *request);
-    inline void do_cache_OM (Mreq *request);
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_S (Hash_entry *entry, Mreq * request);
+    inline void do_cache_O (Hash_entry *entry, Mreq * request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
+    inline void do_cache_IM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_IS (Hash_entry *entry, Mreq *request);
+    inline void do_cache_SM (Hash_entry *entry, Mreq *request);
+    inline void do_cache_OM (Hash_entry *entry, Mreq *request);
     
-    inline void do_snoop_I (Mreq *request);
-    inline void do_snoop_S (Mreq *request);
-    inline void do_snoop_O (Mreq *request);
-    inline void do_snoop_M (Mreq *request);
-    inline void do_snoop_IM (Mreq *request);
-    inline void do_snoop_IS (Mreq *request);
-    inline void do_snoop_SM (Mreq *request);
-    inline void do_snoop_OM (Mreq *request);
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_S (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_O (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_IS (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_OM (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_OI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
 };
 
 #endif // _MOSI_CACHE_H
\ No newline at end of file
@@ -1,81 +1,111 @@
 #include "MSI_protocol.h"
+#include "../sim/event_log.h"
 #include "../sim/mreq.h"
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
-
 /*************************
  * Constructor/Destructor.
  *************************/
-MSI_protocol::MSI_protocol (Hash_table *my_table, Hash_entry *my_entry)
-: Protocol (my_table, my_entry)
+MSI_protocol::MSI_protocol (Hash_table *my_table)
+: Protocol (my_table)
 {
     // Initialize lines to not have the data yet!
-    this->state = MSI_CACHE_I;
+    this->initial_state = MSI_CACHE_I;
 }
 
 MSI_protocol::~MSI_protocol ()
 {
 }
 
-void MSI_protocol::dump (void)
+void MSI_protocol::dump (Hash_entry *entry)
+{
+    const char *block_states[] = {"X","I","S","M", "IS", "IM", "SM", "MI_A", "SI_A", "II_A"};
+    sim->log->text (stdout, "MSI_protocol - state: %s\n", block_states[entry->state]);
+}
+
+bool MSI_protocol::is_stable (Hash_entry *entry)
 {
-    const char *block_states[] = {"X","I","S","M", "IS", "IM", "SM"};
-    fprintf (stdout, "MSI_protocol - state: %s\n", block_states[state]);
+    return (entry->state == MSI_CACHE_I ||
+            entry->state == MSI_CACHE_S ||
+            entry->state == MSI_CACHE_M);
+}
+
+bool MSI_protocol::is_invalid (Hash_entry *entry)
+{
+    return entry->state == MSI_CACHE_I;
+}
+
+void MSI_protocol::evict (Hash_entry *entry)
+{
+    switch (entry->state)
+    {
+        case MSI_CACHE_M:
+            send_PUT(PUTM, entry->tag);//the line is dirty, it goes back to memory
+            entry->state = MSI_CACHE_MI_A;
+            break;
+        case MSI_CACHE_S:
+            entry->state = send_PUT(PUTS, entry->tag) ? MSI_CACHE_SI_A : MSI_CACHE_I;//clean, only a directory needs telling
+            break;
+        default:
+            fatal_error ("MSI_protocol: cannot evict a line in state %d\n", entry->state);
+    }
 }
 
-void MSI_protocol::process_cache_request (Mreq *request)
+void MSI_protocol::process_cache_request (Hash_entry *entry, Mreq *request)
 {
-    switch (state)
+    switch (entry->state)
     {
-        case MSI_CACHE_I: do_cache_I (request);
+        case MSI_CACHE_I: do_cache_I (entry, request);
             break;
-        case MSI_CACHE_M: do_cache_M (request);
+        case MSI_CACHE_M: do_cache_M (entry, request);
             break;
-        case MSI_CACHE_S: do_cache_S (request);
+        case MSI_CACHE_S: do_cache_S (entry, request);
             break;
         default:
             fatal_error ("MSI_protocol->state not valid?\n");
     }
 }
 
-void MSI_protocol::process_snoop_request (Mreq *request)
+void MSI_protocol::process_snoop_request (Hash_entry *entry, const Mreq *request)
 {
-    switch (state)
+    switch (entry->state)
     {
-        case MSI_CACHE_I: do_snoop_I (request);
+        case MSI_CACHE_I: do_snoop_I (entry, request);
             break;
-        case MSI_CACHE_M: do_snoop_M (request);
+        case MSI_CACHE_M: do_snoop_M (entry, request);
             break;
-        case MSI_CACHE_S: do_snoop_S (request);
+        case MSI_CACHE_S: do_snoop_S (entry, request);
             break;
-        case MSI_CACHE_IS: do_snoop_IS (request);
+        case MSI_CACHE_IS: do_snoop_IS (entry, request);
             break;
-        case MSI_CACHE_IM: do_snoop_IM (request);
+        case MSI_CACHE_IM: do_snoop_IM (entry, request);
             break;
-        case MSI_CACHE_SM: do_snoop_SM (request);
+        case MSI_CACHE_SM: do_snoop_SM (entry, request);
             break;
+        case MSI_CACHE_MI_A: do_snoop_MI_A (entry, request); break;
+        case MSI_CACHE_SI_A: do_snoop_SI_A (entry, request); break;
+        case MSI_CACHE_II_A: do_snoop_II_A (entry, request); break;
         default:
             fatal_error ("MSI_protocol->state not valid?\n");
     }
 }
 
-inline void MSI_protocol::do_cache_I (Mreq *request)
+inline void MSI_protocol::do_cache_I (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
         case LOAD:
 
             send_GETS(request->addr);//send out a GETS to get the cache from memory
-            state = MSI_CACHE_IS; // into transition state between invalid and shared
-            Sim->cache_misses++; //cache miss!
+            entry->state = MSI_CACHE_IS; // into transition state between invalid and shared
+            sim->cache_misses++; //cache miss!
             break;
         case STORE:
 
             send_GETM(request->addr);//send out a GETM to get the cache from memory
-            state = MSI_CACHE_IM; // into I to M trnasition state. Wait for data.
-            Sim->cache_misses++; // cache miss!
+            entry->state = MSI_CACHE_IM; // into I to M trnasition state. Wait for data.
+            sim->cache_misses++; // cache miss!
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -83,7 +113,7 @@ inline void MSI_protocol::do_cache_I (Mreq *request)
     }
 }
 
-inline void MSI_protocol::do_cache_S (Mreq *request)
+inline void MSI_protocol::do_cache_S (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg) {
         case LOAD:
@@ -92,9 +122,9 @@ inline void MSI_protocol::do_cache_S (Mreq *request)
             break;
        
         case STORE:
-            send_GETM(request->addr);//send out a GETM to get the cache from memory
-            state = MSI_CACHE_SM; //Wait for data and transition to M
-            Sim->cache_misses++; //increment cache misses.
+            send_UPGRADE(request->addr);//we have the data, only the other copies have to go
+            entry->state = MSI_CACHE_SM; //Wait for data and transition to M
+            sim->cache_misses++; //increment cache misses.
             break;
         default:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -102,7 +132,7 @@ inline void MSI_protocol::do_cache_S (Mreq *request)
     }
 }
 
-inline void MSI_protocol::do_cache_M (Mreq *request)
+inline void MSI_protocol::do_cache_M (Hash_entry *entry, Mreq *request)
 {
     switch (request->msg)
     {
@@ -116,11 +146,12 @@ inline void MSI_protocol::do_cache_M (Mreq *request)
     }
 }
 
-inline void MSI_protocol::do_snoop_I (Mreq *request)
+inline void MSI_protocol::do_snoop_I (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS: //do nothing when snooping in invlaid state.
+        case UPGRADE:
         case GETM:
         case DATA:
             break;
@@ -130,15 +161,16 @@ inline void MSI_protocol::do_snoop_I (Mreq *request)
     }
 }
 
-inline void MSI_protocol::do_snoop_S (Mreq *request)
+inline void MSI_protocol::do_snoop_S (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
         case GETS:
         //    send_DATA_on_bus(request->addr, request->src_mid); // Write back
             break;
+        case UPGRADE:
         case GETM:
          //   send_DATA_on_bus(request->addr, request->src_mid); // Write back
-            state = MSI_CACHE_I; // Invalidate if we see a GetM. Some other processor wants to modify.
+            entry->state = MSI_CACHE_I; // Invalidate if we see a GetM. Some other processor wants to modify.
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -149,16 +181,16 @@ inline void MSI_protocol::do_snoop_S (Mreq *request)
     }
 }
 
-inline void MSI_protocol::do_snoop_M (Mreq *request)
+inline void MSI_protocol::do_snoop_M (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg) {
         case GETS:
             send_DATA_on_bus(request->addr, request->src_mid); // Write back the cache block. Or give it to the proc
-            state = MSI_CACHE_S; // Go to shared
+            entry->state = MSI_CACHE_S; // Go to shared
             break;
         case GETM:
             send_DATA_on_bus(request->addr, request->src_mid); // Write back/give it to the other proc
-            state = MSI_CACHE_I; // Invalidate
+            entry->state = MSI_CACHE_I; // Invalidate
             break;
         case DATA:
             request->print_msg (my_table->moduleID, "ERROR");
@@ -169,16 +201,17 @@ inline void MSI_protocol::do_snoop_M (Mreq *request)
             fatal_error ("Client: SnoopM state shouldn't see this message\n");
     }
 }
-inline void MSI_protocol::do_snoop_IS (Mreq *request)
+inline void MSI_protocol::do_snoop_IS (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://do nothing till you see the DATA
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MSI_CACHE_S; // we can finally transition to S!
+            entry->state = MSI_CACHE_S; // we can finally transition to S!
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -186,16 +219,17 @@ inline void MSI_protocol::do_snoop_IS (Mreq *request)
     }
 }
 
-inline void MSI_protocol::do_snoop_IM (Mreq *request)
+inline void MSI_protocol::do_snoop_IM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
         case GETS://do nothing till you see the data
+        case UPGRADE:
         case GETM:
             break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MSI_CACHE_M; // we can finally transition to M
+            entry->state = MSI_CACHE_M; // we can finally transition to M
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -203,7 +237,7 @@ inline void MSI_protocol::do_snoop_IM (Mreq *request)
     }
 }
 
-inline void MSI_protocol::do_snoop_SM (Mreq *request)
+inline void MSI_protocol::do_snoop_SM (Hash_entry *entry, const Mreq *request)
 {
     switch (request->msg)
     {
@@ -211,12 +245,90 @@ inline void MSI_protocol::do_snoop_SM (Mreq *request)
             break;
         case GETM:
             break;
+        case UPGRADE:
+            if (request->src_mid == my_table->moduleID)
+            {
+                send_DATA_to_proc(request->addr);//our UPGRADE won, every other copy is gone
+                entry->state = MSI_CACHE_M;
+            }
+            //else another core got the line first and ours went out as a GETM
+            break;
+        case ACK:
+            send_DATA_to_proc(request->addr);//directory mode: the home invalidated the other copies
+            entry->state = MSI_CACHE_M;
+            break;
         case DATA:
             send_DATA_to_proc(request->addr);
-            state = MSI_CACHE_M; //we can finally transtion to M
+            entry->state = MSI_CACHE_M; //we can finally transtion to M
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
             fatal_error ("Client: SnoopSM state shouldn't see this message\n");
     }
-}
\ No newline at end of file
+}
+
+inline void MSI_protocol::do_snoop_MI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://still ours and still dirty, answer like M
+            send_DATA_on_bus(request->addr,request->src_mid);
+            break;
+        case GETM:
+            send_DATA_on_bus(request->addr,request->src_mid);
+            entry->state = MSI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, true);//our own PUT, the line follows it to memory
+            entry->state = MSI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MSI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: MI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MSI_protocol::do_snoop_SI_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS:
+            break;
+        case UPGRADE:
+        case GETM:
+            entry->state = MSI_CACHE_II_A;//our PUT is stale now, it will carry nothing
+            break;
+        case ACK:
+            entry->state = MSI_CACHE_I;//directory mode: the home has taken the line back
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: SI_A state shouldn't see this message\n");
+    }
+}
+
+inline void MSI_protocol::do_snoop_II_A (Hash_entry *entry, const Mreq *request)
+{
+    switch (request->msg)
+    {
+        case GETS://the line is gone, nothing to answer
+        case UPGRADE:
+        case GETM:
+            break;
+        case PUTM:
+        case PUTO:
+            send_writeback(request->addr, false);//our stale PUT, tell memory there is nothing to write
+            entry->state = MSI_CACHE_I;
+            break;
+        case ACK:
+            entry->state = MSI_CACHE_I;//directory mode: the home has caught the stale PUT
+            break;
+        default:
+            request->print_msg (my_table->moduleID, "ERROR");
+            fatal_error ("Client: II_A state shouldn't see this message\n");
+    }
+}
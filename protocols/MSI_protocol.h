@@ -15,36 +15,42 @@ typedef enum {
     MSI_CACHE_IS,
     MSI_CACHE_IM,
     MSI_CACHE_SM,
+    MSI_CACHE_MI_A,
+    MSI_CACHE_SI_A,
+    MSI_CACHE_II_A
 } MSI_cache_state_t;
 
 class MSI_protocol : public Protocol {
 public:
-    MSI_protocol (Hash_table *my_table, Hash_entry *my_entry);
+    MSI_protocol (Hash_table *my_table);
     ~MSI_protocol ();
-
-    // Cache state for this line
-    MSI_cache_state_t state;
     
-    void process_cache_request (Mreq *request);
-    void process_snoop_request (Mreq *request);
-    void dump (void);
+    void process_cache_request (Hash_entry *entry, Mreq *request);
+    void process_snoop_request (Hash_entry *entry, const Mreq *request);
+    void dump (Hash_entry *entry);
+    bool is_stable (Hash_entry *entry);
+    bool is_invalid (Hash_entry *entry);
+    void evict (Hash_entry *entry);
 
     /* Functions that specify the actions to take on requests from the processor
      * when the cache is in various states
      */
-    inline void do_cache_I (Mreq *request);
-    inline void do_cache_S (Mreq * request);
-    inline void do_cache_M (Mreq *request);
+    inline void do_cache_I (Hash_entry *entry, Mreq *request);
+    inline void do_cache_S (Hash_entry *entry, Mreq * request);
+    inline void do_cache_M (Hash_entry *entry, Mreq *request);
   
     /* Functions that specify the actions to take on snooped requests
      * when the cache is in various states
      */
-    inline void do_snoop_I (Mreq *request);
-    inline void do_snoop_S (Mreq * request);
-    inline void do_snoop_M (Mreq *request);
-        inline void do_snoop_IM (Mreq *request); //transition state between I and M
-        inline void do_snoop_SM (Mreq *request); //transition state between S and M
-        inline void do_snoop_IS (Mreq *request); //transition state between I and S
+    inline void do_snoop_I (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_S (Hash_entry *entry, const Mreq * request);
+    inline void do_snoop_M (Hash_entry *entry, const Mreq *request);
+        inline void do_snoop_IM (Hash_entry *entry, const Mreq *request); //transition state between I and M
+        inline void do_snoop_SM (Hash_entry *entry, const Mreq *request); //transition state between S and M
+        inline void do_snoop_IS (Hash_entry *entry, const Mreq *request); //transition state between I and S
+    inline void do_snoop_MI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_SI_A (Hash_entry *entry, const Mreq *request);
+    inline void do_snoop_II_A (Hash_entry *entry, const Mreq *request);
 };
 
 #endif // _MSI_CACHE_H
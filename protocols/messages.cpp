@@ -23,6 +23,17 @@ const char * Mreq::message_t_str[MREQ_MESSAGE_NUM] = {
     "GETM",
 
     "DATA",
+    "ACK",
+
+    "UPGRADE",
+
+    "PUTM",
+    "PUTO",
+    "PUTE",
+    "PUTS",
+
+    "BUSUPD",
+    "WORD",
 
     "MREQ_INVALID"
 };
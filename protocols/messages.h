@@ -23,9 +23,38 @@ typedef enum
     GETM,
 
     DATA,
+    ACK,        /** Directory mode: snoop response without data.  */
+
+    /** S, O or F to M: invalidates the other copies, no data phase.  */
+    UPGRADE,
+
+    /** Writebacks, one per state a line can be evicted from.  PUTM and
+     *  PUTO carry the line, PUTE and PUTS only tell the home.  */
+    PUTM,
+    PUTO,
+    PUTE,
+    PUTS,
+
+    /** Dragon and Firefly: a store to a shared line, the other copies take
+     *  the new word instead of going invalid.  WORD is its data phase, from
+     *  the writer back to itself, and carries the shared line as it stood
+     *  at the address phase.  */
+    BUSUPD,
+    WORD,
 
     MREQ_INVALID,
 	MREQ_MESSAGE_NUM	// Use this to make a Stat Array of message types
 } message_t;
 
+static inline bool is_put (message_t msg)
+{
+    return msg == PUTM || msg == PUTO || msg == PUTE || msg == PUTS;
+}
+
+/** The second half of a bus transaction, addressed to a single module.  */
+static inline bool is_data_phase (message_t msg)
+{
+    return msg == DATA || msg == ACK || msg == WORD;
+}
+
 #endif /* MESSAGES_H_ */
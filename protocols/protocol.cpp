@@ -1,14 +1,14 @@
 #include "protocol.h"
 #include "../sim/sharers.h"
+#include "../sim/event_log.h"
 #include "../sim/hash_table.h"
 #include "../sim/sim.h"
 
-extern Simulator * Sim;
-
-Protocol::Protocol (Hash_table *my_table, Hash_entry *my_entry)
+Protocol::Protocol (Hash_table *my_table)
 {
     this->my_table = my_table;
-    this->my_entry = my_entry;
+    this->sim = my_table->sim;
+    this->initial_state = 0;
 }
 
 Protocol::~Protocol ()
@@ -19,8 +19,8 @@ void Protocol::send_GETM(paddr_t addr)
 {
 	/* Create a new message to send on the bus */
 	Mreq * new_request;
-	/* The arguments to Mreq are -- msg, address, src_id (optional), dest_id (optional) */
-	new_request = new Mreq(GETM,addr);
+	/* The arguments to Mreq are -- sim, msg, address, src_id (optional), dest_id (optional) */
+	new_request = new Mreq(sim, GETM,addr);
 	/* This will but the message in the bus' arbitration queue to sent */
 	this->my_table->write_to_bus(new_request);
 }
@@ -30,7 +30,7 @@ void Protocol::send_GETS(paddr_t addr)
 	/* Create a new message to send on the bus */
 	Mreq * new_request;
 	/* The arguments to Mreq are -- msg, address, src_id (optional), dest_id (optional) */
-	new_request = new Mreq(GETS,addr);
+	new_request = new Mreq(sim, GETS,addr);
 	/* This will but the message in the bus' arbitration queue to sent */
 	this->my_table->write_to_bus(new_request);
 }
@@ -41,13 +41,13 @@ void Protocol::send_DATA_on_bus(paddr_t addr, ModuleID dest)
 	Mreq * new_request;
 	/* The arguments to Mreq are -- msg, address, src_id (optional), dest_id (optional) */
 	// When DATA is sent on the bus it _MUST_ have a destination module
-	new_request = new Mreq(DATA, addr, my_table->moduleID, dest);
+	new_request = new Mreq(sim, DATA, addr, my_table->moduleID, dest);
 	/* Debug Message -- DO NOT REMOVE or you won't match the validation runs */
-	fprintf(stderr,"**** DATA_SEND Cache: %d -- Clock: %lld\n",my_table->moduleID.nodeID,Global_Clock);
+	sim->log->cache_data_send (my_table->moduleID);
 	/* This will but the message in the bus' arbitration queue to sent */
 	this->my_table->write_to_bus(new_request);
 
-	Sim->cache_to_cache_transfers++;
+	sim->cache_to_cache_transfers++;
 }
 
 void Protocol::send_DATA_to_proc(paddr_t addr)
@@ -56,21 +56,117 @@ void Protocol::send_DATA_to_proc(paddr_t addr)
 	Mreq * new_request;
 	/* The arguments to Mreq are -- msg, address, src_id (optional), dest_id (optional) */
 	// When data is sent from a cache to proc, there is no need to set the src and dest
-	new_request = new Mreq(DATA,addr);
+	new_request = new Mreq(sim, DATA,addr);
 	/* This writes the message into the processor's input buffer.  The processor
 	 * only expects to ever receive DATA messages
 	 */
 	this->my_table->write_to_proc(new_request);
 }
 
+/** A store to a line we hold.  Falls back to a GETM with upgrades off.
+ *  On the bus the cache keeps the request, so that it can go out as a GETM
+ *  instead if another core takes the line before it gets the bus.  */
+void Protocol::send_UPGRADE(paddr_t addr)
+{
+	Mreq * new_request;
+
+	if (!sim->settings.upgrade_enabled)
+	{
+		send_GETM(addr);
+		return;
+	}
+
+	new_request = new Mreq(sim, UPGRADE, addr);
+	if (!sim->settings.dir_enabled)
+		my_table->upgrades[addr] = new_request;
+	this->my_table->write_to_bus(new_request);
+
+	sim->upgrades++;
+}
+
+/** A snooping bus needs no word of a clean line going, only a directory
+ *  does.  Returns false if nothing was sent and the line can just go.  */
+bool Protocol::send_PUT(message_t msg, paddr_t addr)
+{
+	Mreq * new_request;
+
+	if ((msg == PUTE || msg == PUTS) && !sim->settings.dir_enabled)
+		return false;
+
+	new_request = new Mreq(sim, msg, addr);
+	this->my_table->write_to_bus(new_request);
+	return true;
+}
+
+/** Data phase of our own PUT on the bus: the line for the home memory
+ *  controller, or an ACK if another cache took the line in the meantime.  */
+void Protocol::send_writeback(paddr_t addr, bool has_data)
+{
+	Mreq * new_request;
+
+	new_request = new Mreq(sim, has_data ? DATA : ACK, addr, my_table->moduleID,
+	                       (ModuleID){sim->home_mc (addr), MC_M});
+	this->my_table->write_to_bus(new_request);
+}
+
+/** Update protocols: a store to a shared line, broadcast so every other
+ *  copy takes the new word.  */
+void Protocol::send_BUSUPD(paddr_t addr)
+{
+	Mreq * new_request;
+
+	new_request = new Mreq(sim, BUSUPD, addr);
+	this->my_table->write_to_bus(new_request);
+
+	sim->bus_updates++;
+}
+
+/** Data phase of our own BUSUPD.  It comes back to us with the shared line
+ *  the other copies raised during the address phase.  */
+void Protocol::send_WORD(paddr_t addr)
+{
+	Mreq * new_request;
+
+	new_request = new Mreq(sim, WORD, addr, my_table->moduleID, my_table->moduleID);
+	this->my_table->write_to_bus(new_request);
+}
+
+/** A GETS for a line we hold in M.  If the detector has it down as
+ *  migratory, the reader takes the line exclusively and we let it go.
+ *  Returns false if nothing was sent and the line is to be shared.  */
+bool Protocol::send_DATA_migratory(const Mreq *request)
+{
+	Mreq * new_request;
+
+	if (!my_table->migratory ||
+	    !my_table->migratory->hand_over(request->addr, request->src_mid.nodeID))
+		return false;
+
+	new_request = new Mreq(sim, DATA, request->addr, my_table->moduleID, request->src_mid);
+	new_request->migratory = true;
+	sim->log->cache_data_send (my_table->moduleID);
+	this->my_table->write_to_bus(new_request);
+
+	sim->cache_to_cache_transfers++;
+	sim->migratory_handoffs++;
+	return true;
+}
+
 void Protocol::set_shared_line ()
 {
-	// Set the bus' shared line
-	Sim->bus->shared_line = true;
+	// Set the bus' shared line.  A directory gets it in our snoop reply.
+	if (sim->settings.dir_enabled)
+		my_table->shared_line = true;
+	else if (sim->parallel_phase)
+		sim->Nd[my_table->moduleID.nodeID]->staged_shared = true;
+	else
+		sim->bus->shared_line = true;
 }
 
 bool Protocol::get_shared_line ()
 {
-	// Find out if the shared line is active
-	return Sim->bus->is_shared_active();
+	// Find out if the shared line is active.  A directory sends it with the DATA.
+	if (sim->settings.dir_enabled)
+		return my_table->shared_line;
+	return sim->bus->is_shared_active();
 }
@@ -17,24 +17,43 @@ public:
 
 	/** This is a pointer to the cache the protocol belongs to */
     Hash_table *my_table;
-    /** This is a pointer to the cache entry the protocol was called on */
-    Hash_entry *my_entry;
+    /** The simulation the cache is part of */
+    Simulator *sim;
+    /** State a newly allocated line starts in.  Set by each child. */
+    uint8_t initial_state;
 
-    Protocol (Hash_table *my_table, Hash_entry *my_entry);
+    /** A protocol object holds no per-line state: each cache owns one
+     * and runs it over the state byte of whichever entry is accessed.
+     */
+    Protocol (Hash_table *my_table);
     virtual ~Protocol();
 
     /** This virtual function must be implemented by all children
      * This function handles requests that come from the processor
      */
-    virtual void process_cache_request (Mreq *request) =0;
+    virtual void process_cache_request (Hash_entry *entry, Mreq *request) =0;
     /** This virtual function must be implemented by all children
 	 * This function handles requests that come from the bus
 	 */
-    virtual void process_snoop_request (Mreq *request) =0;
+    virtual void process_snoop_request (Hash_entry *entry, const Mreq *request) =0;
     /** This virtual function must be implemented by all children
 	 * This function dumps the coherence state (Useful for debugging)
 	 */
-    virtual void dump (void) =0;  
+    virtual void dump (Hash_entry *entry) =0;  
+    /** These virtual functions must be implemented by all children
+     * They let a finite cache pick a victim: only lines in a stable state
+     * may be evicted, and invalid lines are preferred.
+     */
+    virtual bool is_stable (Hash_entry *entry) =0;
+    virtual bool is_invalid (Hash_entry *entry) =0;
+    /** This virtual function must be implemented by all children
+     * A finite cache calls it on the stable, valid line it is about to
+     * replace.  The protocol sends whatever PUT the state needs and moves
+     * the line to a transient state, after which the cache keeps it in its
+     * writeback buffer until the protocol takes it to invalid.  A line
+     * left invalid is dropped there and then.
+     */
+    virtual void evict (Hash_entry *entry) =0;
 
     /** These helper functions are provided to you to make it easier to
      * interface with the processor and bus.
@@ -46,6 +65,12 @@ public:
     void send_GETS(paddr_t addr);
     void send_DATA_on_bus(paddr_t addr, ModuleID dest);
     void send_DATA_to_proc(paddr_t addr);
+    void send_UPGRADE(paddr_t addr);
+    bool send_PUT(message_t msg, paddr_t addr);
+    void send_writeback(paddr_t addr, bool has_data);
+    void send_BUSUPD(paddr_t addr);
+    void send_WORD(paddr_t addr);
+    bool send_DATA_migratory(const Mreq *request);
     /** These helper functions are for setting and getting the bus' shared line */
     void set_shared_line();
     bool get_shared_line();
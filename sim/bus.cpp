@@ -1,23 +1,64 @@
 #include "bus.h"
 #include "mreq.h"
+#include "settings.h"
+#include "sim.h"
 
-Bus::Bus()
+Bus::Bus(Simulator *sim)
 {
+    this->sim = sim;
     current_request = NULL;
     data_reply = NULL;
     request_in_progress = false;
     shared_line = false;
+    next_txn_id = 0;
+
+    busy_until = 0;
+    busy_cycles = 0;
+    data_bytes = 0;
+
+    if (sim->settings.bus_width < 0 || sim->settings.bus_word_size < 1)
+        fatal_error ("Bus: invalid bus_width %d or bus_word_size %d\n",
+                     sim->settings.bus_width, sim->settings.bus_word_size);
+}
+
+/** An address phase that waits on a data phase.  An UPGRADE is done as
+ *  soon as everyone has snooped it.  */
+static bool has_data_phase (const Mreq *request)
+{
+	return (!is_data_phase(request->msg) && request->msg != UPGRADE);
 }
 
 Bus::~Bus()
 {
+	LIST<Mreq *>::iterator it;
+
+	for (it = pending_requests.begin(); it != pending_requests.end(); it++)
+		delete *it;
+	for (it = data_replies.begin(); it != data_replies.end(); it++)
+		delete *it;
+
+	delete current_request;
+	delete data_reply;
 }
 
 void Bus::tick()
 {
+	if (sim->settings.bus_split_transaction)
+	{
+		tick_split ();
+		return;
+	}
+
 	if (current_request)
 		delete current_request;
 
+	/** The last phase still holds the bus.  */
+	if (Global_Clock < busy_until)
+	{
+		current_request = NULL;
+		return;
+	}
+
 	if (request_in_progress)
 	{
 		if (data_reply)
@@ -36,17 +77,151 @@ void Bus::tick()
 		shared_line = false;
 	    current_request = pending_requests.front();
 	    pending_requests.pop_front();
-	    request_in_progress = true;
+	    request_in_progress = has_data_phase(current_request);
 	}
 	else
 	{
 		current_request = NULL;
 	}
+
+	if (current_request)
+		occupy(current_request);
+}
+
+/** Account for a phase going on the bus.  A line of DATA or a BUSUPD's
+ *  WORD takes its bytes over bus_width bytes a cycle, everything else one
+ *  cycle.  */
+void Bus::occupy(const Mreq *phase)
+{
+	int bytes = 0;
+	int cycles = 1;
+
+	if (phase->msg == DATA)
+		bytes = sim->settings.cache_line_size;
+	else if (phase->msg == WORD)
+		bytes = sim->settings.bus_word_size;
+
+	if (bytes && sim->settings.bus_width)
+		cycles = (bytes + sim->settings.bus_width - 1) / sim->settings.bus_width;
+
+	busy_until = Global_Clock + cycles;
+	busy_cycles += cycles;
+	data_bytes += bytes;
+}
+
+/** Split-transaction bus.  Each cycle carries either the oldest data
+ *  response or a new address phase, with data taking priority so that
+ *  transactions drain.  Address phases issue out of order across lines
+ *  but in order for any one line, up to bus_max_outstanding at once.  */
+void Bus::tick_split()
+{
+	MAP<paddr_t, bus_txn_t>::iterator txn;
+	LIST<Mreq *>::iterator it;
+
+	/** Latch the shared line for the address phase that just finished.  */
+	if (current_request && has_data_phase(current_request))
+		outstanding[current_request->addr].shared = shared_line;
+
+	delete current_request;
+	current_request = NULL;
+
+	if (Global_Clock < busy_until)
+		return;
+
+	while (!data_replies.empty())
+	{
+		Mreq *reply = data_replies.front();
+		data_replies.pop_front();
+
+		/** Late duplicate, e.g. memory and a cache both answered.  */
+		txn = outstanding.find(reply->addr);
+		if (txn == outstanding.end() || txn->second.txn_id != reply->txn_id)
+		{
+			delete reply;
+			continue;
+		}
+
+		shared_line = txn->second.shared;
+		outstanding.erase(txn);
+		current_request = reply;
+		occupy(current_request);
+		return;
+	}
+
+	if ((int)outstanding.size() >= sim->settings.bus_max_outstanding)
+		return;
+
+	for (it = pending_requests.begin(); it != pending_requests.end(); it++)
+	{
+		if (outstanding.count((*it)->addr))
+			continue;
+
+		current_request = *it;
+		pending_requests.erase(it);
+		shared_line = false;
+		occupy(current_request);
+
+		if (!has_data_phase(current_request))
+			return;
+
+		current_request->txn_id = next_txn_id++;
+		outstanding[current_request->addr].txn_id = current_request->txn_id;
+		outstanding[current_request->addr].shared = false;
+		return;
+	}
 }
 
+/** The bus only changes state when it has something to retire or issue.
+ *  Pending requests cannot issue while a transaction waits on its data,
+ *  and nothing issues before the last phase lets go of the bus.  */
+timestamp_t Bus::next_event()
+{
+	if (current_request)
+		return Global_Clock;
+
+	if (sim->settings.bus_split_transaction)
+	{
+		LIST<Mreq *>::iterator it;
+
+		if (!data_replies.empty())
+			return max(Global_Clock, busy_until);
+
+		if ((int)outstanding.size() < sim->settings.bus_max_outstanding)
+			for (it = pending_requests.begin(); it != pending_requests.end(); it++)
+				if (!outstanding.count((*it)->addr))
+					return max(Global_Clock, busy_until);
+
+		return NEVER;
+	}
+
+	if (data_reply)
+		return max(Global_Clock, busy_until);
+
+	if (!request_in_progress && !pending_requests.empty())
+		return max(Global_Clock, busy_until);
+
+	return NEVER;
+}
+
+/** DATA, a BUSUPD's WORD, or the ACK a cache sends in place of the line
+ *  when its own PUT turned out stale, is a data phase.  Everything else is
+ *  an address phase.  */
 bool Bus::bus_request(Mreq *request)
 {
-	if (request->msg == DATA)
+	bool data_phase = is_data_phase(request->msg);
+
+	if (data_phase && sim->settings.bus_split_transaction)
+	{
+		/** Caches answer without knowing the transaction, tag it for them.  */
+		if (request->txn_id < 0)
+		{
+			MAP<paddr_t, bus_txn_t>::iterator txn = outstanding.find(request->addr);
+			if (txn != outstanding.end())
+				request->txn_id = txn->second.txn_id;
+		}
+		data_replies.push_back(request);
+	}
+	else if (data_phase)
 	{
 		assert (data_reply == NULL);
 		data_reply = request;
@@ -59,18 +234,8 @@ bool Bus::bus_request(Mreq *request)
 	return true;
 }
 
-Mreq* Bus::bus_snoop()
+/** Every snooper sees the same transaction.  The bus frees it on its next tick.  */
+const Mreq* Bus::bus_snoop()
 {
-    Mreq *request;
-
-    if (current_request)
-    {
-        request = new Mreq ();
-        *request = *current_request;
-        return request;
-    }
-    else
-    {
-        return NULL;
-    }
+    return current_request;
 }
@@ -4,12 +4,21 @@
 #include "types.h"
 
 class Mreq;
+class Simulator;
+
+/** A split-transaction address phase still waiting on its data phase.  */
+typedef struct {
+    int txn_id;
+    bool shared;             /** Shared line as snooped during the address phase.  */
+} bus_txn_t;
 
 class Bus{
 public:
-    Bus();
+    Bus(Simulator *sim);
     ~Bus();
 
+    Simulator *sim;
+
     //TODO: Add shared, flush lines, etc...
 
 	Mreq *current_request;
@@ -20,11 +29,26 @@ public:
 
     bool shared_line;
 
+    /** Split-transaction mode.  At most one transaction per line is in
+     *  flight, so a line address names its transaction uniquely.  */
+    LIST <Mreq *>data_replies;
+    MAP <paddr_t, bus_txn_t>outstanding;
+    int next_txn_id;
+
+    /** A phase holds the bus for as many cycles as its bytes need at
+     *  bus_width bytes a cycle, the address alone taking one.  */
+    timestamp_t busy_until;
+    counter_t busy_cycles;
+    counter_t data_bytes;
+
     void tick ();
+    void tick_split ();
+    void occupy (const Mreq *phase);
+    timestamp_t next_event ();
 
     bool is_shared_active () { return shared_line; }
     bool bus_request (Mreq * request);
-    Mreq *bus_snoop();
+    const Mreq *bus_snoop();
 };
 
 #endif
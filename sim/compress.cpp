@@ -0,0 +1,408 @@
+#include <ctype.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "compress.h"
+#include "sim.h"
+
+Byte_source::~Byte_source ()
+{
+}
+
+/*************************
+ * gzip.
+ *************************/
+#ifdef TRACE_GZIP
+Gzip_source::Gzip_source (const char *file)
+{
+    gz = gzopen (file, "rb");
+    if (!gz)
+        fatal_error ("Trace: unable to open %s\n", file);
+    gzbuffer (gz, TRACE_CHUNK_SIZE);
+}
+
+Gzip_source::~Gzip_source ()
+{
+    gzclose (gz);
+}
+
+size_t Gzip_source::read (uint8_t *buf, size_t len)
+{
+    int n = gzread (gz, buf, len);
+    int err;
+
+    if (n < 0)
+        fatal_error ("Trace: gzip error %s\n", gzerror (gz, &err));
+    return n;
+}
+#endif
+
+/*************************
+ * xz.
+ *************************/
+#ifdef TRACE_XZ
+Xz_source::Xz_source (const char *file)
+{
+    lzma_stream init = LZMA_STREAM_INIT;
+
+    infile = fopen (file, "rb");
+    if (!infile)
+        fatal_error ("Trace: unable to open %s\n", file);
+
+    strm = init;
+    if (lzma_stream_decoder (&strm, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+        fatal_error ("Trace: unable to start the xz decoder for %s\n", file);
+
+    in = new uint8_t[TRACE_CHUNK_SIZE];
+    at_end = false;
+    done = false;
+}
+
+Xz_source::~Xz_source ()
+{
+    lzma_end (&strm);
+    delete [] in;
+    fclose (infile);
+}
+
+size_t Xz_source::read (uint8_t *buf, size_t len)
+{
+    if (done)
+        return 0;
+
+    strm.next_out = buf;
+    strm.avail_out = len;
+
+    while (strm.avail_out)
+    {
+        lzma_ret ret;
+
+        if (!strm.avail_in && !at_end)
+        {
+            strm.next_in = in;
+            strm.avail_in = fread (in, 1, TRACE_CHUNK_SIZE, infile);
+            if (ferror (infile))
+                fatal_error ("Trace: read error on an xz trace\n");
+            at_end = (strm.avail_in < TRACE_CHUNK_SIZE);
+        }
+
+        ret = lzma_code (&strm, at_end ? LZMA_FINISH : LZMA_RUN);
+        if (ret == LZMA_STREAM_END)
+        {
+            done = true;
+            break;
+        }
+        if (ret != LZMA_OK)
+            fatal_error ("Trace: xz error %d\n", ret);
+    }
+
+    return len - strm.avail_out;
+}
+#endif
+
+/*************************
+ * zstd.
+ *************************/
+#ifdef TRACE_ZSTD
+Zstd_source::Zstd_source (const char *file)
+{
+    infile = fopen (file, "rb");
+    if (!infile)
+        fatal_error ("Trace: unable to open %s\n", file);
+
+    dctx = ZSTD_createDCtx ();
+    if (!dctx)
+        fatal_error ("Trace: unable to start the zstd decoder for %s\n", file);
+
+    in = new uint8_t[TRACE_CHUNK_SIZE];
+    in_len = 0;
+    in_pos = 0;
+    at_end = false;
+}
+
+Zstd_source::~Zstd_source ()
+{
+    ZSTD_freeDCtx (dctx);
+    delete [] in;
+    fclose (infile);
+}
+
+size_t Zstd_source::read (uint8_t *buf, size_t len)
+{
+    ZSTD_outBuffer out = {buf, len, 0};
+
+    while (out.pos < out.size)
+    {
+        ZSTD_inBuffer input;
+        size_t before = out.pos;
+        size_t ret;
+
+        if (in_pos == in_len && !at_end)
+        {
+            in_len = fread (in, 1, TRACE_CHUNK_SIZE, infile);
+            in_pos = 0;
+            if (ferror (infile))
+                fatal_error ("Trace: read error on a zstd trace\n");
+            at_end = (in_len < TRACE_CHUNK_SIZE);
+        }
+
+        input.src = in;
+        input.size = in_len;
+        input.pos = in_pos;
+        ret = ZSTD_decompressStream (dctx, &out, &input);
+        if (ZSTD_isError (ret))
+            fatal_error ("Trace: zstd error %s\n", ZSTD_getErrorName (ret));
+        in_pos = input.pos;
+
+        /** Input used up and nothing more flushed out of the decoder.  */
+        if (at_end && in_pos == in_len && out.pos == before)
+            break;
+    }
+
+    return out.pos;
+}
+#endif
+
+/*************************
+ * Decompression threads.
+ *************************/
+Threaded_source::Threaded_source (Byte_source *source)
+{
+    this->source = source;
+    for (int i = 0; i < TRACE_CHUNKS_AHEAD; i++)
+    {
+        chunk[i].data = new uint8_t[TRACE_CHUNK_SIZE];
+        chunk[i].len = 0;
+    }
+    filled = 0;
+    used = 0;
+    pos = 0;
+    stop = false;
+
+    pthread_mutex_init (&lock, NULL);
+    pthread_cond_init (&changed, NULL);
+    if (pthread_create (&thread, NULL, worker, this))
+        fatal_error ("Trace: unable to start a decompression thread\n");
+}
+
+Threaded_source::~Threaded_source ()
+{
+    pthread_mutex_lock (&lock);
+    stop = true;
+    pthread_cond_broadcast (&changed);
+    pthread_mutex_unlock (&lock);
+    pthread_join (thread, NULL);
+
+    pthread_cond_destroy (&changed);
+    pthread_mutex_destroy (&lock);
+    for (int i = 0; i < TRACE_CHUNKS_AHEAD; i++)
+        delete [] chunk[i].data;
+    delete source;
+}
+
+size_t Threaded_source::read (uint8_t *buf, size_t len)
+{
+    size_t n;
+
+    pthread_mutex_lock (&lock);
+    while (filled == used)
+        pthread_cond_wait (&changed, &lock);
+    pthread_mutex_unlock (&lock);
+
+    /** An empty chunk marks the end and stays put.  */
+    n = min (len, chunk[used % TRACE_CHUNKS_AHEAD].len - pos);
+    if (!n)
+        return 0;
+
+    memcpy (buf, chunk[used % TRACE_CHUNKS_AHEAD].data + pos, n);
+    pos += n;
+    if (pos == chunk[used % TRACE_CHUNKS_AHEAD].len)
+    {
+        pos = 0;
+        pthread_mutex_lock (&lock);
+        used++;
+        pthread_cond_broadcast (&changed);
+        pthread_mutex_unlock (&lock);
+    }
+    return n;
+}
+
+void *Threaded_source::worker (void *arg)
+{
+    Threaded_source *self = (Threaded_source *)arg;
+    size_t len;
+
+    do {
+        int slot;
+
+        pthread_mutex_lock (&self->lock);
+        while (self->filled - self->used == TRACE_CHUNKS_AHEAD && !self->stop)
+            pthread_cond_wait (&self->changed, &self->lock);
+        if (self->stop)
+        {
+            pthread_mutex_unlock (&self->lock);
+            return NULL;
+        }
+        slot = self->filled % TRACE_CHUNKS_AHEAD;
+        pthread_mutex_unlock (&self->lock);
+
+        /** The reader keeps off slots past filled.  */
+        len = self->source->read (self->chunk[slot].data, TRACE_CHUNK_SIZE);
+        self->chunk[slot].len = len;
+
+        pthread_mutex_lock (&self->lock);
+        self->filled++;
+        pthread_cond_broadcast (&self->changed);
+        pthread_mutex_unlock (&self->lock);
+    } while (len);
+
+    return NULL;
+}
+
+/*************************
+ * Traces out of a stream.
+ *************************/
+Stream_trace_reader::Stream_trace_reader (Byte_source *source, bool binary, const char *trace_file)
+{
+    this->source = source;
+    this->binary = binary;
+    version = 0;
+    prev_addr = 0;
+    buf = new uint8_t[TRACE_CHUNK_SIZE];
+    pos = 0;
+    len = 0;
+
+    if (binary)
+    {
+        btrace_header_t header;
+        uint8_t *p = (uint8_t *)&header;
+
+        for (size_t i = 0; i < sizeof (header); i++)
+        {
+            int c = get ();
+
+            if (c == EOF)
+                fatal_error ("Trace: %s is too short to be a binary trace\n", trace_file);
+            p[i] = c;
+        }
+
+        if (memcmp (header.magic, BTRACE_MAGIC, sizeof (header.magic)) ||
+            header.version < 1 || header.version > BTRACE_VERSION)
+            fatal_error ("Trace: %s is not a version 1-%d binary trace\n", trace_file, BTRACE_VERSION);
+        version = header.version;
+    }
+}
+
+Stream_trace_reader::~Stream_trace_reader ()
+{
+    delete [] buf;
+    delete source;
+}
+
+bool Stream_trace_reader::next (trace_ref_t *ref)
+{
+    return binary ? next_binary (ref) : next_text (ref);
+}
+
+/** Lines of "r|w 0xADDR [gap]", read as Text_trace_reader's sscanf does:
+ *  blanks may come between the 0x and the digits, as %llx skips them.  */
+bool Stream_trace_reader::next_text (trace_ref_t *ref)
+{
+    paddr_t addr = 0;
+    uint32_t gap = 0;
+    int digits = 0;
+    int c;
+
+    do c = get (); while (c != EOF && isspace (c));
+    if (c == EOF)
+        return false;
+    ref->op = c;
+
+    do c = get (); while (c != EOF && isspace (c));
+    if (c != '0' || get () != 'x')
+        fatal_error ("Trace: bad text trace line, no 0x after %c\n", ref->op);
+
+    do c = get (); while (c == ' ' || c == '\t');
+    for ( ; c != EOF && isxdigit (c); c = get ())
+    {
+        addr = (addr << 4) | (isdigit (c) ? c - '0' : tolower (c) - 'a' + 10);
+        digits++;
+    }
+    if (!digits)
+        fatal_error ("Trace: bad text trace line, no address after %c 0x\n", ref->op);
+
+    while (c == ' ' || c == '\t')
+        c = get ();
+    while (c != EOF && isdigit (c))
+    {
+        gap = gap * 10 + (c - '0');
+        c = get ();
+    }
+    if (c != EOF)
+        pos--;
+
+    ref->addr = addr;
+    ref->gap = gap;
+    return true;
+}
+
+/** LEB128 varint starting with byte c.  */
+uint64_t Stream_trace_reader::get_varint (int c)
+{
+    uint64_t v = 0;
+    int shift = 0;
+
+    while (1)
+    {
+        if (c == EOF)
+            fatal_error ("Trace: truncated binary trace\n");
+        v |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+        if (!(c & 0x80))
+            return v;
+        c = get ();
+    }
+}
+
+bool Stream_trace_reader::next_binary (trace_ref_t *ref)
+{
+    int c = get ();
+
+    if (c == EOF)
+        return false;
+
+    if (btrace_unpack (get_varint (c), version, &prev_addr, ref))
+        ref->gap = (uint32_t)get_varint (get ());
+    return true;
+}
+
+Byte_source *open_compressed (const char *file, bool threaded)
+{
+    char name[1000];
+    Byte_source *source = NULL;
+
+#ifdef TRACE_GZIP
+    snprintf (name, sizeof (name), "%s.gz", file);
+    if (!source && !access (name, R_OK))
+        source = new Gzip_source (name);
+#endif
+#ifdef TRACE_XZ
+    snprintf (name, sizeof (name), "%s.xz", file);
+    if (!source && !access (name, R_OK))
+        source = new Xz_source (name);
+#endif
+#ifdef TRACE_ZSTD
+    snprintf (name, sizeof (name), "%s.zst", file);
+    if (!source && !access (name, R_OK))
+        source = new Zstd_source (name);
+#endif
+
+    if (source && threaded)
+        source = new Threaded_source (source);
+    return source;
+}
+
+int spare_cpus (int busy)
+{
+    return max (0, (int)sysconf (_SC_NPROCESSORS_ONLN) - busy);
+}
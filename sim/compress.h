@@ -0,0 +1,160 @@
+#ifndef COMPRESS_H_
+#define COMPRESS_H_
+
+#include <pthread.h>
+#include <stdio.h>
+
+#ifdef TRACE_GZIP
+#include <zlib.h>
+#endif
+#ifdef TRACE_XZ
+#include <lzma.h>
+#endif
+#ifdef TRACE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "trace.h"
+#include "types.h"
+
+/**
+ * Compressed traces.
+ *
+ * pN.trace and pN.btrace may also be stored as pN.trace.gz, .xz or .zst.
+ * They are decompressed a chunk at a time as the trace is read, so memory
+ * stays at a few chunks per core whatever the size of the trace.  Which
+ * formats are built in is picked at build time, see sim/makefile.
+ */
+#define TRACE_CHUNK_SIZE     (256 * 1024)
+
+/** Chunks a decompression thread may run ahead of its reader.  */
+#define TRACE_CHUNKS_AHEAD   4
+
+/** A stream of bytes, plain or decompressed on the fly.  */
+class Byte_source {
+public:
+    virtual ~Byte_source ();
+
+    /** Up to len bytes into buf, 0 at end of stream.  */
+    virtual size_t read (uint8_t *buf, size_t len) =0;
+};
+
+#ifdef TRACE_GZIP
+class Gzip_source : public Byte_source {
+public:
+    Gzip_source (const char *file);
+    ~Gzip_source ();
+
+    gzFile gz;
+
+    size_t read (uint8_t *buf, size_t len);
+};
+#endif
+
+#ifdef TRACE_XZ
+class Xz_source : public Byte_source {
+public:
+    Xz_source (const char *file);
+    ~Xz_source ();
+
+    FILE *infile;
+    lzma_stream strm;
+    uint8_t *in;
+    bool at_end;
+    bool done;
+
+    size_t read (uint8_t *buf, size_t len);
+};
+#endif
+
+#ifdef TRACE_ZSTD
+class Zstd_source : public Byte_source {
+public:
+    Zstd_source (const char *file);
+    ~Zstd_source ();
+
+    FILE *infile;
+    ZSTD_DCtx *dctx;
+    uint8_t *in;
+    size_t in_len;
+    size_t in_pos;
+    bool at_end;
+
+    size_t read (uint8_t *buf, size_t len);
+};
+#endif
+
+/**
+ * Runs another source on a thread of its own, which decompresses up to
+ * TRACE_CHUNKS_AHEAD chunks ahead of the reader.
+ */
+class Threaded_source : public Byte_source {
+public:
+    Threaded_source (Byte_source *source);
+    ~Threaded_source ();
+
+    Byte_source *source;
+
+    struct {
+        uint8_t *data;
+        size_t len;
+    } chunk[TRACE_CHUNKS_AHEAD];
+
+    /** Chunks filled and chunks used up, only ever counting up.  */
+    unsigned int filled;
+    unsigned int used;
+    size_t pos;
+    bool stop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+
+    size_t read (uint8_t *buf, size_t len);
+
+    static void *worker (void *arg);
+};
+
+/** Text or binary trace read out of a Byte_source.  */
+class Stream_trace_reader : public Trace_reader {
+public:
+    Stream_trace_reader (Byte_source *source, bool binary, const char *trace_file);
+    ~Stream_trace_reader ();
+
+    Byte_source *source;
+    bool binary;
+    uint32_t version;
+    paddr_t prev_addr;
+
+    uint8_t *buf;
+    size_t pos;
+    size_t len;
+
+    int get (void)
+    {
+        if (pos == len)
+        {
+            len = source->read (buf, TRACE_CHUNK_SIZE);
+            pos = 0;
+            if (!len)
+                return EOF;
+        }
+        return buf[pos++];
+    }
+
+    bool next (trace_ref_t *ref);
+    bool next_text (trace_ref_t *ref);
+    bool next_binary (trace_ref_t *ref);
+    uint64_t get_varint (int c);
+};
+
+/**
+ * Source for the compressed form of file, trying each suffix built in,
+ * NULL if there is none.  threaded decompresses on a thread of its own.
+ */
+Byte_source *open_compressed (const char *file, bool threaded);
+
+/** Host CPUs left over once busy of them are taken.  */
+int spare_cpus (int busy);
+
+#endif // COMPRESS_H_
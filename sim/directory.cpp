@@ -0,0 +1,246 @@
+#include "directory.h"
+#include "event_log.h"
+#include "sim.h"
+
+/***************************
+ * Directory_entry.
+ ***************************/
+Directory_entry::Directory_entry ()
+{
+    request = NULL;
+    txn_id = -1;
+    acks_pending = 0;
+    shared = false;
+    cache_data = false;
+    mem_data = false;
+}
+
+Directory_entry::~Directory_entry ()
+{
+    LIST<Mreq*>::iterator it;
+
+    for (it = waiting.begin (); it != waiting.end (); it++)
+        delete *it;
+    delete request;
+}
+
+/***************************
+ * Directory.
+ ***************************/
+Directory::Directory (Simulator *sim, ModuleID moduleID, int lookup_time)
+    : Module (sim, moduleID, "DIR")
+{
+    this->lookup_time = lookup_time;
+    next_txn_id = 0;
+    forwards = 0;
+}
+
+Directory::~Directory ()
+{
+    MAP<paddr_t, Directory_entry*>::iterator it;
+    IO_PORT::iterator msg;
+
+    for (it = entries.begin (); it != entries.end (); it++)
+        delete it->second;
+
+    for (msg = outbox.begin (); msg != outbox.end (); msg++)
+        delete msg->second;
+}
+
+void Directory::tick (void)
+{
+    const Mreq *request;
+    Directory_entry *entry;
+    MAP<paddr_t, Directory_entry*>::iterator it;
+
+    request = read_input_port ();
+    if (request)
+    {
+        it = entries.find (request->addr);
+        if (it == entries.end ())
+            it = entries.insert (pair<paddr_t, Directory_entry*> (request->addr, new Directory_entry ())).first;
+        entry = it->second;
+
+        switch (request->msg) {
+        case GETS:
+        case GETM:
+        case UPGRADE:
+            /** One transaction per line, later requests wait their turn.  */
+            if (entry->request)
+                entry->waiting.push_back (new Mreq (*request));
+            else
+                start (entry, new Mreq (*request));
+            break;
+        case PUTM:
+        case PUTO:
+        case PUTE:
+        case PUTS:
+            if (entry->request)
+                entry->waiting.push_back (new Mreq (*request));
+            else
+                put (entry, request);
+            break;
+        case DATA:
+        case ACK:
+            respond (entry, request);
+            break;
+        default:
+            request->print_msg (moduleID, "ERROR");
+            fatal_error ("%s: unexpected message\n", name);
+        }
+    }
+
+    /** Send whatever has finished its lookup.  */
+    while (!outbox.empty () && outbox.begin ()->first <= Global_Clock)
+    {
+        write_output_port (outbox.begin ()->second);
+        outbox.erase (outbox.begin ());
+    }
+}
+
+void Directory::send (Mreq *msg, int delay)
+{
+    outbox.insert (pair<timestamp_t, Mreq*> (Global_Clock + delay, msg));
+}
+
+/** Forward request to the other sharers and start the memory read.  */
+void Directory::start (Directory_entry *entry, Mreq *request)
+{
+    Mreq *msg;
+    int requester = request->src_mid.nodeID;
+
+    entry->request = request;
+    entry->txn_id = next_txn_id++;
+    entry->acks_pending = 0;
+    entry->shared = false;
+    entry->cache_data = false;
+    entry->mem_data = false;
+
+    /** A sharer lost its copy to a GETM or UPGRADE ordered ahead of this one.  */
+    if (request->msg == UPGRADE && !entry->sharers.is_sharer (requester))
+        request->msg = GETM;
+
+    for (int node = 0; node < sim->settings.num_nodes; node++)
+    {
+        if (node == requester || !entry->sharers.is_sharer (node))
+            continue;
+
+        /** The snoop still names the requester, protocols answer its src.  */
+        msg = new Mreq (sim, request->msg, request->addr, request->src_mid, (ModuleID){node, L1_M});
+        msg->fwd_mid = moduleID;
+        msg->txn_id = entry->txn_id;
+        send (msg, lookup_time);
+        entry->acks_pending++;
+        forwards++;
+    }
+
+    /** The requester has the data, it only waits for the other copies to go.  */
+    if (request->msg == UPGRADE)
+    {
+        if (entry->acks_pending == 0)
+            finish (entry);
+        return;
+    }
+
+    msg = new Mreq (sim, GETS, request->addr, moduleID, (ModuleID){sim->home_mc (request->addr), MC_M});
+    msg->txn_id = entry->txn_id;
+    send (msg, lookup_time);
+}
+
+void Directory::respond (Directory_entry *entry, const Mreq *response)
+{
+    if (response->src_mid.module_index == MC_M)
+    {
+        /** Late data for a transaction a cache already served.  */
+        if (!entry->request || response->txn_id != entry->txn_id)
+            return;
+        entry->mem_data = true;
+    }
+    else
+    {
+        assert (entry->request && response->txn_id == entry->txn_id);
+        entry->acks_pending--;
+        entry->shared |= response->shared;
+        if (response->msg == DATA)
+            entry->cache_data = true;
+    }
+
+    if (entry->acks_pending == 0 &&
+        (entry->cache_data || entry->mem_data || entry->request->msg == UPGRADE))
+        finish (entry);
+}
+
+/** Hand the line to the requester and move on to the next request.  */
+void Directory::finish (Directory_entry *entry)
+{
+    Mreq *request = entry->request;
+    Mreq *data;
+
+    data = new Mreq (sim, request->msg == UPGRADE ? ACK : DATA, request->addr, moduleID, request->src_mid);
+    data->txn_id = entry->txn_id;
+    data->shared = entry->shared;
+    send (data, request->msg == UPGRADE ? lookup_time : 0);
+
+    /** Every other copy was invalidated by a GETM or UPGRADE.  */
+    if (request->msg == GETM || request->msg == UPGRADE)
+        entry->sharers.clear_sharers ();
+    entry->sharers.add_sharer (request->src_mid.nodeID);
+
+    delete request;
+    entry->request = NULL;
+
+    next (entry);
+}
+
+/** Take back a line evicted by its sender.  */
+void Directory::put (Directory_entry *entry, const Mreq *request)
+{
+    int sender = request->src_mid.nodeID;
+    Mreq *msg;
+
+    if (entry->sharers.is_sharer (sender))
+    {
+        entry->sharers.remove_sharer (sender);
+
+        if (request->msg == PUTM || request->msg == PUTO)
+        {
+            msg = new Mreq (sim, DATA, request->addr, moduleID, (ModuleID){sim->home_mc (request->addr), MC_M});
+            send (msg, lookup_time);
+        }
+    }
+
+    msg = new Mreq (sim, ACK, request->addr, moduleID, request->src_mid);
+    send (msg, lookup_time);
+}
+
+/** Start whatever waited for the line, PUTs need no transaction.  */
+void Directory::next (Directory_entry *entry)
+{
+    while (!entry->request && !entry->waiting.empty ())
+    {
+        Mreq *request = entry->waiting.front ();
+
+        entry->waiting.pop_front ();
+        if (is_put (request->msg))
+        {
+            put (entry, request);
+            delete request;
+        }
+        else
+            start (entry, request);
+    }
+}
+
+void Directory::tock (void)
+{
+    fatal_error ("%s - tock should never be called!", name);
+}
+
+/** Arriving messages are covered by the node's network interface.  */
+timestamp_t Directory::next_event (void)
+{
+    if (outbox.empty ())
+        return NEVER;
+
+    return max (outbox.begin ()->first, (timestamp_t)Global_Clock);
+}
@@ -0,0 +1,80 @@
+#ifndef DIRECTORY_H_
+#define DIRECTORY_H_
+
+#include "module.h"
+#include "mreq.h"
+#include "settings.h"
+#include "sharers.h"
+#include "types.h"
+
+/** Full-map directory state for one line.  */
+class Directory_entry {
+public:
+    Directory_entry ();
+    ~Directory_entry ();
+
+    /** Caches that may hold a copy.  Evicted lines come back with a PUT,
+     *  a cache that handed its copy on before its PUT got here is caught
+     *  when the PUT is.  */
+    Sharers sharers;
+
+    /** The transaction in progress, NULL when the line is idle.  */
+    Mreq *request;
+    int txn_id;
+    int acks_pending;        /** Forwarded snoops not yet answered.  */
+    bool shared;             /** Some forwarded cache kept a copy.  */
+    bool cache_data;         /** A cache supplied the line.  */
+    bool mem_data;           /** Memory supplied the line.  */
+
+    /** Requests for the line that arrived while it was busy.  */
+    LIST<Mreq*> waiting;
+};
+
+/**
+ * Home node directory.
+ *
+ * Stands in for the bus: it orders the GETS/GETM/UPGRADE for each of its lines,
+ * one transaction at a time.  A transaction is forwarded to every sharer
+ * but the requester, each of which answers the home with the DATA its
+ * protocol sent or an ACK, and the shared line it would have raised.
+ * Memory is read in parallel.  Once every sharer has answered and some
+ * copy of the line is in, the home sends the requester DATA carrying the
+ * combined shared line.
+ *
+ * An UPGRADE is only forwarded, the home ACKs the requester once every
+ * other sharer has.  If the requester lost its copy to an earlier GETM or
+ * UPGRADE the home runs it as a GETM instead.
+ *
+ * A PUT waits its turn behind the transactions like a GET but needs no
+ * one else: the home drops the sender from the sharers, passes a PUTM or
+ * PUTO line on to memory and ACKs.  A PUT from a cache that is no longer
+ * a sharer lost a race with a GETM and is only ACKed.
+ */
+class Directory : public Module {
+public:
+    Directory (Simulator *sim, ModuleID moduleID, int lookup_time);
+    ~Directory ();
+
+    int lookup_time;
+    int next_txn_id;
+
+    MAP<paddr_t, Directory_entry*> entries;
+
+    /** Messages waiting out the lookup latency, by send time.  */
+    IO_PORT outbox;
+
+    counter_t forwards;
+
+    void send (Mreq *msg, int delay);
+    void start (Directory_entry *entry, Mreq *request);
+    void respond (Directory_entry *entry, const Mreq *response);
+    void finish (Directory_entry *entry);
+    void put (Directory_entry *entry, const Mreq *request);
+    void next (Directory_entry *entry);
+
+    void tick (void);
+    void tock (void);
+    timestamp_t next_event (void);
+};
+
+#endif // DIRECTORY_H_
@@ -20,6 +20,8 @@ typedef enum {
     MOESI_PRO,
     MOSI_PRO,
     MOESIF_PRO,
+    DRAGON_PRO,
+    FIREFLY_PRO,
     NULL_PRO,
     MEM_PRO
 } protocol_t;
@@ -49,6 +51,32 @@ typedef enum {
 	RP_LRU = 1
 } replacement_policy_t;
 
+/** How memory is split across controllers, see Simulator::home_mc.  */
+typedef enum {
+	MEM_INTERLEAVE_LINE = 0,
+	MEM_INTERLEAVE_PAGE,
+	MEM_INTERLEAVE_XOR
+} mem_interleave_t;
+
+/** DRAM command scheduling, see Memory_controller::schedule.  */
+typedef enum {
+	DRAM_FCFS = 0,
+	DRAM_FR_FCFS
+} dram_scheduler_t;
+
+/** Built in workload, see Synthetic_trace_reader.  */
+typedef enum {
+	SYNTH_NONE = 0,
+	SYNTH_PRIVATE,
+	SYNTH_READ_MOSTLY,
+	SYNTH_MIGRATORY,
+	SYNTH_PRODUCER_CONSUMER,
+	SYNTH_LOCK,
+	SYNTH_FALSE_SHARING,
+	SYNTH_MIX,
+	SYNTH_NUM_PATTERNS
+} synth_pattern_t;
+
 typedef enum {
 	CACHE_SHARED = 1,
 	CACHE_PRIVATE
@@ -0,0 +1,214 @@
+#include <stdarg.h>
+#include <string.h>
+
+#include "event_log.h"
+#include "sim.h"
+
+__thread VECTOR<char> *Event_log::stage = NULL;
+__thread Event_log *Event_log::current = NULL;
+
+Event_log::Event_log (Simulator *sim)
+{
+    this->sim = sim;
+    out = stderr;
+    binary = false;
+    captured = false;
+    buf = new char[EVLOG_BUFFER_SIZE];
+    len = 0;
+}
+
+Event_log::~Event_log ()
+{
+    flush ();
+    if (binary || captured)
+        fclose (out);
+    if (current == this)
+        current = NULL;
+    delete [] buf;
+}
+
+void Event_log::open_binary (const char *log_file)
+{
+    evlog_header_t header;
+
+    flush ();
+
+    out = fopen (log_file, "wb");
+    if (!out)
+        fatal_error ("Event_log: unable to create %s\n", log_file);
+    binary = true;
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, EVLOG_MAGIC, sizeof (header.magic));
+    header.version = EVLOG_VERSION;
+    header.record_size = sizeof (event_record_t);
+    append (&header, sizeof (header));
+}
+
+void Event_log::open_text (const char *log_file)
+{
+    flush ();
+
+    out = fopen (log_file, "w");
+    if (!out)
+        fatal_error ("Event_log: unable to create %s\n", log_file);
+    captured = true;
+}
+
+void Event_log::flush (void)
+{
+    if (len)
+        fwrite (buf, 1, len, out);
+    len = 0;
+    fflush (out);
+}
+
+/** Keeps at least EVLOG_MAX_LINE bytes free, so emit can format in place.  */
+void Event_log::append (const void *data, size_t size)
+{
+    if (stage)
+    {
+        stage->insert (stage->end (), (const char *)data, (const char *)data + size);
+        return;
+    }
+
+    if (len + size > EVLOG_BUFFER_SIZE)
+        flush ();
+
+    if (size >= EVLOG_BUFFER_SIZE)
+        fwrite (data, 1, size, out);
+    else
+    {
+        memcpy (buf + len, data, size);
+        len += size;
+    }
+
+    if (len > EVLOG_BUFFER_SIZE - EVLOG_MAX_LINE)
+        flush ();
+}
+
+void Event_log::emit (const event_record_t *rec)
+{
+    if (binary)
+    {
+        append (rec, sizeof (*rec));
+        return;
+    }
+
+    if (stage)
+    {
+        char line[EVLOG_MAX_LINE];
+
+        append (line, format_event (line, sizeof (line), rec));
+        return;
+    }
+
+    len += format_event (buf + len, EVLOG_BUFFER_SIZE - len, rec);
+    if (len > EVLOG_BUFFER_SIZE - EVLOG_MAX_LINE)
+        flush ();
+}
+
+void Event_log::text (FILE *stream, const char *fmt, ...)
+{
+    char line[EVLOG_MAX_LINE];
+    va_list ap;
+    int n;
+
+    va_start (ap, fmt);
+    n = vsnprintf (line, sizeof (line), fmt, ap);
+    va_end (ap);
+
+    if (n >= (int)sizeof (line))
+        n = sizeof (line) - 1;
+
+    if (binary)
+    {
+        event_record_t rec = {0};
+
+        rec.type = EV_TEXT;
+        rec.arg = (stream == stdout) ? EV_STDOUT : EV_STDERR;
+        rec.addr = n;
+        append (&rec, sizeof (rec));
+        append (line, n);
+    }
+    else if (stream == out || stage || captured)
+        append (line, n);
+    else
+    {
+        /** Keep the two streams in order when they share a terminal or file.  */
+        flush ();
+        fwrite (line, 1, n, stream);
+        fflush (stream);
+    }
+}
+
+/************
+ * Decoding.
+ ************/
+int format_event (char *str, size_t size, const event_record_t *rec)
+{
+    int n = 0;
+
+    switch (rec->type) {
+    case EV_FETCH:
+        return snprintf (str, size, "* FETCH -- PR: %d -- Clock: %lld -- %c 0x%llx\n",
+                         rec->node, (long long int)rec->clock, rec->arg,
+                         (unsigned long long int)rec->addr);
+    case EV_COMPLETE:
+        return snprintf (str, size, "* COMPLETE -- PR: %d -- Clock: %lld\n",
+                         rec->node, (long long int)rec->clock);
+    case EV_PROC_REQUEST:
+    case EV_SNOOP_REQUEST:
+        n += snprintf (str + n, size - n, rec->type == EV_PROC_REQUEST ?
+                       "** PROC REQUEST -- " : "*** SNOOP REQUEST -- ");
+        n += format_id (str + n, size - n, "node", rec->node, (module_t)rec->node_module);
+        n += format_id (str + n, size - n, "src", rec->src, (module_t)rec->src_module);
+        n += format_id (str + n, size - n, "dest", rec->dest, (module_t)rec->dest_module);
+        n += snprintf (str + n, size - n, "tag: 0x%8llx clock: %8lld  %8s\n",
+                       (long long int)rec->addr, (long long int)rec->clock,
+                       Mreq::message_t_str[rec->arg]);
+        return n;
+    case EV_DATA_SEND_MC:
+        return snprintf (str, size, "**** DATA SEND MC -- Clock: %lld\n", (long long int)rec->clock);
+    case EV_DATA_SEND_CACHE:
+        return snprintf (str, size, "**** DATA_SEND Cache: %d -- Clock: %lld\n",
+                         rec->node, (long long int)rec->clock);
+    default:
+        fatal_error ("Event_log: unknown event type %d\n", rec->type);
+    }
+}
+
+void decode_event_log (const char *log_file, FILE *stream)
+{
+    evlog_header_t header;
+    event_record_t rec;
+    char line[EVLOG_MAX_LINE];
+    FILE *in;
+
+    in = fopen (log_file, "rb");
+    if (!in)
+        fatal_error ("Event_log: unable to open %s\n", log_file);
+
+    if (fread (&header, sizeof (header), 1, in) != 1 ||
+        memcmp (header.magic, EVLOG_MAGIC, sizeof (header.magic)) ||
+        header.version != EVLOG_VERSION ||
+        header.record_size != sizeof (event_record_t))
+        fatal_error ("Event_log: %s is not a version %d event log\n", log_file, EVLOG_VERSION);
+
+    while (fread (&rec, sizeof (rec), 1, in) == 1)
+    {
+        if (rec.type == EV_TEXT)
+        {
+            if (rec.addr >= sizeof (line) || fread (line, 1, rec.addr, in) != rec.addr)
+                fatal_error ("Event_log: %s is truncated\n", log_file);
+            fwrite (line, 1, rec.addr, stream);
+        }
+        else
+        {
+            format_event (line, sizeof (line), &rec);
+            fputs (line, stream);
+        }
+    }
+
+    fclose (in);
+}
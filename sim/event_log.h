@@ -0,0 +1,195 @@
+#ifndef EVENT_LOG_H_
+#define EVENT_LOG_H_
+
+#include <stdio.h>
+
+#include "module.h"
+#include "mreq.h"
+#include "settings.h"
+#include "sim.h"
+#include "types.h"
+
+/**
+ * Simulation event log.
+ *
+ * Every trace line (fetches, proc/snoop requests, data sends) is built as a
+ * fixed size record.  In text mode the record is formatted straight into a
+ * buffer that is written to stderr in large chunks.  In binary mode the raw
+ * records go to a file and decode_event_log turns them back into the exact
+ * text a text mode run would have printed.
+ *
+ * Building with -DEVENT_LOG_QUIET compiles the per-event calls away.  Free
+ * form text (the banner, cache dumps and stats) is always kept.
+ */
+typedef enum {
+    EV_FETCH = 0,
+    EV_COMPLETE,
+    EV_PROC_REQUEST,
+    EV_SNOOP_REQUEST,
+    EV_DATA_SEND_MC,
+    EV_DATA_SEND_CACHE,
+    EV_TEXT,                 /** Followed by addr bytes of text.  */
+    EV_NUM
+} event_t;
+
+typedef struct {
+    uint64_t clock;
+    uint64_t addr;           /** Address for FETCH, tag for *_REQUEST, length for TEXT.  */
+    int16_t node;
+    int16_t src;
+    int16_t dest;
+    uint8_t type;
+    uint8_t arg;             /** 'r'/'w' for FETCH, message_t for *_REQUEST, EV_STDOUT/EV_STDERR for TEXT.  */
+    uint8_t node_module;
+    uint8_t src_module;
+    uint8_t dest_module;
+    uint8_t reserved[5];
+} event_record_t;
+
+#define EV_STDOUT            1
+#define EV_STDERR            2
+
+#define EVLOG_MAGIC          "CSXEVLOG"
+#define EVLOG_VERSION        1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} evlog_header_t;
+
+/** Size of the write buffer, and the most a single formatted line may take.  */
+#define EVLOG_BUFFER_SIZE    (1 << 16)
+#define EVLOG_MAX_LINE       512
+
+class Event_log {
+public:
+    Event_log (Simulator *sim);
+    ~Event_log ();
+
+    /** Switch to binary records written to log_file.  */
+    void open_binary (const char *log_file);
+    /** Send all text, stdout and stderr alike, to log_file.  */
+    void open_text (const char *log_file);
+    void flush (void);
+
+    void fetch (ModuleID mid, char op, paddr_t addr);
+    void complete (ModuleID mid);
+    void proc_request (ModuleID mid, const Mreq *request);
+    void snoop_request (ModuleID mid, const Mreq *request);
+    void mc_data_send (void);
+    void cache_data_send (ModuleID mid);
+
+    /** Free form text for stream (stdout or stderr).  */
+    void text (FILE *stream, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
+
+    Simulator *sim;
+    FILE *out;
+    bool binary;
+    bool captured;           /** out takes the text for every stream.  */
+
+    /** Log of the simulation this thread is running, for fatal_error.  */
+    static __thread Event_log *current;
+
+    /** Set while a thread ticks a node in a parallel phase.  Events pile
+     *  up here and the pool appends them in node order after the phase.  */
+    static __thread VECTOR<char> *stage;
+
+    char *buf;
+    size_t len;
+
+    void request_event (event_t type, ModuleID mid, const Mreq *request);
+    void emit (const event_record_t *rec);
+    void append (const void *data, size_t size);
+};
+
+/** Text for one record, as printed in a text mode run.  Returns its length.  */
+int format_event (char *str, size_t size, const event_record_t *rec);
+
+/** Print a binary log as text on stream.  */
+void decode_event_log (const char *log_file, FILE *stream);
+
+/*************************
+ * Per-event entry points.
+ *************************/
+inline void Event_log::fetch (ModuleID mid, char op, paddr_t addr)
+{
+#ifndef EVENT_LOG_QUIET
+    event_record_t rec = {0};
+
+    rec.type = EV_FETCH;
+    rec.clock = Global_Clock;
+    rec.node = mid.nodeID;
+    rec.arg = op;
+    rec.addr = addr;
+    emit (&rec);
+#endif
+}
+
+inline void Event_log::complete (ModuleID mid)
+{
+#ifndef EVENT_LOG_QUIET
+    event_record_t rec = {0};
+
+    rec.type = EV_COMPLETE;
+    rec.clock = Global_Clock;
+    rec.node = mid.nodeID;
+    emit (&rec);
+#endif
+}
+
+inline void Event_log::request_event (event_t type, ModuleID mid, const Mreq *request)
+{
+    event_record_t rec = {0};
+
+    rec.type = type;
+    rec.clock = Global_Clock;
+    rec.node = mid.nodeID;
+    rec.node_module = mid.module_index;
+    rec.src = request->src_mid.nodeID;
+    rec.src_module = request->src_mid.module_index;
+    rec.dest = request->dest_mid.nodeID;
+    rec.dest_module = request->dest_mid.module_index;
+    rec.arg = request->msg;
+    rec.addr = request->addr >> sim->settings.cache_line_size_log2;
+    emit (&rec);
+}
+
+inline void Event_log::proc_request (ModuleID mid, const Mreq *request)
+{
+#ifndef EVENT_LOG_QUIET
+    request_event (EV_PROC_REQUEST, mid, request);
+#endif
+}
+
+inline void Event_log::snoop_request (ModuleID mid, const Mreq *request)
+{
+#ifndef EVENT_LOG_QUIET
+    request_event (EV_SNOOP_REQUEST, mid, request);
+#endif
+}
+
+inline void Event_log::mc_data_send (void)
+{
+#ifndef EVENT_LOG_QUIET
+    event_record_t rec = {0};
+
+    rec.type = EV_DATA_SEND_MC;
+    rec.clock = Global_Clock;
+    emit (&rec);
+#endif
+}
+
+inline void Event_log::cache_data_send (ModuleID mid)
+{
+#ifndef EVENT_LOG_QUIET
+    event_record_t rec = {0};
+
+    rec.type = EV_DATA_SEND_CACHE;
+    rec.clock = Global_Clock;
+    rec.node = mid.nodeID;
+    emit (&rec);
+#endif
+}
+
+#endif // EVENT_LOG_H_
@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <math.h>
 #include <string.h>
 
+#include "event_log.h"
 #include "hash_table.h"
 #include "../protocols/MI_protocol.h"
 #include "../protocols/MSI_protocol.h"
@@ -10,6 +12,8 @@
 #include "../protocols/MOSI_protocol.h"
 #include "../protocols/MOESI_protocol.h"
 #include "../protocols/MOESIF_protocol.h"
+#include "../protocols/Dragon_protocol.h"
+#include "../protocols/Firefly_protocol.h"
 #include "settings.h"
 #include "sharers.h"
 #include "sim.h"
@@ -18,70 +22,98 @@
 
 using namespace std;
 
-extern Simulator *Sim;
-
 /***************************************************************************
  * Hash_entry constructor, destructor, and functions.
  ***************************************************************************/
-Hash_entry::Hash_entry (Hash_table *t, paddr_t tag)
+Hash_entry::Hash_entry (void)
 {
-    this->my_table = t;
-    this->tag = tag;
+    this->tag = HASH_EMPTY_TAG;
+    this->last_use = 0;
+    this->state = 0;
+}
 
-    switch (my_table->protocol) {
-    case MI_PRO:
-        protocol = new MI_protocol (my_table, this);
-        break;
-    case MSI_PRO:
-    	protocol = new MSI_protocol (my_table, this);
-    	break;
-    case MESI_PRO:
-    	protocol = new MESI_protocol (my_table, this);
-    	break;
-    case MOSI_PRO:
-    	protocol = new MOSI_protocol (my_table, this);
-    	break;
-    case MOESI_PRO:
-    	protocol = new MOESI_protocol (my_table, this);
-    	break;
-    case MOESIF_PRO:
-    	protocol = new MOESIF_protocol (my_table, this);
-    	break;
-    default:
-        fatal_error ("Hash_entry: Unknown coherence protocol!\n");
-    }
+Hash_entry::Hash_entry (paddr_t tag, uint8_t state)
+{
+    this->tag = tag;
+    this->last_use = 0;
+    this->state = state;
 }
 
-Hash_entry::~Hash_entry (void)
+/***************************************************************************
+ * Line_table functions.
+ ***************************************************************************/
+void Line_table::init (int offset_bits)
 {
+    this->offset_bits = offset_bits;
+    slots.assign (LINE_TABLE_MIN_SLOTS, Hash_entry ());
+    shift = 64 - (int)log2 (LINE_TABLE_MIN_SLOTS);
+    count = 0;
 }
 
-void Hash_entry::process_request_snoop (Mreq *request)
+Hash_entry* Line_table::find (paddr_t addr)
 {
-    assert (protocol);
-    assert (request);
+    size_t mask = slots.size () - 1;
 
-    protocol->process_snoop_request (request);
+    for (size_t i = slot_of (addr); ; i = (i + 1) & mask)
+    {
+        if (slots[i].tag == addr)
+            return &slots[i];
+        if (slots[i].empty ())
+            return NULL;
+    }
 }
 
-void Hash_entry::process_request_processor (Mreq *request)
+Hash_entry* Line_table::find_or_insert (paddr_t addr, uint8_t state)
 {
-    protocol->process_cache_request (request);
+    size_t mask = slots.size () - 1;
+    size_t i;
+
+    for (i = slot_of (addr); !slots[i].empty (); i = (i + 1) & mask)
+        if (slots[i].tag == addr)
+            return &slots[i];
+
+    if (2 * (count + 1) > slots.size ())
+    {
+        grow ();
+        mask = slots.size () - 1;
+        for (i = slot_of (addr); !slots[i].empty (); i = (i + 1) & mask)
+            ;
+    }
+
+    slots[i] = Hash_entry (addr, state);
+    count++;
+    return &slots[i];
 }
 
-void Hash_entry::dump (void)
+void Line_table::grow (void)
 {
-    fprintf (stderr, "Addr: 0x%llx ", (unsigned long long)tag);
-    protocol->dump ();
+    VECTOR<Hash_entry> old;
+
+    old.swap (slots);
+    slots.assign (2 * old.size (), Hash_entry ());
+    shift--;
+
+    for (size_t j = 0; j < old.size (); j++)
+    {
+        size_t mask = slots.size () - 1;
+        size_t i;
+
+        if (old[j].empty ())
+            continue;
+        for (i = slot_of (old[j].tag); !slots[i].empty (); i = (i + 1) & mask)
+            ;
+        slots[i] = old[j];
+    }
 }
 
 /***************************************************************************
  * Hash constructor, destructor, and fucntions.
  ***************************************************************************/
-Hash_table::Hash_table (ModuleID moduleID, const char *name,
+Hash_table::Hash_table (Simulator *sim, ModuleID moduleID, const char *name,
                         int size, int assoc, int blocksize, int mshrs,
-                        int hit_time, protocol_t protocol)
-	: Module (moduleID, name)
+                        int wb_entries, int hit_time, protocol_t protocol, bool infinite,
+                        replacement_policy_t replacement_policy)
+	: Module (sim, moduleID, name)
 {
     /** Sanity check.  */
     /** Note, we do allow the hash size and assoc to be non-powers of 2. */
@@ -94,15 +126,56 @@ Hash_table::Hash_table (ModuleID moduleID, const char *name,
     if (!blocksize || !ISPOW2 (blocksize))
         fatal_error ("%s: Invalid hash blocksize", name);
 
+    if (!infinite && wb_entries < 1)
+        fatal_error ("%s: Invalid writeback buffer size - %d\n", name, wb_entries);
+
     /** Parameters.  */
     this->size = size;
     this->assoc = assoc;
     this->sets = (size) / (assoc * blocksize);
     this->blocksize = blocksize;
     this->mshrs = mshrs;
+    this->wb_entries = wb_entries;
     this->hit_time = hit_time;
     this->protocol = protocol;
+    this->infinite = infinite;
+    this->replacement_policy = replacement_policy;
 
+    if (!infinite && replacement_policy != RP_LRU)
+        fatal_error ("%s: Unknown replacement policy - %d\n", name, replacement_policy);
+
+    switch (protocol) {
+    case MI_PRO:
+        engine = new MI_protocol (this);
+        break;
+    case MSI_PRO:
+    	engine = new MSI_protocol (this);
+    	break;
+    case MESI_PRO:
+    	engine = new MESI_protocol (this);
+    	break;
+    case MOSI_PRO:
+    	engine = new MOSI_protocol (this);
+    	break;
+    case MOESI_PRO:
+    	engine = new MOESI_protocol (this);
+    	break;
+    case MOESIF_PRO:
+    	engine = new MOESIF_protocol (this);
+    	break;
+    case DRAGON_PRO:
+    	engine = new Dragon_protocol (this);
+    	break;
+    case FIREFLY_PRO:
+    	engine = new Firefly_protocol (this);
+    	break;
+    default:
+        fatal_error ("%s: Unknown coherence protocol!\n", name);
+    }
+
+    migratory = NULL;
+    if (sim->settings.migratory_enabled && (protocol == MESI_PRO || protocol == MOESI_PRO))
+        migratory = new Migratory_detector (sim, moduleID);
 
     /** Calculate tag and index masks once.  */
     num_index_bits = (int) log2 (sets);
@@ -118,13 +191,28 @@ Hash_table::Hash_table (ModuleID moduleID, const char *name,
     index_mask = index_mask << (num_offset_bits);
     index_mask = index_mask & ~tag_mask;
 
-    my_entries.clear ();
+    if (infinite)
+        my_entries.init (num_offset_bits);
+
+    proc_request = NULL;
+    replied = false;
+
+    shared_line = false;
+    snoop_reply = NULL;
+
+    use_clock = 0;
+    if (!infinite)
+        my_ways.assign (sets * assoc, Hash_entry ());
 }
 
 /** Destructor.  */
 Hash_table::~Hash_table (void)
 {
+    delete proc_request;
+    delete snoop_reply;
 
+    delete migratory;
+    delete engine;
 }
 
 /*****************************
@@ -132,39 +220,139 @@ Hash_table::~Hash_table (void)
  *****************************/
 void Hash_table::tick (void)
 {
-    Mreq *request;
+    const Mreq *request;
     Hash_entry *entry;
 
-    /** Request from processor.  */
-    if (proc_request)
+    /** Request from processor.  Replays of coalesced misses go first.  */
+    if (!replay_requests.empty ())
     {
-    	fprintf(stderr,"** PROC REQUEST -- ");
-    	proc_request->print_msg (moduleID, NULL);
-    	Sim->cache_accesses++;
-        entry = get_entry (proc_request->addr);
-        assert (entry);
-        entry->process_request_processor (proc_request);
-        delete proc_request;
-        proc_request = NULL;
+        if (cache_request (replay_requests.front ()))
+            replay_requests.pop_front ();
     }
+    else if (proc_request && cache_request (proc_request))
+        proc_request = NULL;
 
     /** Request from bus.  */
     request = read_input_port ();
     if (request)
     {
-    	if (request->msg == DATA && request->dest_mid != this->moduleID)
+    	if (is_data_phase (request->msg) && request->dest_mid != this->moduleID)
     	{
     		return;
     	}
 
-    	fprintf(stderr,"*** SNOOP REQUEST -- ");
-        request->print_msg (moduleID, NULL);
-        entry = get_entry (request->addr);
-        assert (entry);
-        entry->process_request_snoop (request);
+    	/** Another cache's writeback is for memory alone.  */
+    	if (is_put (request->msg) && request->src_mid != this->moduleID)
+    		return;
+
+        sim->log->snoop_request (moduleID, request);
+
+        if (!upgrades.empty ())
+            order_upgrade (request);
+
+        if (migratory)
+            migratory->snoop (request);
+
+        /** DATA from the home brings the shared line with it.  */
+        shared_line = request->shared;
+
+        /** A finite table does not allocate on snoops: a missing line is in I.  */
+        entry = infinite ? get_entry (request->addr) : find_entry (request->addr);
+        if (!entry && (entry = find_writeback (request->addr)) != NULL)
+        {
+            engine->process_snoop_request (entry, request);
+            if (engine->is_invalid (entry))
+                writebacks.erase (request->addr);
+        }
+        else if (entry)
+            engine->process_snoop_request (entry, request);
+
+        if (sim->settings.dir_enabled &&
+            (request->msg == GETS || request->msg == GETM || request->msg == UPGRADE))
+            reply_to_home (request);
     }
 }
 
+/** Our UPGRADE for the line is on the bus now, or someone else's request
+ *  took the line first and the UPGRADE has to fetch the data after all.  */
+void Hash_table::order_upgrade (const Mreq *request)
+{
+    MAP<paddr_t, Mreq*>::iterator it;
+
+    it = upgrades.find (request->addr);
+    if (it == upgrades.end ())
+        return;
+
+    if (request->src_mid == moduleID)
+        upgrades.erase (it);
+    else if (request->msg == GETM || request->msg == UPGRADE)
+    {
+        it->second->msg = GETM;
+        upgrades.erase (it);
+    }
+}
+
+/** Directory mode: every forwarded snoop is answered, with the DATA the
+ *  protocol sent or else an ACK, so the home knows when it is done.  */
+void Hash_table::reply_to_home (const Mreq *request)
+{
+    Mreq *reply = snoop_reply;
+
+    if (!reply)
+        reply = new Mreq (sim, ACK, request->addr);
+    snoop_reply = NULL;
+
+    reply->src_mid = moduleID;
+    reply->dest_mid = (ModuleID){sim->home_dir (request->addr), DIR_M};
+    reply->txn_id = request->txn_id;
+    reply->shared = shared_line;
+    write_output_port (reply);
+}
+
+/** Returns false if the request has to stall: every MSHR is busy, the
+ *  line is still being written back, or in a finite table every way of its
+ *  set is.  */
+bool Hash_table::cache_request (Mreq *request)
+{
+    MAP<paddr_t, LIST<Mreq*> >::iterator mshr;
+    Hash_entry *entry;
+
+    /** Secondary miss, wait for the primary to fill the line.  */
+    mshr = mshr_file.find (request->addr);
+    if (mshr != mshr_file.end ())
+    {
+        mshr->second.push_back (request);
+        sim->secondary_misses++;
+        return true;
+    }
+
+    if ((int)mshr_file.size () >= mshrs)
+        return false;
+
+    if (writebacks.count (request->addr))
+        return false;
+
+    if ((entry = get_entry (request->addr)) == NULL)
+        return false;
+
+    sim->log->proc_request (moduleID, request);
+    sim->cache_accesses++;
+    entry->last_use = ++use_clock;
+
+    if (migratory && request->msg == STORE)
+        migratory->stored (request->addr);
+
+    replied = false;
+    engine->process_cache_request (entry, request);
+
+    /** No reply yet means the protocol went to the bus: hold an MSHR.  */
+    if (!replied)
+        mshr_file[request->addr];
+
+    delete request;
+    return true;
+}
+
 /** Request sent from processor.  */
 void Hash_table::processor_request (Mreq *request)
 {
@@ -177,29 +365,124 @@ void Hash_table::tock (void)
     fatal_error ("%s - tock should never be called!", name);
 }
 
+/** Snoops are driven by the bus, so only a pending processor request keeps us busy.  */
+timestamp_t Hash_table::next_event (void)
+{
+    if (proc_request || !replay_requests.empty ())
+        return Global_Clock;
+
+    return NEVER;
+}
+
 /*******************************
  * Generic Hash_table functions.
  *******************************/
+/** Lookup that allocates on a miss, evicting a victim in a finite table.
+ *  Returns NULL if no way in the set can be evicted right now, or the
+ *  victim needs a writeback and the buffer is full.  */
 Hash_entry* Hash_table::get_entry (paddr_t addr)
 {
-    MAP<paddr_t, Hash_entry*>::iterator it;
-    
-    it = my_entries.find (addr);
-    if (it == my_entries.end ())
+    Hash_entry *entry;
+    Hash_entry *victim;
+
+    if (infinite)
+        return my_entries.find_or_insert (addr, engine->initial_state);
+
+    if ((entry = find_entry (addr)) != NULL)
+        return entry;
+
+    if ((victim = find_victim (addr)) == NULL)
+        return NULL;
+
+    /** A valid line goes to the writeback buffer unless its PUT is already done.  */
+    if (!victim->empty () && !engine->is_invalid (victim))
+    {
+        if ((int)writebacks.size () >= wb_entries)
+            return NULL;
+
+        engine->evict (victim);
+        if (!engine->is_invalid (victim))
+            writebacks[victim->tag] = *victim;
+    }
+
+    if (!victim->empty ())
+        sim->evictions++;
+
+    *victim = Hash_entry (addr, engine->initial_state);
+    return victim;
+}
+
+/** Lookup without allocation.  */
+Hash_entry* Hash_table::find_entry (paddr_t addr)
+{
+    Hash_entry *set;
+
+    if (infinite)
+        return my_entries.find (addr);
+
+    /** Tags are whole line addresses, an empty way never matches.  */
+    set = get_set (addr);
+    for (int way = 0; way < assoc; way++)
+        if (set[way].tag == addr)
+            return &set[way];
+
+    return NULL;
+}
+
+Hash_entry* Hash_table::find_writeback (paddr_t addr)
+{
+    MAP<paddr_t, Hash_entry>::iterator it;
+
+    it = writebacks.find (addr);
+    return (it == writebacks.end ()) ? NULL : &it->second;
+}
+
+Hash_entry* Hash_table::get_set (paddr_t addr)
+{
+    return &my_ways[((addr & index_mask) >> num_offset_bits) * assoc];
+}
+
+/** Pick a way for addr: an empty way, then an invalid line, then the LRU
+ *  line in a stable state.  Lines waiting on the bus are never evicted.  */
+Hash_entry* Hash_table::find_victim (paddr_t addr)
+{
+    Hash_entry *set = get_set (addr);
+    Hash_entry *victim = NULL;
+
+    for (int way = 0; way < assoc; way++)
     {
-        my_entries.insert(pair<paddr_t, Hash_entry*>(addr,new Hash_entry (this, addr)));       
+        if (set[way].empty ())
+            return &set[way];
+
+        if (!engine->is_stable (&set[way]))
+            continue;
+
+        if (engine->is_invalid (&set[way]))
+            return &set[way];
+
+        if (!victim || set[way].last_use < victim->last_use)
+            victim = &set[way];
     }
-    return my_entries[addr];
+
+    return victim;
 }
 
 bool Hash_table::write_to_proc (Mreq *mreq)
 {
-	Processor * pr = (Processor*)Sim->get_PR(moduleID.nodeID);
-	mreq->src_mid = moduleID;
+	Processor * pr = (Processor*)sim->get_PR(moduleID.nodeID);
+	MAP<paddr_t, LIST<Mreq*> >::iterator mshr;
 
-	assert (!pr->inbound_request_buf);
+	mreq->src_mid = moduleID;
+	pr->inbound_request_buf.push_back (mreq);
+	replied = true;
 
-	pr->inbound_request_buf = mreq;
+	/** The line filled, free its MSHR and replay whatever coalesced behind it.  */
+	mshr = mshr_file.find (mreq->addr);
+	if (mshr != mshr_file.end ())
+	{
+		replay_requests.splice (replay_requests.end (), mshr->second);
+		mshr_file.erase (mshr);
+	}
 
 	return true;
 }
@@ -207,6 +490,21 @@ bool Hash_table::write_to_proc (Mreq *mreq)
 bool Hash_table::write_to_bus (Mreq *mreq)
 {
 	mreq->src_mid = moduleID;
+
+	if (sim->settings.dir_enabled)
+	{
+		/** Snoop data goes back through the home with the snoop's answer.  */
+		if (mreq->msg == DATA)
+		{
+			assert (snoop_reply == NULL);
+			snoop_reply = mreq;
+			return true;
+		}
+
+		/** Requests are ordered at the line's home node.  */
+		mreq->dest_mid = (ModuleID){sim->home_dir (mreq->addr), DIR_M};
+	}
+
 	return this->write_output_port(mreq);
 }
 
@@ -217,27 +515,46 @@ void Hash_table::dump_hash_entry (paddr_t addr)
 {
     Hash_entry *entry;
 
-    entry = get_entry (addr);
+    entry = find_entry (addr);
     if (entry)
-        entry->dump ();
+        dump_entry (entry);
 }
 
+void Hash_table::dump_entry (Hash_entry *entry)
+{
+    sim->log->text (stderr, "Addr: 0x%llx ", (unsigned long long)entry->tag);
+    engine->dump (entry);
+}
+
+static bool entry_before (const Hash_entry *a, const Hash_entry *b)
+{
+	return a->tag < b->tag;
+}
+
+/** Contents in address order, whichever storage the table uses.  */
 void Hash_table::dump_hash_table ()
 {
-	MAP<paddr_t, Hash_entry*>::iterator it;
+	VECTOR<Hash_entry> &storage = infinite ? my_entries.slots : my_ways;
+	VECTOR<Hash_entry *> resident;
 
-	fprintf(stderr, "Cache %d Contents:\n",moduleID.nodeID);
+	sim->log->text(stderr, "Cache %d Contents:\n",moduleID.nodeID);
 
-	for (it = my_entries.begin(); it != my_entries.end(); it++)
-	{
-		it->second->dump();
-	}
+	for (unsigned int i = 0; i < storage.size(); i++)
+		if (!storage[i].empty ())
+			resident.push_back (&storage[i]);
 
+	sort (resident.begin (), resident.end (), entry_before);
+	for (unsigned int i = 0; i < resident.size(); i++)
+		dump_entry (resident[i]);
 }
 
 void Hash_table::print_config (void)
 {
     fprintf (stderr, "%s CONFIGURATION\n", name);
     fprintf (stderr, " blocksize:         %d bytes\n", blocksize);
+    if (infinite)
+        fprintf (stderr, " size:              infinite\n");
+    else
+        fprintf (stderr, " size:              %d bytes, %d sets x %d ways\n", size, sets, assoc);
 }
 
@@ -3,6 +3,7 @@
 
 #include <iostream>
 
+#include "migratory.h"
 #include "module.h"
 #include "mreq.h"
 #include "settings.h"
@@ -11,22 +12,56 @@
 
 using namespace std;
 
-/** Individual entry for a hardware hash-like structure. */
+/** Tag of an unused entry.  Never a line address, those are line aligned.  */
+#define HASH_EMPTY_TAG       (~(paddr_t)0)
+
+/** Individual entry for a hardware hash-like structure.
+ *  Plain data: the coherence state is a single byte interpreted by the
+ *  owning table's protocol engine.  */
 class Hash_entry {
 public:
-    Hash_entry (Hash_table *t, paddr_t tag);
-    virtual ~Hash_entry (void);
+    Hash_entry (void);
+    Hash_entry (paddr_t tag, uint8_t state);
 
-    Hash_table *my_table;
     paddr_t tag;
 
-    Protocol *protocol;
+    /** Last processor access, for LRU replacement in a finite table.  */
+    counter_t last_use;
 
-    void process_request_snoop (Mreq *request);
-    void process_request_processor (Mreq *request);
+    /** Protocol specific, e.g. an MSI_cache_state_t.  */
+    uint8_t state;
 
-    /** Debug.  */
-    void dump ();
+    bool empty (void) const { return tag == HASH_EMPTY_TAG; }
+};
+
+/** Slots a Line_table starts out with, a power of two.  */
+#define LINE_TABLE_MIN_SLOTS 256
+
+/**
+ * Storage of an infinite table: open addressing with linear probing and
+ * the entries held inline, so a lookup is one hash and a short walk along
+ * neighbouring slots, and a new line costs no allocation.  Lines are
+ * never removed, so there are no tombstones, and the table doubles once
+ * it is half full.  Entries move when it does, so a Hash_entry pointer is
+ * only good until the next insert.
+ */
+class Line_table {
+public:
+    void init (int offset_bits);
+
+    VECTOR<Hash_entry> slots;
+    int offset_bits;
+    int shift;
+    size_t count;
+
+    size_t slot_of (paddr_t addr) const
+    {
+        return (size_t)(((uint64_t)(addr >> offset_bits) * 0x9e3779b97f4a7c15ULL) >> shift);
+    }
+
+    Hash_entry *find (paddr_t addr);
+    Hash_entry *find_or_insert (paddr_t addr, uint8_t state);
+    void grow (void);
 };
 
 class Hash_table: public Module {
@@ -37,8 +72,14 @@ public:
     int sets;
     int blocksize;
     int mshrs;
+    int wb_entries;
     int hit_time;
     protocol_t protocol;
+    bool infinite;
+    replacement_policy_t replacement_policy;
+
+    /** Stateless coherence engine shared by every entry in this table.  */
+    Protocol *engine;
 
     /** Masks for tag, index.  */
     int num_index_bits;
@@ -48,17 +89,54 @@ public:
 
     Mreq *proc_request;
 
-    /** Table divided into sets which house the individual entries, indexed with index bits.  */
-    MAP<paddr_t, Hash_entry*> my_entries;
-    Hash_entry* null_entry;
+    /** MSHR file: one entry per line with a miss in flight, holding the
+     *  secondary requests to that line that were coalesced behind it.  */
+    MAP<paddr_t, LIST<Mreq*> > mshr_file;
+    /** Coalesced requests whose line has filled, replayed before new ones.  */
+    LIST<Mreq*> replay_requests;
+    /** Set when the request being handled was answered right away.  */
+    bool replied;
+
+    /** Directory mode: the shared line for the message being snooped, and
+     *  the DATA the protocol sent for it, both returned to the home.  */
+    bool shared_line;
+    Mreq *snoop_reply;
+
+    /** Infinite table: every line ever touched.  */
+    Line_table my_entries;
+
+    /** Finite table: sets * assoc ways inline, indexed with index bits.  */
+    VECTOR<Hash_entry> my_ways;
+    counter_t use_clock;
+
+    /** Writeback buffer: evicted lines whose PUT has not finished, in the
+     *  transient state the protocol left them in.  They still answer
+     *  snoops, and the processor waits for them to go before it touches
+     *  the line again.  */
+    MAP<paddr_t, Hash_entry> writebacks;
+
+    /** Bus mode: our UPGRADEs still waiting for the bus.  One that loses
+     *  the line to another core's GETM or UPGRADE first goes out as a GETM.  */
+    MAP<paddr_t, Mreq*> upgrades;
+
+    /** MESI and MOESI with migratory_enabled, else NULL.  */
+    Migratory_detector *migratory;
 
     /** Internal helper functions.  */
+    bool cache_request (Mreq *request);
+    void reply_to_home (const Mreq *request);
+    void order_upgrade (const Mreq *request);
     Hash_entry* get_entry (paddr_t addr);
+    Hash_entry* find_entry (paddr_t addr);
+    Hash_entry* find_writeback (paddr_t addr);
+    Hash_entry* get_set (paddr_t addr);
+    Hash_entry* find_victim (paddr_t addr);
 
 public:
-    Hash_table (ModuleID moduleID, const char *name,
+    Hash_table (Simulator *sim, ModuleID moduleID, const char *name,
                 int size, int assoc, int blocksize, int mshrs,
-                int hit_time, protocol_t protocol);
+                int wb_entries, int hit_time, protocol_t protocol, bool infinite,
+                replacement_policy_t replacement_policy);
                 
     ~Hash_table (void);
 
@@ -69,10 +147,12 @@ public:
 
     void tick (void);
     void tock (void);
+    timestamp_t next_event (void);
 
     /** Debug.  */
     void print_config (void);
     void dump_hash_entry (paddr_t addr);
+    void dump_entry (Hash_entry *entry);
     void dump_hash_table ();
 };
 
@@ -1,54 +1,208 @@
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "event_log.h"
+#include "mtrace.h"
 #include "sim.h"
 #include "settings.h"
-
-Sim_settings settings;
-
-Simulator *Sim;
+#include "trace.h"
 
 extern char *optarg;
 extern int optind, optopt;
 
+/** One simulation of a sweep: a trace directory run under one protocol.  */
+typedef struct {
+    char *trace_dir;
+    const char *protocol_name;
+    Sim_settings *settings;
+    const Trace_set *traces;
+
+    timestamp_t run_time;
+    counter_t cache_misses;
+    counter_t silent_upgrades;
+    counter_t cache_to_cache_transfers;
+} sim_run_t;
+
+/** What -p ALL runs.  The update protocols come last, they need the bus.  */
+static const char *all_protocols[] = {"MI", "MSI", "MESI", "MOSI", "MOESI", "MOESIF", "DRAGON", "FIREFLY"};
+#define NUM_PROTOCOLS        8
+#define NUM_DIR_PROTOCOLS    6
+
+/** Runs handed out to the sweep threads in order.  */
+typedef struct {
+    VECTOR<sim_run_t> *runs;
+    int next;
+} sim_sweep_t;
+
 void usage (void)
 {
     fprintf (stderr, "Usage:\n");
-    fprintf (stderr, "\t-p <protocol> (choices MI, MSI, MESI)\n");
-    fprintf (stderr, "\t-t <trace directory>\n\n");
+    fprintf (stderr, "\t-p <protocol> (choices MI, MSI, MESI, MOSI, MOESI, MOESIF, DRAGON, FIREFLY, a comma separated list, or ALL)\n");
+    fprintf (stderr, "\t-t <trace directory>, may be given more than once, or -o synth_pattern=<1-7> instead\n");
+    fprintf (stderr, "\t-b read binary pN.btrace files instead of pN.trace\n");
+    fprintf (stderr, "\t-c convert pN.trace files to pN.btrace and exit\n");
+    fprintf (stderr, "\t-m merge trace.txt or the pN.trace files into one trace.mtrace and exit\n");
+    fprintf (stderr, "\t-l <file> write a binary event log to file instead of text to stderr\n");
+    fprintf (stderr, "\t-d <file> print a binary event log as text and exit\n");
+    fprintf (stderr, "\t-o <setting>=<value> override a setting, e.g. -o l1_infinite=false\n");
+    fprintf (stderr, "\t-j <jobs> simulations to run at once in a sweep (default: one per host CPU)\n");
+    fprintf (stderr, "\t-O <dir> where a sweep writes each run's output (default: .)\n\n");
+}
+
+protocol_t parse_protocol (const char *protocol)
+{
+    if (!strcmp(protocol,"MI"))
+    	return MI_PRO;
+    else if (!strcmp(protocol,"MSI"))
+    	return MSI_PRO;
+    else if (!strcmp(protocol,"MESI"))
+    	return MESI_PRO;
+    else if (!strcmp(protocol,"MOSI"))
+    	return MOSI_PRO;
+    else if (!strcmp(protocol,"MOESI"))
+    	return MOESI_PRO;
+    else if (!strcmp(protocol,"MOESIF"))
+    	return MOESIF_PRO;
+    else if (!strcmp(protocol,"DRAGON"))
+    	return DRAGON_PRO;
+    else if (!strcmp(protocol,"FIREFLY"))
+    	return FIREFLY_PRO;
+
+    fatal_error ("Error: invalid protocol %s specified.\n", protocol);
+}
+
+/** Overrides are "name\0value" after main splits them.  */
+void apply_overrides (Sim_settings *settings, LIST<char *> &overrides)
+{
+    for (LIST<char *>::iterator it = overrides.begin (); it != overrides.end (); it++)
+    {
+        char *value = *it + strlen (*it) + 1;
+
+        if (!settings->set_setting (*it, value))
+            fatal_error ("Error: invalid setting %s=%s\n", *it, value);
+    }
+}
+
+void *sweep_thread (void *arg)
+{
+    sim_sweep_t *sweep = (sim_sweep_t *)arg;
+    int i;
+
+    while ((i = __atomic_fetch_add (&sweep->next, 1, __ATOMIC_RELAXED)) < (int)sweep->runs->size ())
+    {
+        sim_run_t *run = &(*sweep->runs)[i];
+        Simulator *sim = new Simulator (*run->settings, run->traces);
+
+        sim->run ();
+        run->run_time = sim->global_clock;
+        run->cache_misses = sim->cache_misses.total ();
+        run->silent_upgrades = sim->silent_upgrades.total ();
+        run->cache_to_cache_transfers = sim->cache_to_cache_transfers.total ();
+        delete sim;
+    }
+    return NULL;
+}
+
+/** Side by side stats, one table per trace directory, one column per protocol.  */
+void print_sweep (VECTOR<sim_run_t> &runs, int num_protocols)
+{
+    for (int first = 0; first < (int)runs.size (); first += num_protocols)
+    {
+        fprintf (stdout, "%s\n%-18s", runs[first].trace_dir, "");
+        for (int i = first; i < first + num_protocols; i++)
+            fprintf (stdout, " %10s", runs[i].protocol_name);
+
+        fprintf (stdout, "\n%-18s", "Run Time:");
+        for (int i = first; i < first + num_protocols; i++)
+            fprintf (stdout, " %10lld", (long long)runs[i].run_time);
+
+        fprintf (stdout, "\n%-18s", "Cache Misses:");
+        for (int i = first; i < first + num_protocols; i++)
+            fprintf (stdout, " %10lld", (long long)runs[i].cache_misses);
+
+        fprintf (stdout, "\n%-18s", "Silent Upgrades:");
+        for (int i = first; i < first + num_protocols; i++)
+            fprintf (stdout, " %10lld", (long long)runs[i].silent_upgrades);
+
+        fprintf (stdout, "\n%-18s", "$-to-$ Transfers:");
+        for (int i = first; i < first + num_protocols; i++)
+            fprintf (stdout, " %10lld", (long long)runs[i].cache_to_cache_transfers);
+
+        fprintf (stdout, "\n\n");
+    }
 }
 
 int main (int argc, char *argv[])
 {
-    int num_nodes = 0;
-    char *trace_dir = NULL;
-    char *protocol = NULL;
-    FILE *config_file = NULL;
-    char config_path[1000];
-    bool debug = false;
+    LIST<char *> trace_dirs;
+    char *protocols = NULL;
+    bool binary_traces = false;
+    bool convert = false;
+    bool merge = false;
+    bool synthetic;
+    char *event_log = NULL;
+    const char *output_dir = ".";
+    int jobs = 0;
+    LIST<char *> overrides;
+    VECTOR<const char *> protocol_names;
+    VECTOR<Trace_set *> trace_sets;
+    VECTOR<sim_run_t> runs;
+    LIST<char *>::iterator dir;
 
     /** Parse command line arguments.  */
     int c;
 
-    while ((c = getopt(argc, argv, "hP:p:t:")) != -1)
+    while ((c = getopt(argc, argv, "bcd:hj:l:mO:o:P:p:t:")) != -1)
     {
         switch(c)
         {
+        case 'b':
+            binary_traces = true;
+            break;
+
+        case 'c':
+            convert = true;
+            break;
+        case 'd':
+            decode_event_log (optarg, stdout);
+            exit (0);
+            break;
+
         case 'h':
             usage ();
             exit (0);
             break;
 
+        case 'j':
+            jobs = atoi (optarg);
+            break;
+
+        case 'l':
+            event_log = strdup (optarg);
+            break;
+        case 'm':
+            merge = true;
+            break;
+        case 'O':
+            output_dir = strdup (optarg);
+            break;
+        case 'o':
+            overrides.push_back (strdup (optarg));
+            break;
+
         case 'p':
-            protocol = strdup (optarg);
+            protocols = strdup (optarg);
             break;
 
         case 't':
-            trace_dir = strdup (optarg);
+            trace_dirs.push_back (strdup (optarg));
             break;
 
         default:
@@ -58,61 +212,182 @@ int main (int argc, char *argv[])
         }
     }
 
-    sprintf(config_path,"%s/config",trace_dir);
-    config_file = fopen (config_path,"r");
-    if (fscanf(config_file,"%d\n",&num_nodes) != 1)
-    {
-    	fatal_error("Config File should contain number of traces\n");
-    }
-
-    if (num_nodes == 0)
-        fatal_error ("Error: number of processors is zero.\n");
-
-    if (protocol == NULL)
-        fatal_error ("Error: invalid protocol specified.\n");
+    /** Split the overrides once, every run applies them.  */
+    for (LIST<char *>::iterator it = overrides.begin (); it != overrides.end (); it++)
+        if (!strchr (*it, '='))
+            fatal_error ("Error: setting override %s should be <setting>=<value>\n", *it);
+        else
+            *strchr (*it, '=') = '\0';
 
-    if (trace_dir == NULL)
-        fatal_error ("Error: trace file directory not defined!\n");
+    /** A synthetic workload takes the place of the trace directories.  */
+    Sim_settings probe;
 
+    probe.set_defaults ();
+    apply_overrides (&probe, overrides);
+    synthetic = (probe.synth_pattern != SYNTH_NONE);
 
+    if (synthetic && (convert || merge || !trace_dirs.empty ()))
+        fatal_error ("Error: synth_pattern replaces -t, -c and -m\n");
+    if (synthetic)
+        trace_dirs.push_back ((char *)"synthetic");
 
-    /** Init settings.  */
-    settings.set_defaults ();
-    settings.num_nodes = num_nodes;
-    settings.trace_dir = trace_dir;
+    if (trace_dirs.empty ())
+        fatal_error ("Error: trace file directory not defined!\n");
 
-    if (!strcmp(protocol,"MI"))
+    if (convert)
     {
-    	settings.protocol = MI_PRO;
+        for (dir = trace_dirs.begin (); dir != trace_dirs.end (); dir++)
+        {
+            int num_nodes = read_num_nodes (*dir);
+
+            for (int node = 0; node < num_nodes; node++)
+            {
+                char text_file[1000], binary_file[1000];
+                sprintf (text_file, "%s/p%d.trace", *dir, node);
+                sprintf (binary_file, "%s/p%d.btrace", *dir, node);
+                fprintf (stderr, "%s: %llu references\n", binary_file,
+                         (unsigned long long)convert_trace (text_file, binary_file));
+            }
+        }
+        exit (0);
     }
-    else if (!strcmp(protocol,"MSI"))
+
+    if (merge)
     {
-    	settings.protocol = MSI_PRO;
+        for (dir = trace_dirs.begin (); dir != trace_dirs.end (); dir++)
+        {
+            char text_file[1000], config_file[1000];
+            int num_nodes;
+
+            /** A merged trace.txt names its own cores, config is optional.  */
+            snprintf (text_file, sizeof (text_file), "%s/trace.txt", *dir);
+            snprintf (config_file, sizeof (config_file), "%s/config", *dir);
+            if (!access (text_file, R_OK) && access (config_file, R_OK))
+                num_nodes = 0;
+            else
+                num_nodes = read_num_nodes (*dir);
+
+            fprintf (stderr, "%s/%s: %llu references\n", *dir, MTRACE_FILE,
+                     (unsigned long long)merge_traces (*dir, num_nodes, binary_traces));
+        }
+        exit (0);
     }
-    else if (!strcmp(protocol,"MESI"))
+
+    if (protocols == NULL)
+        fatal_error ("Error: invalid protocol specified.\n");
+
+    for (char *name = strtok (protocols, ","); name; name = strtok (NULL, ","))
     {
-    	settings.protocol = MESI_PRO;
+        if (!strcmp (name, "ALL"))
+        {
+            protocol_names.insert (protocol_names.end (), all_protocols,
+                                   all_protocols + (probe.dir_enabled ? NUM_DIR_PROTOCOLS : NUM_PROTOCOLS));
+            continue;
+        }
+
+        parse_protocol (name);
+        protocol_names.push_back (name);
     }
-    else if (!strcmp(protocol,"MOSI"))
+
+    /** Every trace directory under every protocol, each with settings of its own.  */
+    for (dir = trace_dirs.begin (); dir != trace_dirs.end (); dir++)
     {
-    	settings.protocol = MOSI_PRO;
+        int num_nodes = synthetic ? probe.synth_cores : read_num_nodes (*dir);
+
+        for (int p = 0; p < (int)protocol_names.size (); p++)
+        {
+            Sim_settings *settings = new Sim_settings ();
+            sim_run_t run;
+
+            settings->set_defaults ();
+            settings->num_nodes = num_nodes;
+            settings->trace_dir = *dir;
+            settings->binary_traces = binary_traces;
+            settings->event_log = event_log;
+            apply_overrides (settings, overrides);
+            settings->protocol = parse_protocol (protocol_names[p]);
+
+            run.trace_dir = *dir;
+            run.protocol_name = protocol_names[p];
+            run.settings = settings;
+            run.traces = NULL;
+            run.run_time = 0;
+            runs.push_back (run);
+        }
     }
-    else if (!strcmp(protocol,"MOESI"))
+
+    /** A single run prints to stderr as it always has.  */
+    if (runs.size () == 1)
     {
-    	settings.protocol = MOESI_PRO;
+        Simulator *sim = new Simulator (*runs[0].settings);
+        sim->run ();
+        delete sim;
+        return 0;
     }
-    else if (!strcmp(protocol,"MOESIF"))
+
+    /** A sweep gives each run its own log file and spreads the runs over
+     *  the host.  Each run is an independent Simulator.  The traces of a
+     *  directory are decoded once and shared by all its protocols.  */
+    if (event_log)
+        fatal_error ("Error: -l takes a single trace directory and protocol\n");
+
+    if (mkdir (output_dir, 0777) && errno != EEXIST)
+        fatal_error ("Error: unable to create output directory %s\n", output_dir);
+
+    /** Logs are named after the last component of the trace directory,
+     *  so check for clashes before any trace is decoded or run.  */
+    for (int i = 0; i < (int)runs.size (); i++)
     {
-    	settings.protocol = MOESIF_PRO;
+        char dir[1000];
+        char log_file[1000];
+        const char *base;
+        int len;
+
+        snprintf (dir, sizeof (dir), "%s", runs[i].trace_dir);
+        len = strlen (dir);
+        while (len > 1 && dir[len - 1] == '/')
+            dir[--len] = '\0';
+        base = strrchr (dir, '/');
+        base = (base && base[1]) ? base + 1 : dir;
+        snprintf (log_file, sizeof (log_file), "%s/%s.%s.log", output_dir, base, runs[i].protocol_name);
+
+        for (int j = 0; j < i; j++)
+            if (!strcmp (runs[j].settings->text_log, log_file))
+                fatal_error ("Error: -t %s and -t %s would both write %s\n", runs[j].trace_dir, runs[i].trace_dir, log_file);
+        runs[i].settings->text_log = strdup (log_file);
     }
-    else
+
+    for (int i = 0; i < (int)runs.size (); i++)
     {
-    	fatal_error ("Error: invalid protocol specified.\n");
+        if (synthetic)
+            continue;
+        if (i % protocol_names.size () == 0)
+            trace_sets.push_back (new Trace_set (runs[i].trace_dir, runs[i].settings->num_nodes, binary_traces));
+        runs[i].traces = trace_sets.back ();
     }
 
-    //TODO: Add MI, MSI, MESI to config; Hardcoded for MI now    
+    if (jobs <= 0)
+        jobs = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    jobs = max (1, min (jobs, (int)runs.size ()));
+
+    sim_sweep_t sweep;
+    VECTOR<pthread_t> threads (jobs);
+
+    sweep.runs = &runs;
+    sweep.next = 0;
+    for (int t = 0; t < jobs; t++)
+        if (pthread_create (&threads[t], NULL, sweep_thread, &sweep))
+            fatal_error ("Error: unable to start sweep thread %d\n", t);
+    for (int t = 0; t < jobs; t++)
+        pthread_join (threads[t], NULL);
+
+    print_sweep (runs, protocol_names.size ());
+    fprintf (stdout, "Run output in %s/<trace>.<protocol>.log\n", output_dir);
+
+    for (int i = 0; i < (int)runs.size (); i++)
+        delete runs[i].settings;
+    for (int i = 0; i < (int)trace_sets.size (); i++)
+        delete trace_sets[i];
 
-    /** Build simulator.  */
-    Sim = new Simulator ();
-    Sim->run ();
+    return 0;
 }
@@ -1,47 +1,115 @@
+#include "event_log.h"
 #include "memory.h"
 #include "sim.h"
 
-extern Simulator * Sim;
-
-Memory_controller::Memory_controller(ModuleID moduleID, int hit_time)
-	: Module (moduleID, "MC_")
+Memory_controller::Memory_controller(Simulator *sim, ModuleID moduleID, int hit_time)
+	: Module (sim, moduleID, "MC_")
 {
+	dram_bank_t closed = {-1, 0};
+
 	this->hit_time = hit_time;
-	request_in_progress = false;
-	data_time = 0;
-	data_target = (ModuleID){-1,INVALID_M};
+
+	dram = sim->settings.mem_model_enabled;
+	if (dram)
+	{
+		if (sim->settings.dram_banks <= 0 || sim->settings.dram_row_size < (int)sim->settings.cache_line_size)
+			fatal_error ("%s: invalid DRAM geometry - %d banks, %d byte rows\n",
+			             name, sim->settings.dram_banks, sim->settings.dram_row_size);
+		banks.assign (sim->settings.dram_banks, closed);
+	}
+	data_bus_free = 0;
+
+	row_hits = 0;
+	row_misses = 0;
+	row_conflicts = 0;
+	writes = 0;
 }
 
 Memory_controller::~Memory_controller()
 {
 }
 
+static bool only_writes (const LIST<mc_read_t> &accesses)
+{
+	LIST<mc_read_t>::const_iterator it;
+
+	for (it = accesses.begin (); it != accesses.end (); it++)
+		if (!it->write)
+			return false;
+	return true;
+}
+
 void Memory_controller::tick()
 {
-    Mreq *request;
+    const Mreq *request;
+    LIST<mc_read_t>::iterator it;
+
+    /** Reads for another controller's slice of memory are not ours to answer.  */
+    request = read_input_port ();
+    if (request && (request->msg == GETS || request->msg == GETM) &&
+        sim->home_mc (request->addr) != moduleID.nodeID)
+    	request = NULL;
 
-    if ((request = read_input_port ()) != NULL)
+    if (request)
     {
-		if (request->msg != DATA)
+		if (request->msg == GETS || request->msg == GETM)
 		{
-			assert (!request_in_progress);
-			request_in_progress = true;
-			data_addr = request->addr;
-			data_target = request->src_mid;
-			data_time = Global_Clock + hit_time;
+			mc_read_t read = {request->addr, request->src_mid,
+			                  Global_Clock + hit_time, request->txn_id, false};
+
+			assert (sim->settings.bus_split_transaction || sim->settings.dir_enabled ||
+			        (only_writes (reads) && only_writes (queue)));
+			if (dram)
+				queue.push_back (read);
+			else
+				reads.push_back (read);
 		}
-		else
+		else if (request->msg == DATA)
 		{
-			request_in_progress = false;
+			/** The transaction has its data, drop our copy of the read.
+			 *  An access already issued still keeps its bank busy.  */
+			for (it = queue.begin (); it != queue.end (); it++)
+				if (!it->write && it->addr == request->addr && it->txn_id == request->txn_id)
+				{
+					queue.erase (it);
+					break;
+				}
+			for (it = reads.begin (); it != reads.end (); it++)
+				if (!it->write && it->addr == request->addr && it->txn_id == request->txn_id)
+				{
+					reads.erase (it);
+					break;
+				}
+
+			/** A writeback.  It takes a bank like a read but sends nothing back.  */
+			if (request->dest_mid == moduleID)
+			{
+				mc_read_t write = {request->addr, request->src_mid,
+				                   Global_Clock + hit_time, request->txn_id, true};
+
+				writes++;
+				if (dram)
+					queue.push_back (write);
+			}
 		}
+		/** A PUT's line follows in its own data phase, and a stale PUT's ACK
+		 *  brings nothing.  */
     }
 
-    if (request_in_progress && Global_Clock >= data_time)
+    if (dram)
+    	schedule ();
+
+    /** Reads finish in issue order: a fixed latency, or the shared DRAM data bus.  */
+    while (!reads.empty () && reads.front ().write && Global_Clock >= reads.front ().time)
+    	reads.pop_front ();
+
+    if (!reads.empty () && Global_Clock >= reads.front ().time)
     {
     	Mreq * new_request;
-    	new_request = new Mreq(DATA,data_addr,moduleID,data_target);
-    	request_in_progress = false;
-    	fprintf(stderr,"**** DATA SEND MC -- Clock: %lld\n",Global_Clock);
+    	new_request = new Mreq(sim, DATA,reads.front ().addr,moduleID,reads.front ().target);
+    	new_request->txn_id = reads.front ().txn_id;
+    	reads.pop_front ();
+    	sim->log->mc_data_send ();
     	this->write_output_port(new_request);
     }
 }
@@ -51,3 +119,107 @@ void Memory_controller::tock()
     fatal_error ("Memory controller tock should never be called!\n");
 }
 
+
+/** Nothing to do until an outstanding access returns its data or a bank
+ *  frees up for a queued read.  */
+timestamp_t Memory_controller::next_event()
+{
+	timestamp_t next = NEVER;
+	LIST<mc_read_t>::iterator it;
+
+	if (!reads.empty ())
+		next = reads.front ().time;
+
+	for (it = queue.begin (); it != queue.end (); it++)
+		next = min (next, banks[dram_bank (it->addr)].busy_until);
+
+	if (next == NEVER)
+		return NEVER;
+
+	return max (next, (timestamp_t)Global_Clock);
+}
+
+/*************
+ * DRAM model.
+ *************/
+/** Consecutive rows go to consecutive banks.  */
+int Memory_controller::dram_bank (paddr_t addr)
+{
+	return (addr / sim->settings.dram_row_size) % sim->settings.dram_banks;
+}
+
+long long int Memory_controller::dram_row (paddr_t addr)
+{
+	return addr / sim->settings.dram_row_size / sim->settings.dram_banks;
+}
+
+/** Issue at most one queued access per cycle to an idle bank.  FCFS only ever
+ *  issues the oldest read.  FR-FCFS issues the oldest read that hits an open
+ *  row, or else the oldest read whose bank is idle.  */
+void Memory_controller::schedule (void)
+{
+	LIST<mc_read_t>::iterator it;
+	LIST<mc_read_t>::iterator pick = queue.end ();
+	dram_bank_t *bank;
+	long long int row;
+	int latency;
+
+	for (it = queue.begin (); it != queue.end (); it++)
+	{
+		bank = &banks[dram_bank (it->addr)];
+		if (bank->busy_until > Global_Clock)
+		{
+			if (sim->settings.dram_scheduler == DRAM_FCFS)
+				return;
+			continue;
+		}
+
+		if (pick == queue.end ())
+			pick = it;
+
+		if (sim->settings.dram_scheduler == DRAM_FCFS || bank->open_row == dram_row (it->addr))
+		{
+			pick = it;
+			break;
+		}
+	}
+
+	if (pick == queue.end ())
+		return;
+
+	bank = &banks[dram_bank (pick->addr)];
+	row = dram_row (pick->addr);
+
+	if (bank->open_row == row)
+	{
+		latency = sim->settings.dram_t_cas;
+		row_hits++;
+	}
+	else if (bank->open_row < 0)
+	{
+		latency = sim->settings.dram_t_rcd + sim->settings.dram_t_cas;
+		row_misses++;
+	}
+	else
+	{
+		latency = sim->settings.dram_t_rp + sim->settings.dram_t_rcd + sim->settings.dram_t_cas;
+		row_conflicts++;
+	}
+
+	bank->open_row = row;
+
+	/** The burst waits for the data bus, the bank stays busy until it is done.  */
+	pick->time = max ((timestamp_t)(Global_Clock + latency), data_bus_free) + sim->settings.dram_t_burst;
+	data_bus_free = pick->time;
+	bank->busy_until = pick->time;
+
+	reads.push_back (*pick);
+	queue.erase (pick);
+}
+
+void Memory_controller::print_stats (void)
+{
+	sim->log->text (stderr, "DRAM Row Hits:    %8lld accesses\n", (long long)row_hits);
+	sim->log->text (stderr, "DRAM Row Misses:  %8lld accesses\n", (long long)row_misses);
+	sim->log->text (stderr, "DRAM Conflicts:   %8lld accesses\n", (long long)row_conflicts);
+}
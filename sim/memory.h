@@ -12,21 +12,55 @@
 
 using namespace std;
 
+/** A read waiting in the DRAM queue, or out for its access latency.
+ *  Writebacks go through the same queue and only hold their bank.  */
+typedef struct {
+    paddr_t addr;
+    ModuleID target;
+    timestamp_t time;        /** Data ready, once issued.  */
+    int txn_id;
+    bool write;
+} mc_read_t;
+
+/** DRAM bank with an open-page row buffer.  */
+typedef struct {
+    long long int open_row;  /** -1 while precharged.  */
+    timestamp_t busy_until;
+} dram_bank_t;
+
 class Memory_controller : public Module
 {
 public:
-	Memory_controller(ModuleID moduleID, int hit_time);
+	Memory_controller(Simulator *sim, ModuleID moduleID, int hit_time);
 	~Memory_controller();
 
     int hit_time;
 
-    bool request_in_progress;
-    timestamp_t data_time;
-    paddr_t data_addr;
-    ModuleID data_target;
+    /** Outstanding accesses in issue order.  The atomic bus allows only one read.  */
+    LIST<mc_read_t> reads;
+
+    /** DRAM model: reads wait in queue for a bank, banks keep their last
+     *  row open and all banks share one data bus.  */
+    bool dram;
+    LIST<mc_read_t> queue;
+    VECTOR<dram_bank_t> banks;
+    timestamp_t data_bus_free;
+
+    counter_t row_hits;
+    counter_t row_misses;
+    counter_t row_conflicts;
+
+    /** Lines written back by caches.  */
+    counter_t writes;
+
+    int dram_bank (paddr_t addr);
+    long long int dram_row (paddr_t addr);
+    void schedule (void);
+    void print_stats (void);
 
 	void tick();
 	void tock();
+	timestamp_t next_event();
 };
 
 #endif /* MEM_MAIN_H_ */
@@ -0,0 +1,107 @@
+#include "hash_table.h"
+#include "migratory.h"
+#include "sim.h"
+
+Migratory_detector::Migratory_detector (Simulator *sim, ModuleID moduleID)
+{
+    migratory_entry_t empty = {HASH_EMPTY_TAG, 0, -1, false};
+
+    this->sim = sim;
+    this->moduleID = moduleID;
+    threshold = sim->settings.migratory_threshold;
+
+    if (sim->settings.dir_enabled)
+        fatal_error ("Migratory: migratory_enabled needs the bus, not dir_enabled\n");
+    if (sim->settings.migratory_entries < 1 || !ISPOW2 (sim->settings.migratory_entries))
+        fatal_error ("Migratory: migratory_entries must be a power of two, not %d\n",
+                     sim->settings.migratory_entries);
+    if (threshold < 1 || threshold > MIGRATORY_MAX_COUNT)
+        fatal_error ("Migratory: migratory_threshold must be 1 to %d, not %d\n",
+                     MIGRATORY_MAX_COUNT, threshold);
+
+    table.assign (sim->settings.migratory_entries, empty);
+}
+
+migratory_entry_t *Migratory_detector::find (paddr_t addr)
+{
+    migratory_entry_t *entry;
+
+    entry = &table[(addr >> sim->settings.cache_line_size_log2) & (table.size () - 1)];
+    return (entry->tag == addr) ? entry : NULL;
+}
+
+/** A line that maps onto another's slot starts its history over.  */
+migratory_entry_t *Migratory_detector::insert (paddr_t addr)
+{
+    migratory_entry_t *entry;
+
+    entry = &table[(addr >> sim->settings.cache_line_size_log2) & (table.size () - 1)];
+    if (entry->tag != addr)
+    {
+        entry->tag = addr;
+        entry->count = 0;
+        entry->reader = -1;
+        entry->unconfirmed = false;
+    }
+    return entry;
+}
+
+void Migratory_detector::snoop (const Mreq *request)
+{
+    migratory_entry_t *entry;
+    int src = request->src_mid.nodeID;
+
+    /** The line was handed to us, and with it its classification.  */
+    if (request->msg == DATA && request->migratory)
+    {
+        entry = insert (request->addr);
+        entry->count = max (entry->count, threshold);
+        entry->reader = -1;
+        entry->unconfirmed = true;
+        return;
+    }
+
+    if (request->src_mid == moduleID ||
+        (request->msg != GETS && request->msg != GETM && request->msg != UPGRADE))
+        return;
+
+    entry = find (request->addr);
+    if (!entry || entry->reader < 0)
+        return;
+
+    /** Our reader writing the line is a handoff, anyone else is sharing.  */
+    if (request->msg != GETS && entry->reader == src)
+        entry->count = min (entry->count + 1, MIGRATORY_MAX_COUNT);
+    else if (entry->count > 0)
+        entry->count--;
+    entry->reader = -1;
+}
+
+bool Migratory_detector::hand_over (paddr_t addr, int requester)
+{
+    migratory_entry_t *entry = insert (addr);
+
+    /** Read again before we wrote it: it was not migrating after all.  */
+    if (entry->unconfirmed)
+    {
+        entry->count = 0;
+        entry->unconfirmed = false;
+    }
+
+    if (entry->count >= threshold)
+    {
+        entry->reader = -1;
+        return true;
+    }
+
+    entry->reader = requester;
+    return false;
+}
+
+void Migratory_detector::stored (paddr_t addr)
+{
+    migratory_entry_t *entry = find (addr);
+
+    if (entry)
+        entry->unconfirmed = false;
+}
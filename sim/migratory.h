@@ -0,0 +1,59 @@
+#ifndef MIGRATORY_H_
+#define MIGRATORY_H_
+
+#include "module.h"
+#include "mreq.h"
+#include "types.h"
+
+class Simulator;
+
+/** Highest a line's handoff count goes.  */
+#define MIGRATORY_MAX_COUNT  3
+
+/** What one cache remembers of a line.  */
+typedef struct {
+    paddr_t tag;
+    int count;               /** Read-then-write handoffs seen, saturating.  */
+    int reader;              /** Core we last gave the line to on a GETS, -1 if none.  */
+    bool unconfirmed;        /** Came to us exclusively and not stored to yet.  */
+} migratory_entry_t;
+
+/**
+ * Migratory sharing detector of one L1, MESI and MOESI on the bus.
+ *
+ * Lock protected data moves between cores as a read miss and then a store,
+ * a GETS followed by a GETM or UPGRADE for the same line, so each handoff
+ * is two bus transactions.  The detector watches for that pair: a line we
+ * supplied from M to a reader which that same reader then writes counts up
+ * a handoff, a second reader or another writer in between counts one
+ * down.  Once a line has migratory_threshold handoffs, the next GETS that
+ * finds it in M here takes it exclusively, dirty, and this copy goes
+ * invalid, so the reader's store hits.  The DATA carries the
+ * classification to the next core.  A core that got a line this way and is
+ * asked for it again before storing to it guessed wrong: the count is
+ * cleared and the line is shared as usual.
+ *
+ * History lives in a direct mapped table of migratory_entries lines.
+ */
+class Migratory_detector {
+public:
+    Migratory_detector (Simulator *sim, ModuleID moduleID);
+
+    Simulator *sim;
+    ModuleID moduleID;
+    VECTOR<migratory_entry_t> table;
+    int threshold;
+
+    migratory_entry_t *find (paddr_t addr);
+    migratory_entry_t *insert (paddr_t addr);
+
+    /** A request on the bus, ours or another core's.  */
+    void snoop (const Mreq *request);
+    /** We hold addr in M and requester read missed on it: true if it
+     *  should take the line exclusively.  Otherwise it will be a sharer.  */
+    bool hand_over (paddr_t addr, int requester);
+    /** Our processor stored to addr.  */
+    void stored (paddr_t addr);
+};
+
+#endif // MIGRATORY_H_
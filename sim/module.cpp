@@ -3,26 +3,25 @@
 #include "bus.h"
 #include "module.h"
 #include "mreq.h"
+#include "network.h"
 #include "sim.h"
 #include "types.h"
 
-extern Simulator *Sim;
-
-bool ModuleID::operator== (const ModuleID &mid)
+bool ModuleID::operator== (const ModuleID &mid) const
 {
     return (this->nodeID == mid.nodeID &&
             this->module_index == mid.module_index);
 }
 
-bool ModuleID::operator!= (const ModuleID &mid)
+bool ModuleID::operator!= (const ModuleID &mid) const
 {
     return !(this->nodeID == mid.nodeID &&
              this->module_index == mid.module_index);
 }
 
-Module *ModuleID::get_module ()
+Module *ModuleID::get_module (Simulator *sim)
 {
-    Module *ret = Sim->Nd[nodeID]->mod[module_index];
+    Module *ret = sim->Nd[nodeID]->mod[module_index];
     assert (ret != NULL);
     return ret;
 }
@@ -30,8 +29,9 @@ Module *ModuleID::get_module ()
 /************************************************************
  * Module constructor, destructor, and associated functions.
  ************************************************************/
-Module::Module (ModuleID moduleID, const char *name)
+Module::Module (Simulator *sim, ModuleID moduleID, const char *name)
 {
+    this->sim = sim;
     this->moduleID = moduleID;
     this->name = strdup (name);
 }
@@ -42,26 +42,64 @@ Module::~Module (void)
         free (name);
 }
 
-Mreq *Module::read_input_port (void)
+const Mreq *Module::read_input_port (void)
 {
-    return Sim->bus->bus_snoop ();
+    if (sim->settings.dir_enabled)
+        return sim->get_NI (moduleID.nodeID)->receive (moduleID.module_index);
+
+    return sim->bus->bus_snoop ();
 }
 
 bool Module::write_output_port (Mreq *mreq)
 {
-    return Sim->bus->bus_request (mreq);
+    /** Held back until every node is through the phase.  */
+    if (sim->parallel_phase)
+    {
+        sim->Nd[moduleID.nodeID]->staged_msgs.push_back (mreq);
+        return true;
+    }
+
+    return post_message (sim, mreq);
+}
+
+/** Hand a message to the bus, or the network in directory mode.  */
+bool post_message (Simulator *sim, Mreq *mreq)
+{
+    if (sim->settings.dir_enabled)
+    {
+        sim->network->send (mreq);
+        return true;
+    }
+
+    return sim->bus->bus_request (mreq);
+}
+
+/** Conservative default: assume work every cycle.  */
+timestamp_t Module::next_event (void)
+{
+    return Global_Clock;
 }
 
 void print_id (const char *str, ModuleID mid)
 {
-    switch (mid.module_index) {
-    case NI_M: fprintf (stderr, "%4s:%3d/NI  ", str, mid.nodeID); break;
-    case PR_M: fprintf (stderr, "%4s:%3d/PR  ", str, mid.nodeID); break;
-    case L1_M: fprintf (stderr, "%4s:%3d/L1  ", str, mid.nodeID); break;
-    case L2_M: fprintf (stderr, "%4s:%3d/L2  ", str, mid.nodeID); break;
-    case L3_M: fprintf (stderr, "%4s:%3d/L3  ", str, mid.nodeID); break;
-    case MC_M: fprintf (stderr, "%4s:%3d/MC  ", str, mid.nodeID); break;
-    case INVALID_M:  fprintf (stderr, "%4s:  None ", str); break;
+    char id[32];
+
+    format_id (id, sizeof (id), str, mid.nodeID, mid.module_index);
+    fputs (id, stderr);
+}
+
+int format_id (char *buf, size_t size, const char *str, int nodeID, module_t module_index)
+{
+    switch (module_index) {
+    case NI_M: return snprintf (buf, size, "%4s:%3d/NI  ", str, nodeID);
+    case PR_M: return snprintf (buf, size, "%4s:%3d/PR  ", str, nodeID);
+    case L1_M: return snprintf (buf, size, "%4s:%3d/L1  ", str, nodeID);
+    case L2_M: return snprintf (buf, size, "%4s:%3d/L2  ", str, nodeID);
+    case L3_M: return snprintf (buf, size, "%4s:%3d/L3  ", str, nodeID);
+    case MC_M: return snprintf (buf, size, "%4s:%3d/MC  ", str, nodeID);
+    case DIR_M: return snprintf (buf, size, "%4s:%3d/DIR ", str, nodeID);
+    case INVALID_M:  return snprintf (buf, size, "%4s:  None ", str);
+    default: return 0;
     }
 }
 
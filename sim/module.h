@@ -23,6 +23,7 @@ typedef enum {
     L2_M,
     L3_M,
     MC_M,
+    DIR_M,
     INVALID_M
 } module_t;
 
@@ -31,10 +32,10 @@ public:
     int nodeID;
     module_t module_index;
 
-    bool operator== (const ModuleID &mid);
-    bool operator!= (const ModuleID &mid);
+    bool operator== (const ModuleID &mid) const;
+    bool operator!= (const ModuleID &mid) const;
 
-    Module* get_module();
+    Module* get_module (Simulator *sim);
 };
 
 class Bus;
@@ -43,17 +44,28 @@ class Module {
 public:
     char *name;
     ModuleID moduleID;
+    Simulator *sim;
 
-	Module (ModuleID moduleID, const char *name);
+	Module (Simulator *sim, ModuleID moduleID, const char *name);
 	virtual ~Module();
 
- 	Mreq *read_input_port (void);
+ 	/** The transaction on the bus this cycle, or NULL.  Owned by the bus
+ 	 *  and valid until the next bus tick, so snoopers must not keep it.
+ 	 *  In directory mode, the next message the network delivered to this
+ 	 *  module, valid until the next read.  */
+ 	const Mreq *read_input_port (void);
     bool write_output_port (Mreq *mreq);
 
     virtual void tick (void) =0;
     virtual void tock (void) =0;
+
+    /** Earliest cycle at which tick/tock could change any state.  Lets the
+     *  simulator skip over cycles where every module is idle.  */
+    virtual timestamp_t next_event (void);
 };
 
+bool post_message (Simulator *sim, Mreq *mreq);
 void print_id (const char *str, ModuleID mid);
+int format_id (char *buf, size_t size, const char *str, int nodeID, module_t module_index);
 
 #endif // MODULE_H_
@@ -1,26 +1,28 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include "event_log.h"
 #include "mreq.h"
 #include "settings.h"
 #include "sim.h"
 
-extern Sim_settings settings;
-extern Simulator *Sim;
-
 using namespace std;
 
 /***************
  * Constructor.
  ***************/
-Mreq::Mreq (message_t msg, paddr_t addr, ModuleID src_mid, ModuleID dest_mid)
+Mreq::Mreq (Simulator *sim, message_t msg, paddr_t addr, ModuleID src_mid, ModuleID dest_mid)
 {
+    this->sim = sim;
     this->msg = msg;
-    this->addr = addr & ((~0x0) << settings.cache_line_size_log2);
+    this->addr = addr & ((~0x0) << sim->settings.cache_line_size_log2);
     this->src_mid = src_mid;
     this->dest_mid = dest_mid;
     this->fwd_mid = (ModuleID){-1,INVALID_M};
     this->INV_ACK_count = 0;
+    this->txn_id = -1;
+    this->shared = false;
+    this->migratory = false;
     this->req_time = Global_Clock;
     this->stalled = false;
     this->preq =NULL;
@@ -30,19 +32,21 @@ Mreq::~Mreq(void)
 {
 }
 
-void Mreq::print_msg (ModuleID mid, const char *add_msg)
+void Mreq::print_msg (ModuleID mid, const char *add_msg) const
 {
     //TODO: convert fprintfs to c++-ishy output
+    sim->log->flush ();
     print_id ("node", mid);
     print_id ("src", src_mid);
     print_id ("dest", dest_mid);
-    fprintf (stderr, "tag: 0x%8llx clock: %8lld ", (long long int)addr>>settings.cache_line_size_log2, Global_Clock);
+    fprintf (stderr, "tag: 0x%8llx clock: %8lld ", (long long int)addr>>sim->settings.cache_line_size_log2, Global_Clock);
     fprintf (stderr, " %8s\n", Mreq::message_t_str[msg]);
 }
 
-void Mreq::dump ()
+void Mreq::dump () const
 {
     //TODO: convert fprintfs to c++-ishy output
+    sim->log->flush ();
     fprintf (stderr, "Request Dump ");
     print_id ("src", src_mid);
     print_id ("dest", dest_mid);
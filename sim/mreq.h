@@ -15,13 +15,16 @@ using namespace std;
 
 class Mreq {
 public:
-    Mreq (message_t msg = MREQ_INVALID,
+    Mreq (Simulator *sim,
+          message_t msg = MREQ_INVALID,
           paddr_t addr = (paddr_t)0x0,
           ModuleID src_id = (ModuleID){-1,INVALID_M},
           ModuleID dest_id = (ModuleID){-1,INVALID_M});
 
 	~Mreq ();
 
+    /** The simulation the message belongs to.  */
+    Simulator *sim;
     message_t msg;
     paddr_t pc;
 	paddr_t addr;
@@ -30,14 +33,17 @@ public:
     ModuleID dest_mid;
     ModuleID fwd_mid;
     int INV_ACK_count;
+    int txn_id;              /** Split-transaction bus or directory tag, -1 if none.  */
+    bool shared;             /** Directory mode: stands in for the bus shared line.  */
+    bool migratory;          /** DATA handing a migratory line over exclusively.  */
     timestamp_t req_time;
     bool stalled;
 
     static const char * message_t_str[MREQ_MESSAGE_NUM];
 
     /** Debug.  */
-    void print_msg (ModuleID mid, const char *add_msg);
-    void dump (void);
+    void print_msg (ModuleID mid, const char *add_msg) const;
+    void dump (void) const;
 };
 
 #endif /*MREQ_H_*/
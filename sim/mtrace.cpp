@@ -0,0 +1,313 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mtrace.h"
+#include "sim.h"
+
+/*************************
+ * Reading.
+ *************************/
+Merged_trace::Merged_trace (const char *trace_file)
+{
+    const mtrace_block_t *index;
+    struct stat st;
+    int fd;
+
+    fd = open (trace_file, O_RDONLY);
+    if (fd < 0 || fstat (fd, &st) < 0)
+        fatal_error ("Trace: unable to open %s\n", trace_file);
+
+    if ((size_t)st.st_size < sizeof (mtrace_header_t))
+        fatal_error ("Trace: %s is too short to be a merged trace\n", trace_file);
+
+    map_size = st.st_size;
+    map = (const uint8_t *)mmap (NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+
+    if (map == MAP_FAILED)
+        fatal_error ("Trace: unable to map %s\n", trace_file);
+
+    header = (const mtrace_header_t *)map;
+    if (memcmp (header->magic, MTRACE_MAGIC, sizeof (header->magic)) ||
+        header->version != MTRACE_VERSION)
+        fatal_error ("Trace: %s is not a version %d merged trace\n", trace_file, MTRACE_VERSION);
+
+    if (header->index_offset > map_size ||
+        header->num_blocks > (map_size - header->index_offset) / sizeof (mtrace_block_t))
+        fatal_error ("Trace: %s has a truncated index\n", trace_file);
+
+    /** Sort the index out by core, each keeps its blocks in file order.  */
+    index = (const mtrace_block_t *)(map + header->index_offset);
+    blocks.resize (header->num_cores);
+    for (uint64_t i = 0; i < header->num_blocks; i++)
+    {
+        if (index[i].core >= header->num_cores ||
+            index[i].offset + index[i].bytes > header->index_offset)
+            fatal_error ("Trace: %s has a bad index entry %llu\n", trace_file, (unsigned long long)i);
+        blocks[index[i].core].push_back (&index[i]);
+    }
+}
+
+Merged_trace::~Merged_trace ()
+{
+    munmap ((void *)map, map_size);
+}
+
+Trace_reader *Merged_trace::reader (int node) const
+{
+    if (node >= (int)header->num_cores)
+        fatal_error ("Trace: merged trace has %d cores, no core %d\n", header->num_cores, node);
+    return new Merged_trace_reader (this, node);
+}
+
+Merged_trace_reader::Merged_trace_reader (const Merged_trace *merged, int node)
+{
+    this->merged = merged;
+    blocks = &merged->blocks[node];
+    next_block = 0;
+    cur = NULL;
+    end = NULL;
+    prev_addr = 0;
+}
+
+/** LEB128 varint.  */
+uint64_t Merged_trace_reader::read_varint (void)
+{
+    uint64_t v = 0;
+    int shift = 0;
+
+    do {
+        if (cur >= end)
+            fatal_error ("Trace: truncated merged trace block\n");
+        v |= (uint64_t)(*cur & 0x7f) << shift;
+        shift += 7;
+    } while (*cur++ & 0x80);
+
+    return v;
+}
+
+bool Merged_trace_reader::next (trace_ref_t *ref)
+{
+    while (cur >= end)
+    {
+        const mtrace_block_t *block;
+
+        if (next_block == blocks->size ())
+            return false;
+
+        block = (*blocks)[next_block++];
+        cur = merged->map + block->offset;
+        end = cur + block->bytes;
+        prev_addr = 0;
+    }
+
+    if (btrace_unpack (read_varint (), 2, &prev_addr, ref))
+        ref->gap = (uint32_t)read_varint ();
+
+    /** Timestamps are not used by the simulation.  */
+    if (merged->header->flags & MTRACE_TIMESTAMPS)
+        read_varint ();
+    return true;
+}
+
+/*************************
+ * Writing.
+ *************************/
+Merged_trace_writer::Merged_trace_writer (const char *trace_file, int num_cores, bool timestamps)
+{
+    outfile = fopen (trace_file, "wb");
+    if (!outfile)
+        fatal_error ("Trace: unable to create %s\n", trace_file);
+
+    /** Counts and index offset are patched in on close.  */
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, MTRACE_MAGIC, sizeof (header.magic));
+    header.version = MTRACE_VERSION;
+    header.flags = timestamps ? MTRACE_TIMESTAMPS : 0;
+    header.num_cores = num_cores;
+    fwrite (&header, sizeof (header), 1, outfile);
+
+    pending.resize (num_cores);
+    for (int i = 0; i < num_cores; i++)
+    {
+        pending[i].refs = 0;
+        pending[i].prev_addr = 0;
+        pending[i].prev_time = 0;
+    }
+}
+
+Merged_trace_writer::~Merged_trace_writer ()
+{
+    for (int i = 0; i < (int)pending.size (); i++)
+        flush_block (i);
+
+    header.num_cores = pending.size ();
+    header.num_blocks = index.size ();
+    header.index_offset = ftell (outfile);
+    if (!index.empty ())
+        fwrite (&index[0], sizeof (mtrace_block_t), index.size (), outfile);
+
+    fseek (outfile, 0, SEEK_SET);
+    fwrite (&header, sizeof (header), 1, outfile);
+    fclose (outfile);
+}
+
+void Merged_trace_writer::write (int core, const trace_ref_t *ref, uint64_t timestamp)
+{
+    pending_block_t *block;
+    uint8_t buf[30];
+    int len;
+
+    if (core < 0)
+        fatal_error ("Trace: bad core %d in a merged trace\n", core);
+
+    /** Cores turn up as they are seen when there is no config to go by.  */
+    while ((int)pending.size () <= core)
+    {
+        pending_block_t empty;
+
+        empty.refs = 0;
+        empty.prev_addr = 0;
+        empty.prev_time = 0;
+        pending.push_back (empty);
+    }
+
+    block = &pending[core];
+    len = btrace_pack (ref, &block->prev_addr, buf);
+    if (header.flags & MTRACE_TIMESTAMPS)
+    {
+        len += put_varint (buf + len, zigzag_encode ((int64_t)(timestamp - block->prev_time)));
+        block->prev_time = timestamp;
+    }
+
+    block->bytes.insert (block->bytes.end (), buf, buf + len);
+    header.num_refs++;
+    if (++block->refs == MTRACE_BLOCK_REFS)
+        flush_block (core);
+}
+
+void Merged_trace_writer::flush_block (int core)
+{
+    pending_block_t *block = &pending[core];
+    mtrace_block_t entry;
+
+    if (!block->refs)
+        return;
+
+    entry.offset = ftell (outfile);
+    entry.bytes = block->bytes.size ();
+    entry.core = core;
+    index.push_back (entry);
+    fwrite (&block->bytes[0], 1, block->bytes.size (), outfile);
+
+    block->bytes.clear ();
+    block->refs = 0;
+    block->prev_addr = 0;
+    block->prev_time = 0;
+}
+
+char *find_merged_trace (const char *trace_dir)
+{
+    char trace_file[1000];
+
+    snprintf (trace_file, sizeof (trace_file), "%s/%s", trace_dir, MTRACE_FILE);
+    return access (trace_file, R_OK) ? NULL : strdup (trace_file);
+}
+
+/** A trace.txt line: "core r|w 0xADDR [gap] [@timestamp]".  */
+static bool read_merged_line (FILE *infile, int *core, trace_ref_t *ref, uint64_t *timestamp, bool *has_time)
+{
+    char line[256];
+    char *at;
+    unsigned long long int addr, time;
+    unsigned int gap = 0;
+    int n;
+
+    do {
+        if (!fgets (line, sizeof (line), infile))
+            return false;
+    } while ((n = sscanf (line, " %d %c 0x%llx %u", core, &ref->op, &addr, &gap)) == EOF);
+
+    if (n < 3)
+        fatal_error ("Trace: bad merged trace line %s", line);
+
+    ref->addr = (paddr_t)addr;
+    ref->gap = (n == 4) ? gap : 0;
+
+    at = strchr (line, '@');
+    *has_time = (at && sscanf (at + 1, "%llu", &time) == 1);
+    *timestamp = *has_time ? time : 0;
+    return true;
+}
+
+uint64_t merge_traces (const char *trace_dir, int num_nodes, bool binary_traces)
+{
+    char text_file[1000], trace_file[1000];
+    FILE *infile;
+    uint64_t num_refs;
+
+    snprintf (text_file, sizeof (text_file), "%s/trace.txt", trace_dir);
+    snprintf (trace_file, sizeof (trace_file), "%s/%s", trace_dir, MTRACE_FILE);
+
+    if ((infile = fopen (text_file, "r")))
+    {
+        Merged_trace_writer *out = NULL;
+        trace_ref_t ref;
+        uint64_t timestamp;
+        bool has_time;
+        int core;
+
+        /** Timestamps are kept if the first line has one.  */
+        while (read_merged_line (infile, &core, &ref, &timestamp, &has_time))
+        {
+            if (ref.op != 'r' && ref.op != 'w')
+                fatal_error ("Trace: %s - unknown operation %c\n", text_file, ref.op);
+            if (!out)
+                out = new Merged_trace_writer (trace_file, num_nodes, has_time);
+            out->write (core, &ref, timestamp);
+        }
+        fclose (infile);
+
+        if (!out)
+            out = new Merged_trace_writer (trace_file, num_nodes, false);
+        num_refs = out->header.num_refs;
+        delete out;
+        return num_refs;
+    }
+
+    /** Per-core files, a block of each core in turn.  */
+    Merged_trace_writer out (trace_file, num_nodes, false);
+    VECTOR<Trace_reader *> in (num_nodes);
+    int live = num_nodes;
+
+    for (int node = 0; node < num_nodes; node++)
+        in[node] = open_trace (trace_dir, node, binary_traces);
+
+    while (live)
+    {
+        for (int node = 0; node < num_nodes; node++)
+        {
+            trace_ref_t ref;
+            int i;
+
+            for (i = 0; in[node] && i < MTRACE_BLOCK_REFS && in[node]->next (&ref); i++)
+            {
+                if (ref.op != 'r' && ref.op != 'w')
+                    fatal_error ("Trace: core %d - unknown operation %c\n", node, ref.op);
+                out.write (node, &ref);
+            }
+
+            if (in[node] && i < MTRACE_BLOCK_REFS)
+            {
+                delete in[node];
+                in[node] = NULL;
+                live--;
+            }
+        }
+    }
+
+    return out.header.num_refs;
+}
@@ -0,0 +1,120 @@
+#ifndef MTRACE_H_
+#define MTRACE_H_
+
+#include <stdio.h>
+
+#include "trace.h"
+#include "types.h"
+
+/**
+ * Merged multi-core trace, trace.mtrace in a trace directory.
+ *
+ * Every core's references live in the one file, so a run with a thousand
+ * cores maps one file instead of opening a thousand.  Layout:
+ *
+ *  header (magic, version, flags, core count, block count, reference
+ *  count, index offset), then blocks of up to MTRACE_BLOCK_REFS
+ *  references of a single core, then the index, one mtrace_block_t per
+ *  block in file order.
+ *
+ * Blocks of different cores are interleaved in the order they filled up,
+ * which keeps the file roughly in time order.  A block is encoded like a
+ * version 2 btrace, deltas starting from zero at each block, and with
+ * MTRACE_TIMESTAMPS each record is followed by a zigzag varint of its
+ * timestamp less the one before it in the block.  Timestamps are kept for
+ * tools working on the file; the simulation itself only uses the gaps.
+ *
+ * Each core reads its own blocks through the index, straight out of the
+ * mapping.
+ */
+#define MTRACE_MAGIC         "CSXMERGE"
+#define MTRACE_VERSION       1
+#define MTRACE_FILE          "trace.mtrace"
+#define MTRACE_BLOCK_REFS    4096
+
+/** mtrace_header_t flags.  */
+#define MTRACE_TIMESTAMPS    0x1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t num_cores;
+    uint32_t reserved;
+    uint64_t num_blocks;
+    uint64_t num_refs;
+    uint64_t index_offset;
+} mtrace_header_t;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t core;
+} mtrace_block_t;
+
+/** A mapped trace.mtrace, read only once open so every core shares it.  */
+class Merged_trace {
+public:
+    Merged_trace (const char *trace_file);
+    ~Merged_trace ();
+
+    const uint8_t *map;
+    size_t map_size;
+    const mtrace_header_t *header;
+
+    /** Indices of each core's blocks in the index, in order.  */
+    VECTOR< VECTOR<const mtrace_block_t *> > blocks;
+
+    Trace_reader *reader (int node) const;
+};
+
+/** One core's slice of a Merged_trace.  */
+class Merged_trace_reader : public Trace_reader {
+public:
+    Merged_trace_reader (const Merged_trace *merged, int node);
+
+    const Merged_trace *merged;
+    const VECTOR<const mtrace_block_t *> *blocks;
+    size_t next_block;
+
+    const uint8_t *cur;
+    const uint8_t *end;
+    paddr_t prev_addr;
+
+    uint64_t read_varint (void);
+    bool next (trace_ref_t *ref);
+};
+
+class Merged_trace_writer {
+public:
+    Merged_trace_writer (const char *trace_file, int num_cores, bool timestamps);
+    ~Merged_trace_writer ();
+
+    FILE *outfile;
+    mtrace_header_t header;
+    VECTOR<mtrace_block_t> index;
+
+    /** Block being filled for each core.  */
+    typedef struct {
+        VECTOR<uint8_t> bytes;
+        int refs;
+        paddr_t prev_addr;
+        uint64_t prev_time;
+    } pending_block_t;
+    VECTOR<pending_block_t> pending;
+
+    void write (int core, const trace_ref_t *ref, uint64_t timestamp = 0);
+    void flush_block (int core);
+};
+
+/** Path of trace_dir's trace.mtrace if there is one, else NULL.  */
+char *find_merged_trace (const char *trace_dir);
+
+/**
+ * Write trace_dir/trace.mtrace.  From trace_dir/trace.txt if there is one,
+ * lines of "core r|w 0xADDR [gap] [@timestamp]", else from the per-core
+ * files of num_nodes cores.  Returns the number of references.
+ */
+uint64_t merge_traces (const char *trace_dir, int num_nodes, bool binary_traces);
+
+#endif // MTRACE_H_
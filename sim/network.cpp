@@ -0,0 +1,622 @@
+#include "event_log.h"
+#include "network.h"
+#include "sim.h"
+
+static int opposite_port (int port)
+{
+    switch (port) {
+    case PORT_EAST:          return PORT_WEST;
+    case PORT_WEST:          return PORT_EAST;
+    case PORT_NORTH:         return PORT_SOUTH;
+    case PORT_SOUTH:         return PORT_NORTH;
+    case PORT_EXPRESS_EAST:  return PORT_EXPRESS_WEST;
+    case PORT_EXPRESS_WEST:  return PORT_EXPRESS_EAST;
+    case PORT_EXPRESS_NORTH: return PORT_EXPRESS_SOUTH;
+    case PORT_EXPRESS_SOUTH: return PORT_EXPRESS_NORTH;
+    default:                 return PORT_LOCAL;
+    }
+}
+
+/** Output port towards dest_router, dimension order.  */
+static int route_port (Network *net, int router, int dest_router)
+{
+    int x = router % net->x_dim;
+    int y = router / net->x_dim;
+    int dx = dest_router % net->x_dim - x;
+    int dy = dest_router / net->x_dim - y;
+
+    if (net->torus)
+    {
+        /** Shortest way round the ring.  */
+        dx = (dx + net->x_dim) % net->x_dim;
+        dy = (dy + net->y_dim) % net->y_dim;
+        if (dx)
+            return (dx <= net->x_dim / 2) ? PORT_EAST : PORT_WEST;
+        if (dy)
+            return (dy <= net->y_dim / 2) ? PORT_SOUTH : PORT_NORTH;
+        return PORT_LOCAL;
+    }
+
+    /** Express links carry a packet while it is at least a link length away.  */
+    if (dx)
+    {
+        if (net->express_len && ABS (dx) >= net->express_len)
+            return (dx > 0) ? PORT_EXPRESS_EAST : PORT_EXPRESS_WEST;
+        return (dx > 0) ? PORT_EAST : PORT_WEST;
+    }
+    if (dy)
+    {
+        if (net->express_len && ABS (dy) >= net->express_len)
+            return (dy > 0) ? PORT_EXPRESS_SOUTH : PORT_EXPRESS_NORTH;
+        return (dy > 0) ? PORT_SOUTH : PORT_NORTH;
+    }
+    return PORT_LOCAL;
+}
+
+/*************************
+ * Router.
+ *************************/
+Router::Router (Network *network, int id)
+{
+    input_vc_t idle;
+    int x_dim = network->x_dim;
+    int y_dim = network->y_dim;
+    int len = network->express_len;
+
+    this->network = network;
+    this->sim = network->sim;
+    this->id = id;
+    x = id % x_dim;
+    y = id / x_dim;
+
+    for (int port = 0; port < NUM_ROUTER_PORTS; port++)
+    {
+        neighbor[port] = -1;
+        in_rr[port] = 0;
+        out_rr[port] = 0;
+    }
+
+    if (network->torus)
+    {
+        neighbor[PORT_EAST] = y * x_dim + (x + 1) % x_dim;
+        neighbor[PORT_WEST] = y * x_dim + (x + x_dim - 1) % x_dim;
+        neighbor[PORT_SOUTH] = ((y + 1) % y_dim) * x_dim + x;
+        neighbor[PORT_NORTH] = ((y + y_dim - 1) % y_dim) * x_dim + x;
+    }
+    else
+    {
+        if (x + 1 < x_dim)  neighbor[PORT_EAST] = id + 1;
+        if (x > 0)          neighbor[PORT_WEST] = id - 1;
+        if (y + 1 < y_dim)  neighbor[PORT_SOUTH] = id + x_dim;
+        if (y > 0)          neighbor[PORT_NORTH] = id - x_dim;
+
+        if (len)
+        {
+            if (x + len < x_dim)  neighbor[PORT_EXPRESS_EAST] = id + len;
+            if (x - len >= 0)     neighbor[PORT_EXPRESS_WEST] = id - len;
+            if (y + len < y_dim)  neighbor[PORT_EXPRESS_SOUTH] = id + len * x_dim;
+            if (y - len >= 0)     neighbor[PORT_EXPRESS_NORTH] = id - len * x_dim;
+        }
+    }
+
+    idle.out_port = -1;
+    idle.out_vc = -1;
+    in.assign (NUM_ROUTER_PORTS, VECTOR<input_vc_t> (network->num_vcs, idle));
+    credits.assign (NUM_ROUTER_PORTS, VECTOR<int> (network->num_vcs, network->buffer_depth));
+    out_vc_busy.assign (NUM_ROUTER_PORTS, VECTOR<bool> (network->num_vcs, false));
+
+    inject_vc = -1;
+    inject_flits = 0;
+    buffered_flits = 0;
+}
+
+/** Flits only point at their packet, so each packet is freed at its tail,
+ *  or in the inject queue if none of it went out yet.  */
+Router::~Router ()
+{
+    LIST<packet_t*>::iterator it;
+
+    for (int port = 0; port < NUM_ROUTER_PORTS; port++)
+        for (unsigned int vc = 0; vc < in[port].size (); vc++)
+            for (unsigned int i = 0; i < in[port][vc].buffer.size (); i++)
+                if (in[port][vc].buffer[i].tail)
+                {
+                    delete in[port][vc].buffer[i].packet->msg;
+                    delete in[port][vc].buffer[i].packet;
+                }
+
+    for (it = inject_queue.begin (); it != inject_queue.end (); it++)
+        if (it != inject_queue.begin () || inject_flits == 0)
+        {
+            delete (*it)->msg;
+            delete *it;
+        }
+}
+
+/** A torus hop over the wrap link of its ring.  */
+bool Router::crosses_dateline (int port)
+{
+    switch (port) {
+    case PORT_EAST:  return x == network->x_dim - 1;
+    case PORT_WEST:  return x == 0;
+    case PORT_SOUTH: return y == network->y_dim - 1;
+    case PORT_NORTH: return y == 0;
+    default:         return false;
+    }
+}
+
+/** Route the head of ivc and name the output VCs it may use.  On a torus
+ *  the lower half of the VCs is for packets that have not yet crossed the
+ *  dateline of the ring they are on, the upper half for those that have,
+ *  which breaks the cyclic dependency around each ring.  */
+void Router::route (input_vc_t *ivc, int *vc_lo, int *vc_hi)
+{
+    packet_t *packet = ivc->buffer.front ().packet;
+    bool crossed;
+
+    ivc->out_port = route_port (network, id, packet->dest_router);
+    *vc_lo = 0;
+    *vc_hi = network->num_vcs;
+
+    if (!network->torus || ivc->out_port == PORT_LOCAL)
+        return;
+
+    if (ivc->out_port == PORT_EAST || ivc->out_port == PORT_WEST)
+        crossed = packet->crossed_x;
+    else
+        crossed = packet->crossed_y;
+
+    if (crossed || crosses_dateline (ivc->out_port))
+        *vc_lo = network->num_vcs / 2;
+    else
+        *vc_hi = network->num_vcs / 2;
+}
+
+/** Feed the front queued packet into a free local input VC, a flit a cycle.  */
+void Router::inject (void)
+{
+    packet_t *packet;
+    input_vc_t *ivc;
+    flit_t flit;
+
+    if (inject_queue.empty ())
+        return;
+    packet = inject_queue.front ();
+
+    if (inject_flits == 0)
+    {
+        inject_vc = -1;
+        for (int vc = 0; vc < network->num_vcs; vc++)
+            if (in[PORT_LOCAL][vc].buffer.empty ())
+            {
+                inject_vc = vc;
+                break;
+            }
+        if (inject_vc < 0)
+            return;
+    }
+
+    ivc = &in[PORT_LOCAL][inject_vc];
+    if ((int)ivc->buffer.size () >= network->buffer_depth)
+        return;
+
+    flit.packet = packet;
+    flit.head = (inject_flits == 0);
+    flit.tail = (inject_flits == packet->num_flits - 1);
+    flit.ready = Global_Clock + network->stages;
+    ivc->buffer.push_back (flit);
+    buffered_flits++;
+
+    if (++inject_flits == packet->num_flits)
+    {
+        inject_queue.pop_front ();
+        inject_flits = 0;
+    }
+}
+
+void Router::tick (void)
+{
+    int offer[NUM_ROUTER_PORTS];
+    int num_vcs = network->num_vcs;
+
+    inject ();
+
+    /** Each input port offers its next VC, round robin, whose front flit is
+     *  out of the pipeline, has an output VC, and a credit to use it.  */
+    for (int port = 0; port < NUM_ROUTER_PORTS; port++)
+    {
+        offer[port] = -1;
+
+        for (int i = 0; i < num_vcs; i++)
+        {
+            int vc = (in_rr[port] + i) % num_vcs;
+            input_vc_t *ivc = &in[port][vc];
+
+            if (ivc->buffer.empty () || ivc->buffer.front ().ready > Global_Clock)
+                continue;
+
+            if (ivc->out_vc < 0)
+            {
+                int lo, hi;
+
+                assert (ivc->buffer.front ().head);
+                route (ivc, &lo, &hi);
+                for (int out_vc = lo; out_vc < hi; out_vc++)
+                    if (!out_vc_busy[ivc->out_port][out_vc])
+                    {
+                        out_vc_busy[ivc->out_port][out_vc] = true;
+                        ivc->out_vc = out_vc;
+                        break;
+                    }
+                if (ivc->out_vc < 0)
+                    continue;
+            }
+
+            if (ivc->out_port != PORT_LOCAL && credits[ivc->out_port][ivc->out_vc] == 0)
+                continue;
+
+            offer[port] = vc;
+            break;
+        }
+    }
+
+    /** Each output port takes one of the inputs that want it, round robin.  */
+    for (int out_port = 0; out_port < NUM_ROUTER_PORTS; out_port++)
+    {
+        for (int i = 0; i < NUM_ROUTER_PORTS; i++)
+        {
+            int port = (out_rr[out_port] + i) % NUM_ROUTER_PORTS;
+            input_vc_t *ivc;
+            flit_t flit;
+
+            if (offer[port] < 0 || in[port][offer[port]].out_port != out_port)
+                continue;
+
+            ivc = &in[port][offer[port]];
+            flit = ivc->buffer.front ();
+            ivc->buffer.pop_front ();
+            buffered_flits--;
+
+            if (port != PORT_LOCAL)
+                network->return_credit (neighbor[port], opposite_port (port), offer[port]);
+
+            if (out_port == PORT_LOCAL)
+            {
+                if (flit.tail)
+                    network->eject (flit.packet);
+            }
+            else
+            {
+                Router *next = network->routers[neighbor[out_port]];
+
+                if (flit.head)
+                {
+                    flit.packet->hops++;
+                    if (network->torus && crosses_dateline (out_port))
+                    {
+                        if (out_port == PORT_EAST || out_port == PORT_WEST)
+                            flit.packet->crossed_x = true;
+                        else
+                            flit.packet->crossed_y = true;
+                    }
+                }
+
+                credits[out_port][ivc->out_vc]--;
+                flit.ready = Global_Clock + network->stages;
+                next->in[opposite_port (out_port)][ivc->out_vc].buffer.push_back (flit);
+                next->buffered_flits++;
+            }
+
+            /** The packet has left, free its output VC for the next one.  */
+            if (flit.tail)
+            {
+                out_vc_busy[out_port][ivc->out_vc] = false;
+                ivc->out_port = -1;
+                ivc->out_vc = -1;
+            }
+
+            in_rr[port] = (offer[port] + 1) % num_vcs;
+            out_rr[out_port] = (port + 1) % NUM_ROUTER_PORTS;
+            break;
+        }
+    }
+}
+
+/*************************
+ * Network.
+ *************************/
+Network::Network (Simulator *sim, int total_nodes)
+{
+    this->sim = sim;
+    x_dim = sim->settings.network_x_dimension;
+    y_dim = sim->settings.network_y_dimension;
+    this->total_nodes = total_nodes;
+    num_vcs = sim->settings.num_virtual_channels;
+    buffer_depth = sim->settings.buffer_entries_per_vc;
+    stages = sim->settings.net_router_stages;
+    torus = (sim->settings.network_topology == TORUS);
+    express_len = (sim->settings.network_topology == EXPRESS_MESH) ? sim->settings.express_link_len : 0;
+
+    if (x_dim <= 0 || y_dim <= 0 || sim->settings.num_nodes > x_dim * y_dim)
+        fatal_error ("Network: %d cores do not fit a %dx%d mesh\n",
+                     sim->settings.num_nodes, x_dim, y_dim);
+
+    if (sim->settings.network_topology != MESH && sim->settings.network_topology != TORUS &&
+        sim->settings.network_topology != EXPRESS_MESH)
+        fatal_error ("Network: unknown topology %d\n", sim->settings.network_topology);
+
+    if (sim->settings.network_topology == EXPRESS_MESH && express_len < 2)
+        fatal_error ("Network: express links must skip at least 2 routers\n");
+
+    if (num_vcs < (torus ? 2 : 1) || buffer_depth < 1 || stages < 1)
+        fatal_error ("Network: need %d+ VCs, 1+ buffer entries and 1+ router stages\n",
+                     torus ? 2 : 1);
+
+    for (int i = 0; i < sim->settings.num_mem_ctrls; i++)
+        if (sim->settings.mem_ctrl_array[i] < 0 || sim->settings.mem_ctrl_array[i] >= x_dim * y_dim)
+            fatal_error ("Network: memory controller %d placed off the mesh at %d\n",
+                         i, sim->settings.mem_ctrl_array[i]);
+
+    for (int i = 0; i < x_dim * y_dim; i++)
+        routers.push_back (new Router (this, i));
+    busy_routers = 0;
+
+    send_seq.assign (total_nodes * total_nodes, 0);
+    deliver_seq.assign (total_nodes * total_nodes, 0);
+    last_arrival.assign (total_nodes * total_nodes, 0);
+
+    packets = 0;
+    flits = 0;
+    hops = 0;
+    latency = 0;
+}
+
+Network::~Network ()
+{
+    MAP<pair<int, uint32_t>, packet_t*>::iterator it;
+
+    for (unsigned int i = 0; i < routers.size (); i++)
+        delete routers[i];
+
+    for (it = held.begin (); it != held.end (); it++)
+    {
+        delete it->second->msg;
+        delete it->second;
+    }
+}
+
+int Network::router_of (int nodeID)
+{
+    if (nodeID < sim->settings.num_nodes)
+        return nodeID;
+    return sim->settings.mem_ctrl_array[nodeID - sim->settings.num_nodes];
+}
+
+/** A control message is its header alone, DATA and dirty PUTs carry the
+ *  line too.  */
+int Network::packet_flits (const Mreq *msg)
+{
+    if (msg->msg == DATA || msg->msg == PUTM || msg->msg == PUTO)
+        return MAX_FLITS_PER_PACKET (sim->settings.cache_line_size);
+
+    return (PACKET_OVERHEAD + LINK_FLIT_WIDTH - 1) / LINK_FLIT_WIDTH;
+}
+
+int Network::zero_load_hops (int src_router, int dest_router)
+{
+    int router = src_router;
+    int port;
+    int count = 0;
+
+    while ((port = route_port (this, router, dest_router)) != PORT_LOCAL)
+    {
+        router = routers[router]->neighbor[port];
+        count++;
+    }
+
+    return count;
+}
+
+/** A forwarded message leaves from the forwarder, not from its src.  */
+void Network::send (Mreq *msg)
+{
+    packet_t *packet;
+    Router *router;
+
+    packet = new packet_t;
+    packet->msg = msg;
+    packet->src = (msg->fwd_mid.nodeID >= 0) ? msg->fwd_mid.nodeID : msg->src_mid.nodeID;
+    packet->dest = msg->dest_mid.nodeID;
+    assert (packet->src >= 0 && packet->src < total_nodes);
+    assert (packet->dest >= 0 && packet->dest < total_nodes);
+    packet->dest_router = router_of (packet->dest);
+    packet->num_flits = packet_flits (msg);
+    packet->seq = send_seq[packet->src * total_nodes + packet->dest]++;
+    packet->send_time = Global_Clock;
+    packet->hops = 0;
+    packet->crossed_x = false;
+    packet->crossed_y = false;
+
+    packets++;
+    flits += packet->num_flits;
+
+    /** No contention: every hop costs the router pipeline, then the tail
+     *  follows the head out one flit a cycle.  */
+    if (sim->settings.net_infinite_bw)
+    {
+        timestamp_t *last = &last_arrival[packet->src * total_nodes + packet->dest];
+        timestamp_t arrival;
+
+        packet->hops = zero_load_hops (router_of (packet->src), packet->dest_router);
+        arrival = Global_Clock + (packet->hops + 1) * stages + packet->num_flits - 1;
+        arrival = max (arrival, *last);
+        *last = arrival;
+
+        hops += packet->hops;
+        latency += arrival - Global_Clock;
+        sim->get_NI (packet->dest)->deliver (arrival, msg);
+        delete packet;
+        return;
+    }
+
+    router = routers[router_of (packet->src)];
+    if (router->inject_queue.empty () && router->buffered_flits == 0)
+        busy_routers++;
+    router->inject_queue.push_back (packet);
+}
+
+/** The tail reached its router.  Messages from one source to one
+ *  destination can pass each other on different VCs, so one that arrives
+ *  early waits for those sent before it.  */
+void Network::eject (packet_t *packet)
+{
+    int pair_index = packet->src * total_nodes + packet->dest;
+    MAP<pair<int, uint32_t>, packet_t*>::iterator it;
+
+    if (packet->seq != deliver_seq[pair_index])
+    {
+        held[pair<int, uint32_t> (pair_index, packet->seq)] = packet;
+        return;
+    }
+
+    deliver (packet);
+    deliver_seq[pair_index]++;
+
+    while ((it = held.find (pair<int, uint32_t> (pair_index, deliver_seq[pair_index]))) != held.end ())
+    {
+        deliver (it->second);
+        held.erase (it);
+        deliver_seq[pair_index]++;
+    }
+}
+
+void Network::deliver (packet_t *packet)
+{
+    hops += packet->hops;
+    latency += Global_Clock - packet->send_time;
+    sim->get_NI (packet->dest)->deliver (Global_Clock, packet->msg);
+    delete packet;
+}
+
+/** The upstream router gets its credit back next cycle.  */
+void Network::return_credit (int router, int port, int vc)
+{
+    credit_t credit = {Global_Clock + 1, router, port, vc};
+
+    pending_credits.push_back (credit);
+}
+
+void Network::tick (void)
+{
+    while (!pending_credits.empty () && pending_credits.front ().time <= Global_Clock)
+    {
+        credit_t *credit = &pending_credits.front ();
+
+        routers[credit->router]->credits[credit->port][credit->vc]++;
+        pending_credits.pop_front ();
+    }
+
+    if (!busy_routers)
+        return;
+
+    for (unsigned int i = 0; i < routers.size (); i++)
+        if (routers[i]->buffered_flits || !routers[i]->inject_queue.empty ())
+            routers[i]->tick ();
+
+    /** Count once every router has moved, flits may have landed anywhere.  */
+    busy_routers = 0;
+    for (unsigned int i = 0; i < routers.size (); i++)
+        if (routers[i]->buffered_flits || !routers[i]->inject_queue.empty ())
+            busy_routers++;
+}
+
+/** Flits in flight move every cycle.  */
+timestamp_t Network::next_event (void)
+{
+    if (busy_routers || !pending_credits.empty ())
+        return Global_Clock;
+
+    return NEVER;
+}
+
+void Network::print_stats (void)
+{
+    sim->log->text (stderr, "Net Packets:      %8lld packets\n", (long long)packets);
+    sim->log->text (stderr, "Net Flits:        %8lld flits\n", (long long)flits);
+    if (packets)
+    {
+        sim->log->text (stderr, "Net Avg Hops:     %8.2f hops\n", (double)hops / packets);
+        sim->log->text (stderr, "Net Avg Latency:  %8.2f cycles\n", (double)latency / packets);
+    }
+}
+
+/*************************
+ * Network interface.
+ *************************/
+Network_interface::Network_interface (Simulator *sim, ModuleID moduleID)
+    : Module (sim, moduleID, "NI")
+{
+}
+
+Network_interface::~Network_interface ()
+{
+    MAP<module_t, IO_PORT>::iterator port;
+    MAP<module_t, Mreq*>::iterator it;
+    IO_PORT::iterator msg;
+
+    for (port = inbox.begin (); port != inbox.end (); port++)
+        for (msg = port->second.begin (); msg != port->second.end (); msg++)
+            delete msg->second;
+
+    for (it = delivered.begin (); it != delivered.end (); it++)
+        delete it->second;
+}
+
+void Network_interface::deliver (timestamp_t time, Mreq *msg)
+{
+    inbox[msg->dest_mid.module_index].insert (pair<timestamp_t, Mreq*> (time, msg));
+}
+
+/** The oldest message for module_index that has arrived, or NULL.  One per
+ *  call: a module takes at most one message a cycle.  */
+const Mreq *Network_interface::receive (module_t module_index)
+{
+    IO_PORT *port = &inbox[module_index];
+    Mreq **last = &delivered[module_index];
+
+    delete *last;
+    *last = NULL;
+
+    if (port->empty () || port->begin ()->first > Global_Clock)
+        return NULL;
+
+    *last = port->begin ()->second;
+    port->erase (port->begin ());
+    return *last;
+}
+
+void Network_interface::tick (void)
+{
+    fatal_error ("%s - tick should never be called!", name);
+}
+
+void Network_interface::tock (void)
+{
+    fatal_error ("%s - tock should never be called!", name);
+}
+
+/** The modules on this node have work once a message for them arrives.  */
+timestamp_t Network_interface::next_event (void)
+{
+    timestamp_t next = NEVER;
+    MAP<module_t, IO_PORT>::iterator port;
+
+    for (port = inbox.begin (); port != inbox.end (); port++)
+        if (!port->second.empty ())
+            next = min (next, port->second.begin ()->first);
+
+    if (next == NEVER)
+        return NEVER;
+
+    return max (next, (timestamp_t)Global_Clock);
+}
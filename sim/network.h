@@ -0,0 +1,185 @@
+#ifndef NETWORK_H_
+#define NETWORK_H_
+
+#include "module.h"
+#include "mreq.h"
+#include "settings.h"
+#include "types.h"
+
+/** Router ports.  A router's port p faces the neighbour on side p, both
+ *  for the link into the router and the link out of it.  */
+typedef enum {
+    PORT_LOCAL = 0,
+    PORT_EAST,
+    PORT_WEST,
+    PORT_NORTH,
+    PORT_SOUTH,
+    PORT_EXPRESS_EAST,
+    PORT_EXPRESS_WEST,
+    PORT_EXPRESS_NORTH,
+    PORT_EXPRESS_SOUTH,
+    NUM_ROUTER_PORTS
+} router_port_t;
+
+class Network;
+
+/** A coherence message on its way through the network.  */
+typedef struct {
+    Mreq *msg;
+    int src;                 /** Nodes.  */
+    int dest;
+    int dest_router;
+    int num_flits;
+    uint32_t seq;            /** Per src/dest pair, to keep delivery in order.  */
+    timestamp_t send_time;
+    int hops;
+    bool crossed_x;          /** Torus: past the dateline in this dimension.  */
+    bool crossed_y;
+} packet_t;
+
+typedef struct {
+    packet_t *packet;
+    bool head;
+    bool tail;
+    timestamp_t ready;       /** Out of the router pipeline, may compete for the switch.  */
+} flit_t;
+
+/** Input virtual channel.  Holds flits of one packet after another, the
+ *  route and output VC belong to the packet at the front.  */
+typedef struct {
+    DEQUE<flit_t> buffer;
+    int out_port;            /** -1 until the head is routed.  */
+    int out_vc;              /** -1 until an output VC is allocated.  */
+} input_vc_t;
+
+/** A credit on its way back to the upstream router.  */
+typedef struct {
+    timestamp_t time;
+    int router;
+    int port;
+    int vc;
+} credit_t;
+
+/**
+ * Input queued virtual channel router.
+ *
+ * A flit written into an input VC spends net_router_stages cycles in the
+ * pipeline (route compute, VC allocation, switch allocation, traversal)
+ * before it can cross the switch.  Heads are routed dimension order, X then
+ * Y, and take a free output VC of the right class.  Each cycle every input
+ * port offers one VC and every output port grants one input, round robin.
+ * A flit only leaves if the downstream VC has a credit, and the credit
+ * comes back a cycle after the flit moves on from there.
+ */
+class Router {
+public:
+    Router (Network *network, int id);
+    ~Router ();
+
+    Network *network;
+    Simulator *sim;
+    int id;
+    int x;
+    int y;
+
+    /** Router on the far side of each port, -1 if unconnected.  */
+    int neighbor[NUM_ROUTER_PORTS];
+
+    VECTOR< VECTOR<input_vc_t> > in;
+    VECTOR< VECTOR<int> > credits;
+    VECTOR< VECTOR<bool> > out_vc_busy;
+    int in_rr[NUM_ROUTER_PORTS];
+    int out_rr[NUM_ROUTER_PORTS];
+
+    /** Packets from the nodes on this router, waiting to be injected.  */
+    LIST<packet_t*> inject_queue;
+    int inject_vc;
+    int inject_flits;        /** Flits of the front packet already injected.  */
+
+    int buffered_flits;
+
+    void route (input_vc_t *ivc, int *vc_lo, int *vc_hi);
+    bool crosses_dateline (int port);
+    void inject (void);
+    void tick (void);
+};
+
+/**
+ * On-chip network for directory mode.
+ *
+ * One router per mesh position, network_x_dimension x network_y_dimension.
+ * Core n sits on router n, memory controller i shares router
+ * mem_ctrl_array[i].  network_topology picks a mesh, a torus (wrap links,
+ * two dateline VC classes) or a mesh with express links that skip
+ * express_link_len routers.  Messages become packets of LINK_FLIT_WIDTH
+ * flits.  With net_infinite_bw the routers are skipped and every packet
+ * takes its zero-load latency.  Messages between any two nodes are
+ * delivered in the order they were sent.
+ */
+class Network {
+public:
+    Network (Simulator *sim, int total_nodes);
+    ~Network ();
+
+    Simulator *sim;
+    int x_dim;
+    int y_dim;
+    int total_nodes;
+    int num_vcs;
+    int buffer_depth;
+    int stages;
+    bool torus;
+    int express_len;         /** 0 without express links.  */
+
+    VECTOR<Router*> routers;
+    DEQUE<credit_t> pending_credits;
+    int busy_routers;        /** Routers with flits buffered or queued.  */
+
+    /** Next sequence number to send / deliver, src * total_nodes + dest.  */
+    VECTOR<uint32_t> send_seq;
+    VECTOR<uint32_t> deliver_seq;
+    /** Packets that arrived ahead of an earlier one from the same source.  */
+    MAP<pair<int, uint32_t>, packet_t*> held;
+    /** net_infinite_bw: latest arrival per src/dest pair.  */
+    VECTOR<timestamp_t> last_arrival;
+
+    counter_t packets;
+    counter_t flits;
+    counter_t hops;
+    counter_t latency;
+
+    int router_of (int nodeID);
+    int packet_flits (const Mreq *msg);
+    int zero_load_hops (int src_router, int dest_router);
+    void send (Mreq *msg);
+    void eject (packet_t *packet);
+    void deliver (packet_t *packet);
+    void return_credit (int router, int port, int vc);
+
+    void tick (void);
+    timestamp_t next_event (void);
+    void print_stats (void);
+};
+
+/**
+ * Where a node meets the network.  Arriving messages wait here, sorted by
+ * arrival time, until the module they are for reads its input port.
+ */
+class Network_interface : public Module {
+public:
+    Network_interface (Simulator *sim, ModuleID moduleID);
+    ~Network_interface ();
+
+    MAP<module_t, IO_PORT> inbox;
+    /** Message each module read last, freed on its next read.  */
+    MAP<module_t, Mreq*> delivered;
+
+    void deliver (timestamp_t time, Mreq *msg);
+    const Mreq *receive (module_t module_index);
+
+    void tick (void);
+    void tock (void);
+    timestamp_t next_event (void);
+};
+
+#endif // NETWORK_H_
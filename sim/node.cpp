@@ -1,46 +1,67 @@
 #include "node.h"
+#include "directory.h"
+#include "event_log.h"
 #include "processor.h"
 #include "hash_table.h"
 #include "memory.h"
+#include "network.h"
 #include "sim.h"
 
-extern Sim_settings settings;
-extern Simulator *Sim;
-
-Node::Node (int nodeID)
+Node::Node (Simulator *sim, int nodeID)
 {
+    this->sim = sim;
     this->nodeID = nodeID;
     mod[L1_M] = NULL;
     mod[PR_M] = NULL;
     mod[MC_M] = NULL;
+    mod[NI_M] = NULL;
+    mod[DIR_M] = NULL;
+    staged_shared = false;
 }
 
 Node::~Node ()
 {
     map<module_t, Module*>::iterator it;
+    LIST<Mreq*>::iterator msg;
+
+    for (msg = staged_msgs.begin (); msg != staged_msgs.end (); msg++)
+        delete *msg;
     for (it = mod.begin (); it != mod.end (); it++)
         delete (it->second);
     mod.clear ();
 }
 
-void Node::build_processor (char *trace_file)
+void Node::build_processor (Trace_reader *trace)
 {
     Hash_table *cache;
 
-    mod[L1_M] = cache = new Hash_table ((ModuleID){nodeID, L1_M}, "L1", 
-                                        settings.l1_cache_size,
-                                        settings.l1_cache_assoc,
-                                        settings.cache_line_size,
-                                        settings.l1_mshrs,
-                                        settings.l1_hit_time,
-                                        settings.protocol);
+    mod[L1_M] = cache = new Hash_table (sim, (ModuleID){nodeID, L1_M}, "L1", 
+                                        sim->settings.l1_cache_size,
+                                        sim->settings.l1_cache_assoc,
+                                        sim->settings.cache_line_size,
+                                        sim->settings.l1_mshrs,
+                                        sim->settings.l1_wb_entries,
+                                        sim->settings.l1_hit_time,
+                                        sim->settings.protocol,
+                                        sim->settings.l1_infinite,
+                                        sim->settings.l1_replacement_policy);
 
-    mod[PR_M] = new Processor ((ModuleID){nodeID, PR_M}, cache, trace_file);
+    mod[PR_M] = new Processor (sim, (ModuleID){nodeID, PR_M}, cache, trace);
 }
 
 void Node::build_memory_controller (void)
 {
-	mod[MC_M] = new Memory_controller ((ModuleID){nodeID, MC_M}, 100);
+	mod[MC_M] = new Memory_controller (sim, (ModuleID){nodeID, MC_M}, sim->settings.mem_hit_time);
+}
+
+void Node::build_network_interface (void)
+{
+	mod[NI_M] = new Network_interface (sim, (ModuleID){nodeID, NI_M});
+}
+
+void Node::build_directory (void)
+{
+	mod[DIR_M] = new Directory (sim, (ModuleID){nodeID, DIR_M}, DIR_LATENCY);
 }
 
 void Node::tick_cache (void)
@@ -55,6 +76,12 @@ void Node::tick_pr (void)
 		mod[PR_M]->tick ();
 }
 
+void Node::tick_dir (void)
+{
+	if (mod[DIR_M])
+		mod[DIR_M]->tick ();
+}
+
 void Node::tick_mc (void)
 {
 	if (mod[MC_M])
@@ -66,3 +93,34 @@ void Node::tock_pr (void)
 	if (mod[PR_M])
 		mod[PR_M]->tock ();
 }
+
+void Node::commit_stage (void)
+{
+	if (!staged_log.empty ())
+	{
+		sim->log->append (&staged_log[0], staged_log.size ());
+		staged_log.clear ();
+	}
+
+	if (staged_shared)
+		sim->bus->shared_line = true;
+	staged_shared = false;
+
+	while (!staged_msgs.empty ())
+	{
+		post_message (sim, staged_msgs.front ());
+		staged_msgs.pop_front ();
+	}
+}
+
+timestamp_t Node::next_event (void)
+{
+	timestamp_t next = NEVER;
+	map<module_t, Module*>::iterator it;
+
+	for (it = mod.begin (); it != mod.end (); it++)
+		if (it->second)
+			next = min (next, it->second->next_event ());
+
+	return next;
+}
@@ -8,25 +8,39 @@ using namespace std;
 
 class Network_interface;
 class Predictor;
+class Trace_reader;
 
 class Node
 {
 public:
+    Simulator *sim;
     int nodeID;
     map<module_t, Module*> mod;
 
-    Node (int nodeID);
+    Node (Simulator *sim, int nodeID);
     ~Node ();
 
     Predictor *predictor;
 
-    void build_processor (char *trace_file);
+    /** Parallel phases: messages sent, the bus shared line and events
+     *  logged by this node, applied in node order by commit_stage.  */
+    LIST<Mreq*> staged_msgs;
+    bool staged_shared;
+    VECTOR<char> staged_log;
+
+    void build_processor (Trace_reader *trace);
     void build_memory_controller (void);
+    void build_network_interface (void);
+    void build_directory (void);
     
     void tick_cache (void);
     void tick_pr (void);
+    void tick_dir (void);
     void tick_mc (void);
     void tock_pr (void);
+    void commit_stage (void);
+
+    timestamp_t next_event (void);
 };
 
 #endif /* NODE_H_ */
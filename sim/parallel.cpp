@@ -0,0 +1,115 @@
+#include "event_log.h"
+#include "node.h"
+#include "parallel.h"
+#include "sim.h"
+
+__thread int sim_thread_id = 0;
+
+counter_t Sim_counter::total (void) const
+{
+    counter_t sum = 0;
+
+    for (int i = 0; i < SIM_MAX_THREADS; i++)
+        sum += slot[i].count;
+    return sum;
+}
+
+Tick_pool::Tick_pool (Simulator *sim, int num_threads, int num_cores)
+{
+    this->sim = sim;
+    if (num_threads > SIM_MAX_THREADS)
+        fatal_error ("Sim error: at most %d sim_threads\n", SIM_MAX_THREADS);
+    if (num_threads > num_cores)
+        num_threads = num_cores;
+
+    this->num_threads = num_threads;
+    phase = PHASE_EXIT;
+    generation = 0;
+    done = 0;
+
+    for (int t = 0; t <= num_threads; t++)
+        first.push_back ((int)((long long)num_cores * t / num_threads));
+
+    args.resize (num_threads);
+    workers.resize (num_threads);
+    for (int t = 1; t < num_threads; t++)
+    {
+        args[t].pool = this;
+        args[t].thread = t;
+        if (pthread_create (&workers[t], NULL, worker, &args[t]))
+            fatal_error ("Sim error: unable to start worker thread %d\n", t);
+    }
+}
+
+Tick_pool::~Tick_pool ()
+{
+    phase = PHASE_EXIT;
+    __atomic_add_fetch (&generation, 1, __ATOMIC_RELEASE);
+
+    for (int t = 1; t < num_threads; t++)
+        pthread_join (workers[t], NULL);
+}
+
+/** Run one phase over every core, then apply what the nodes staged.  */
+void Tick_pool::run (sim_phase_t phase)
+{
+    int spins = 0;
+
+    this->phase = phase;
+    done = 0;
+    sim->parallel_phase = true;
+    __atomic_add_fetch (&generation, 1, __ATOMIC_RELEASE);
+
+    tick_block (0);
+
+    while (__atomic_load_n (&done, __ATOMIC_ACQUIRE) < num_threads - 1)
+        spin_wait (&spins);
+    sim->parallel_phase = false;
+
+    for (int i = first[0]; i < first[num_threads]; i++)
+        sim->Nd[i]->commit_stage ();
+}
+
+void Tick_pool::tick_block (int thread)
+{
+    for (int i = first[thread]; i < first[thread + 1]; i++)
+    {
+        Node *node = sim->Nd[i];
+
+        Event_log::stage = &node->staged_log;
+        switch (phase) {
+        case PHASE_TICK_CACHE: node->tick_cache (); break;
+        case PHASE_TICK_PR:    node->tick_pr ();    break;
+        case PHASE_TICK_DIR:   node->tick_dir ();   break;
+        case PHASE_TOCK_PR:    node->tock_pr ();    break;
+        default:
+            fatal_error ("Sim error: bad phase %d\n", phase);
+        }
+    }
+    Event_log::stage = NULL;
+}
+
+void *Tick_pool::worker (void *arg)
+{
+    tick_worker_t *self = (tick_worker_t *)arg;
+    Tick_pool *pool = self->pool;
+    unsigned int seen = 0;
+
+    sim_thread_id = self->thread;
+    Event_log::current = pool->sim->log;
+
+    while (1)
+    {
+        int spins = 0;
+
+        while (__atomic_load_n (&pool->generation, __ATOMIC_ACQUIRE) == seen)
+            spin_wait (&spins);
+        seen++;
+
+        if (pool->phase == PHASE_EXIT)
+            return NULL;
+
+        pool->tick_block (self->thread);
+        __atomic_add_fetch (&pool->done, 1, __ATOMIC_RELEASE);
+    }
+}
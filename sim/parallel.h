@@ -0,0 +1,101 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "types.h"
+
+/** Most worker threads a run may use, main thread included.  */
+#define SIM_MAX_THREADS      256
+
+/** Index of the calling thread, 0 for the main thread.  */
+extern __thread int sim_thread_id;
+
+/** Busy wait this many rounds before giving the CPU away.  */
+#define SPIN_LIMIT           4096
+
+static inline void spin_wait (int *spins)
+{
+    if (++*spins < SPIN_LIMIT)
+    {
+#if defined (__x86_64__) || defined (__i386__)
+        __builtin_ia32_pause ();
+#endif
+    }
+    else
+        sched_yield ();
+}
+
+/** Per-node phases of a cycle that may run on worker threads.  */
+typedef enum {
+    PHASE_TICK_CACHE = 0,
+    PHASE_TICK_PR,
+    PHASE_TICK_DIR,
+    PHASE_TOCK_PR,
+    PHASE_EXIT
+} sim_phase_t;
+
+/**
+ * Statistic bumped from inside the per-node phases.  Each thread counts in
+ * a slot of its own cache line so the workers never share a line, the total
+ * is only read once the run is over.
+ */
+class Sim_counter {
+public:
+    Sim_counter () { clear (); }
+
+    struct {
+        counter_t count;
+        char pad[64 - sizeof (counter_t)];
+    } slot[SIM_MAX_THREADS];
+
+    void operator++ (int) { slot[sim_thread_id].count++; }
+    void clear (void) { for (int i = 0; i < SIM_MAX_THREADS; i++) slot[i].count = 0; }
+    counter_t total (void) const;
+};
+
+class Tick_pool;
+
+typedef struct {
+    Tick_pool *pool;
+    int thread;
+} tick_worker_t;
+
+/**
+ * Runs the per-node phases of a cycle on sim_threads threads.
+ *
+ * The cores are split into one contiguous block per thread and the main
+ * thread works on block 0.  A phase starts when the main thread bumps the
+ * generation the workers spin on, and ends once every worker has checked
+ * in on the done count, so the workers never wait on each other.  Spinning
+ * backs off to sched_yield, which keeps an oversubscribed host usable.
+ *
+ * Inside a phase a node only touches its own modules.  Whatever it sends,
+ * logs or raises on the bus is staged on the node and committed in node
+ * order once the phase is over, so a run gives exactly the output of a
+ * single threaded run.
+ */
+class Tick_pool {
+public:
+    Tick_pool (Simulator *sim, int num_threads, int num_cores);
+    ~Tick_pool ();
+
+    Simulator *sim;
+    int num_threads;
+    VECTOR<pthread_t> workers;
+    VECTOR<tick_worker_t> args;
+
+    /** Cores [first[t], first[t + 1]) belong to thread t.  */
+    VECTOR<int> first;
+
+    sim_phase_t phase;
+    unsigned int generation;
+    int done;
+
+    void run (sim_phase_t phase);
+    void tick_block (int thread);
+    static void *worker (void *arg);
+};
+
+#endif // PARALLEL_H_
@@ -0,0 +1,146 @@
+#include "event_log.h"
+#include "parallel.h"
+#include "prefetch.h"
+#include "sim.h"
+
+Trace_ring::Trace_ring (int entries)
+{
+    buf = new trace_ref_t[entries];
+    mask = entries - 1;
+    head = 0;
+    tail_seen = 0;
+    tail = 0;
+    head_seen = 0;
+    finished = false;
+}
+
+Trace_ring::~Trace_ring ()
+{
+    delete [] buf;
+}
+
+bool Trace_ring::fill (Trace_reader *source)
+{
+    uint64_t t = tail;
+    uint64_t end;
+
+    if (t - head_seen > mask)
+        head_seen = __atomic_load_n (&head, __ATOMIC_ACQUIRE);
+    end = head_seen + mask + 1;
+
+    while (t < end)
+    {
+        if (!source->next (&buf[t & mask]))
+        {
+            __atomic_store_n (&tail, t, __ATOMIC_RELEASE);
+            __atomic_store_n (&finished, true, __ATOMIC_RELEASE);
+            return false;
+        }
+        t++;
+    }
+
+    __atomic_store_n (&tail, t, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool Trace_ring::pop (trace_ref_t *ref)
+{
+    if (head == tail_seen)
+    {
+        int spins = 0;
+
+        while ((tail_seen = __atomic_load_n (&tail, __ATOMIC_ACQUIRE)) == head)
+        {
+            /** tail is final once finished is up, look once more.  */
+            if (__atomic_load_n (&finished, __ATOMIC_ACQUIRE))
+            {
+                tail_seen = __atomic_load_n (&tail, __ATOMIC_ACQUIRE);
+                if (tail_seen == head)
+                    return false;
+                break;
+            }
+            spin_wait (&spins);
+        }
+    }
+
+    *ref = buf[head & mask];
+    __atomic_store_n (&head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+Prefetch_trace_reader::Prefetch_trace_reader (Trace_ring *ring)
+{
+    this->ring = ring;
+}
+
+bool Prefetch_trace_reader::next (trace_ref_t *ref)
+{
+    return ring->pop (ref);
+}
+
+Trace_prefetcher::Trace_prefetcher (Simulator *sim, const VECTOR<Trace_reader *> &sources, int entries)
+{
+    this->sim = sim;
+    if (entries < 2 || !ISPOW2 (entries))
+        fatal_error ("Trace: trace_prefetch_entries must be a power of two, not %d\n", entries);
+
+    this->sources = sources;
+    for (int node = 0; node < (int)sources.size (); node++)
+        rings.push_back (new Trace_ring (entries));
+
+    stop = false;
+    if (pthread_create (&thread, NULL, worker, this))
+        fatal_error ("Trace: unable to start the prefetch thread\n");
+}
+
+Trace_prefetcher::~Trace_prefetcher ()
+{
+    __atomic_store_n (&stop, true, __ATOMIC_RELEASE);
+    pthread_join (thread, NULL);
+
+    for (int i = 0; i < (int)rings.size (); i++)
+    {
+        delete sources[i];
+        delete rings[i];
+    }
+}
+
+Trace_reader *Trace_prefetcher::reader (int node)
+{
+    return new Prefetch_trace_reader (rings[node]);
+}
+
+void *Trace_prefetcher::worker (void *arg)
+{
+    Trace_prefetcher *self = (Trace_prefetcher *)arg;
+    int spins = 0;
+
+    Event_log::current = self->sim->log;
+
+    while (!__atomic_load_n (&self->stop, __ATOMIC_ACQUIRE))
+    {
+        bool busy = false;
+        bool live = false;
+
+        for (int i = 0; i < (int)self->rings.size (); i++)
+        {
+            Trace_ring *ring = self->rings[i];
+            uint64_t before = ring->tail;
+
+            if (ring->finished)
+                continue;
+            live = ring->fill (self->sources[i]) || live;
+            busy = busy || ring->tail != before;
+        }
+
+        if (!live)
+            break;
+
+        /** Every ring full, wait for the cores to drain some.  */
+        if (busy)
+            spins = 0;
+        else
+            spin_wait (&spins);
+    }
+    return NULL;
+}
@@ -0,0 +1,85 @@
+#ifndef PREFETCH_H_
+#define PREFETCH_H_
+
+#include <pthread.h>
+
+#include "trace.h"
+#include "types.h"
+
+class Simulator;
+
+/**
+ * Single producer, single consumer ring of decoded references.
+ *
+ * The prefetch thread is the only writer of tail and the core reading the
+ * ring the only writer of head, so neither needs a lock.  Each side keeps
+ * its own copy of the other's index and only reloads it when the ring looks
+ * full or empty, which keeps the two lines from bouncing on every
+ * reference.  finished is raised once the last reference is in.
+ */
+class Trace_ring {
+public:
+    Trace_ring (int entries);
+    ~Trace_ring ();
+
+    trace_ref_t *buf;
+    uint64_t mask;
+
+    /** Consumer side.  */
+    uint64_t head;
+    uint64_t tail_seen;
+    char pad0[64 - 2 * sizeof (uint64_t)];
+
+    /** Producer side.  */
+    uint64_t tail;
+    uint64_t head_seen;
+    bool finished;
+    char pad1[64 - 2 * sizeof (uint64_t) - sizeof (bool)];
+
+    /** Producer: move up to free entries from source, false once it runs dry.  */
+    bool fill (Trace_reader *source);
+
+    /** Consumer: next reference, waiting on the producer if need be.  */
+    bool pop (trace_ref_t *ref);
+};
+
+/** What a Processor reads when its trace is prefetched.  */
+class Prefetch_trace_reader : public Trace_reader {
+public:
+    Prefetch_trace_reader (Trace_ring *ring);
+
+    /** Owned by the Trace_prefetcher.  */
+    Trace_ring *ring;
+
+    bool next (trace_ref_t *ref);
+};
+
+/**
+ * Decodes every core's trace on a background thread.
+ *
+ * The traces are opened up front by the caller, so a missing trace is
+ * still reported before the run starts.  The thread then goes round the
+ * cores topping up each ring, and the simulation only ever pops fixed size
+ * records, with no file reads or parsing on its side.  The references a
+ * core sees are the same as reading its trace directly, so results do not
+ * change.
+ */
+class Trace_prefetcher {
+public:
+    /** Takes over sources, one per core.  */
+    Trace_prefetcher (Simulator *sim, const VECTOR<Trace_reader *> &sources, int entries);
+    ~Trace_prefetcher ();
+
+    Simulator *sim;
+    VECTOR<Trace_reader *> sources;
+    VECTOR<Trace_ring *> rings;
+
+    pthread_t thread;
+    bool stop;
+
+    Trace_reader *reader (int node);
+
+    static void *worker (void *arg);
+};
+
+#endif // PREFETCH_H_
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "event_log.h"
 #include "hash_table.h"
 #include "processor.h"
 #include "settings.h"
@@ -8,75 +9,95 @@
 
 using namespace std;
 
-extern Simulator * Sim;
-
-Processor::Processor (ModuleID moduleID, Hash_table *cache, char *trace_file)
-    : Module (moduleID, "Processor_")
+Processor::Processor (Simulator *sim, ModuleID moduleID, Hash_table *cache, Trace_reader *trace)
+    : Module (sim, moduleID, "Processor_")
 {
     this->moduleID = moduleID;
-    this->infile = fopen (trace_file, "r");
+    this->trace = trace;
     this->my_cache = cache;
     this->end_of_trace = false;
-    this->inbound_request = NULL;
-    this->inbound_request_buf = NULL;
+    this->have_next = false;
+    this->issue_time = 0;
+    this->outstanding_requests = 0;
 }
 
 Processor::~Processor ()
 {
-    fclose (this->infile);
+    delete trace;
 }
 
 /** Done once at end of trace and no outstanding requests.  */
 bool Processor::done ()
 {
-    return (end_of_trace && !outstanding_request);
+    return (end_of_trace && !outstanding_requests);
 }
 
 void Processor::tick ()
 {
-    char c;
-    paddr_t addr;
-
-    if (inbound_request)
+    while (!inbound_requests.empty ())
     {
-    	fprintf(stderr,"* COMPLETE -- PR: %d -- Clock: %lld\n",moduleID.nodeID, Global_Clock);
-    	assert (inbound_request->msg == DATA);
-    	outstanding_request = false;
-        delete inbound_request;
+    	Mreq *reply = inbound_requests.front ();
+
+    	sim->log->complete (moduleID);
+    	assert (reply->msg == DATA);
+    	outstanding_requests--;
+        delete reply;
+        inbound_requests.pop_front ();
     }
-    inbound_request = NULL;
 
-    if (end_of_trace || outstanding_request)
+    /** Keep fetching past misses until the MSHRs run out or the cache is still
+     *  holding our last reference.  */
+    if (end_of_trace || outstanding_requests >= sim->settings.mshrs_per_processor ||
+        my_cache->proc_request)
         return;
 
-    if (fscanf (infile, "%c 0x%llx\n", &c, (unsigned long long int*)&addr) == 2)
+    /** A reference's gap starts once the core is free to issue it.  */
+    if (!have_next)
     {
-        Mreq *request;
-
-        fprintf (stderr,"* FETCH -- PR: %d -- Clock: %lld -- %c 0x%llx\n", moduleID.nodeID, Global_Clock, c, (unsigned long long int)addr);
-
-        switch (c) {
-        case 'r': request = new Mreq (LOAD, addr, moduleID); break;
-        case 'w': request = new Mreq (STORE, addr, moduleID); break;
-        default:
-            fatal_error ("Processor %d: unknown operation - %c", moduleID.nodeID, c);
+        if (!trace->next (&next_ref))
+        {
+            end_of_trace = true;
+            return;
         }
-        
-        my_cache->proc_request =  request;
-        outstanding_request = true;
+        have_next = true;
+        issue_time = Global_Clock + next_ref.gap;
     }
-    else
-    {
-        end_of_trace = true;
+
+    if (Global_Clock < issue_time)
+        return;
+
+    Mreq *request;
+
+    have_next = false;
+    sim->log->fetch (moduleID, next_ref.op, next_ref.addr);
+
+    switch (next_ref.op) {
+    case 'r': request = new Mreq (sim, LOAD, next_ref.addr, moduleID); break;
+    case 'w': request = new Mreq (sim, STORE, next_ref.addr, moduleID); break;
+    default:
+        fatal_error ("Processor %d: unknown operation - %c", moduleID.nodeID, next_ref.op);
     }
+
+    my_cache->proc_request =  request;
+    outstanding_requests++;
 }
 
 void Processor::tock ()
 {
-	if (inbound_request_buf)
-	{
-		inbound_request = inbound_request_buf;
-		inbound_request_buf = NULL;
-	}
+	inbound_requests.splice (inbound_requests.end (), inbound_request_buf);
 }
 
+
+/** Busy while a reply is in flight to us or while there is a reference to
+ *  fetch, the clock may skip the gap ahead of a reference.  */
+timestamp_t Processor::next_event ()
+{
+	if (!inbound_requests.empty () || !inbound_request_buf.empty ())
+		return Global_Clock;
+
+	if (!end_of_trace && outstanding_requests < sim->settings.mshrs_per_processor &&
+	    !my_cache->proc_request)
+		return have_next ? max (issue_time, Global_Clock) : Global_Clock;
+
+	return NEVER;
+}
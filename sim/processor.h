@@ -7,6 +7,7 @@
 #include "module.h"
 #include "mreq.h"
 #include "settings.h"
+#include "trace.h"
 #include "types.h"
 
 using namespace std;
@@ -15,22 +16,31 @@ class Hash_table;
 
 class Processor : public Module {
 public:
-	Processor(ModuleID moduleID, Hash_table *cache, char *trace_file);
+	Processor(Simulator *sim, ModuleID moduleID, Hash_table *cache, Trace_reader *trace);
 	~Processor();
 
-    FILE *infile;
+    Trace_reader *trace;
     Hash_table *my_cache;
 
     bool end_of_trace;
-    bool outstanding_request;
 
-    Mreq * inbound_request;
-    Mreq * inbound_request_buf;
+    /** Reference read from the trace and waiting out its gap until issue_time.  */
+    trace_ref_t next_ref;
+    bool have_next;
+    timestamp_t issue_time;
+
+    /** References sent to the cache and not yet answered, at most mshrs_per_processor.  */
+    int outstanding_requests;
+
+    /** Replies from the cache.  Those written this cycle sit in the buffer until tock.  */
+    LIST<Mreq *> inbound_requests;
+    LIST<Mreq *> inbound_request_buf;
 
     bool done ();
 
 	void tick ();
 	void tock ();
+	timestamp_t next_event ();
 };
 
 #endif // PROCESSOR_H
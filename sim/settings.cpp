@@ -1,3 +1,5 @@
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <sys/types.h>
@@ -8,7 +10,6 @@
 #include "settings.h"
 #include "enums.h"
 
-extern Sim_settings settings;
 extern FILE * yyin;
 
 //TODO: this needs to be called to reclaim space allocated by flex, but yylex_destroy() doesn't exist
@@ -16,138 +17,181 @@ extern FILE * yyin;
 // and our macs has v.2.5.35
 //extern int yylex_destroy();
 
-extern Simulator Sim;
-
 // Possible identifiers for config file
 setts identifiers [] = {
     /** NOC.  */
-    {"network_x_dimension",     &(settings.network_x_dimension)   },
-    {"network_y_dimension",     &(settings.network_y_dimension)   },
+    {"network_x_dimension",      offsetof (Sim_settings, network_x_dimension),     SETT_INT},
+    {"network_y_dimension",      offsetof (Sim_settings, network_y_dimension),     SETT_INT},
 
     /** Neighborhoods.  */
-    {"num_nhoods",              &(settings.num_nhoods)            },
-    {"nhood_x_blocking_factor", &(settings.nhood_x_blocking_factor)},
-    {"nhood_y_blocking_factor", &(settings.nhood_y_blocking_factor)},
+    {"num_nhoods",               offsetof (Sim_settings, num_nhoods),              SETT_INT},
+    {"nhood_x_blocking_factor",  offsetof (Sim_settings, nhood_x_blocking_factor), SETT_INT},
+    {"nhood_y_blocking_factor",  offsetof (Sim_settings, nhood_y_blocking_factor), SETT_INT},
 
     /** Memory controller.  */
-    {"num_mem_ctrls",           &(settings.num_mem_ctrls)         },
-    {"mem_ctrl_array",          &(settings.mem_ctrl_array)        },
-
-	{"heartrate",               &(settings.heartrate)             },
-	{"net_infinite_bw",		   	&(settings.net_infinite_bw)       },
-	{"sharer_forwarding",	   	&(settings.sharer_forwarding)     },
-	{"wait_on_inv_acks",	   	&(settings.wait_on_inv_acks)      },
-	{"livelock_check",		   	&(settings.livelock_check)        },
-	{"processor_affinity",		&(settings.processor_affinity)    },
-    {"mem_model_enabled",       &(settings.mem_model_enabled)     },
+    {"num_mem_ctrls",            offsetof (Sim_settings, num_mem_ctrls),           SETT_INT},
+    {"mem_ctrl_array",           offsetof (Sim_settings, mem_ctrl_array),          SETT_INT_ARRAY},
+    {"mem_interleave",           offsetof (Sim_settings, mem_interleave),          SETT_INT},
+    {"mem_page_size",            offsetof (Sim_settings, mem_page_size),           SETT_INT},
+
+	{"heartrate",                offsetof (Sim_settings, heartrate),               SETT_INT},
+	{"net_infinite_bw",          offsetof (Sim_settings, net_infinite_bw),         SETT_BOOL},
+	{"sharer_forwarding",        offsetof (Sim_settings, sharer_forwarding),       SETT_BOOL},
+	{"wait_on_inv_acks",         offsetof (Sim_settings, wait_on_inv_acks),        SETT_BOOL},
+	{"livelock_check",           offsetof (Sim_settings, livelock_check),          SETT_BOOL},
+	{"processor_affinity",       offsetof (Sim_settings, processor_affinity),      SETT_BOOL},
+    {"mem_model_enabled",        offsetof (Sim_settings, mem_model_enabled),       SETT_BOOL},
+
+    /** Memory timing.  DRAM parameters only apply with mem_model_enabled.  */
+    {"mem_hit_time",             offsetof (Sim_settings, mem_hit_time),            SETT_INT},
+    {"dram_banks",               offsetof (Sim_settings, dram_banks),              SETT_INT},
+    {"dram_row_size",            offsetof (Sim_settings, dram_row_size),           SETT_INT},
+    {"dram_t_cas",               offsetof (Sim_settings, dram_t_cas),              SETT_INT},
+    {"dram_t_rcd",               offsetof (Sim_settings, dram_t_rcd),              SETT_INT},
+    {"dram_t_rp",                offsetof (Sim_settings, dram_t_rp),               SETT_INT},
+    {"dram_t_burst",             offsetof (Sim_settings, dram_t_burst),            SETT_INT},
+    {"dram_scheduler",           offsetof (Sim_settings, dram_scheduler),          SETT_INT},
 
     /** Is this a regression run?  */
-    {"regression_test",         &(settings.regression_test)       },
+    {"regression_test",          offsetof (Sim_settings, regression_test),         SETT_BOOL},
 
     /** SESC specific.  */
-	{"sesc_rabbit",			   	&(settings.sesc_rabbit)           },
-    {"sesc_nsim_per_core",      &(settings.sesc_nsim_per_core)    },
-    {"sesc_disable_llsc",       &(settings.sesc_disable_llsc)     },
-	{"warmup_time_per_core",	&(settings.warmup_time_per_core)  },
+	{"sesc_rabbit",              offsetof (Sim_settings, sesc_rabbit),             SETT_LLONG},
+    {"sesc_nsim_per_core",       offsetof (Sim_settings, sesc_nsim_per_core),      SETT_LLONG},
+    {"sesc_disable_llsc",        offsetof (Sim_settings, sesc_disable_llsc),       SETT_BOOL},
+	{"warmup_time_per_core",     offsetof (Sim_settings, warmup_time_per_core),    SETT_LLONG},
 
     /** General cache.  */
-	{"cache_line_size_log2",   	&(settings.cache_line_size_log2)  },
-	{"cache_line_size",		   	&(settings.cache_line_size)       },
+	{"cache_line_size_log2",     offsetof (Sim_settings, cache_line_size_log2),    SETT_INT},
+	{"cache_line_size",          offsetof (Sim_settings, cache_line_size),         SETT_INT},
 
 	/** Processor.  */
-    {"LSQ_dependence",          &(settings.LSQ_dependence)         },
-    {"mshrs_per_processor",     &(settings.mshrs_per_processor)    },
-    {"threads_per_processor",   &(settings.threads_per_processor)  },
-    {"thread_map_policy",       &(settings.thread_map_policy)      },
+    {"LSQ_dependence",           offsetof (Sim_settings, LSQ_dependence),          SETT_BOOL},
+    {"mshrs_per_processor",      offsetof (Sim_settings, mshrs_per_processor),     SETT_INT},
+    {"threads_per_processor",    offsetof (Sim_settings, threads_per_processor),   SETT_INT},
+    {"thread_map_policy",        offsetof (Sim_settings, thread_map_policy),       SETT_INT},
 
     /** Simple processor.  */
-    {"simple_issue_width",      &(settings.simple_issue_width)     },
+    {"simple_issue_width",       offsetof (Sim_settings, simple_issue_width),      SETT_INT},
 
     /** Inorder processor.  */
-    {"inorder_fetch_width",     &(settings.inorder_fetch_width)    },
-    {"inorder_issue_width",     &(settings.inorder_issue_width)    },
-    {"inorder_commit_width",    &(settings.inorder_commit_width)   },
+    {"inorder_fetch_width",      offsetof (Sim_settings, inorder_fetch_width),     SETT_INT},
+    {"inorder_issue_width",      offsetof (Sim_settings, inorder_issue_width),     SETT_INT},
+    {"inorder_commit_width",     offsetof (Sim_settings, inorder_commit_width),    SETT_INT},
 
     /** L1 cache.  */
-    {"l1_cache_type",           &(settings.l1_cache_type)         },
-	{"l1_cache_size",		   	&(settings.l1_cache_size)         },
-	{"l1_cache_assoc",		   	&(settings.l1_cache_assoc)        },
-	{"l1_hit_time",			   	&(settings.l1_hit_time)           },
-	{"l1_mshrs",			   	&(settings.l1_mshrs)              },
-	{"l1_replacement_policy",  	&(settings.l1_replacement_policy) },
-	{"l1_lookup_time",		   	&(settings.l1_lookup_time)        },
-	{"l1_infinite",		   	    &(settings.l1_infinite)           },
+    {"l1_cache_type",            offsetof (Sim_settings, l1_cache_type),           SETT_INT},
+	{"l1_cache_size",            offsetof (Sim_settings, l1_cache_size),           SETT_INT},
+	{"l1_cache_assoc",           offsetof (Sim_settings, l1_cache_assoc),          SETT_INT},
+	{"l1_hit_time",              offsetof (Sim_settings, l1_hit_time),             SETT_INT},
+	{"l1_mshrs",                 offsetof (Sim_settings, l1_mshrs),                SETT_INT},
+	{"l1_wb_entries",            offsetof (Sim_settings, l1_wb_entries),           SETT_INT},
+	{"l1_replacement_policy",    offsetof (Sim_settings, l1_replacement_policy),   SETT_INT},
+	{"l1_lookup_time",           offsetof (Sim_settings, l1_lookup_time),          SETT_INT},
+	{"l1_infinite",              offsetof (Sim_settings, l1_infinite),             SETT_BOOL},
 
     /** L2 cache.  */
-    {"l2_cache_type",           &(settings.l2_cache_type)         },
-	{"l2_cache_size",		   	&(settings.l2_cache_size)         },
-	{"l2_cache_assoc",		   	&(settings.l2_cache_assoc)        },
-	{"l2_hit_time",			   	&(settings.l2_hit_time)           },
-	{"l2_mshrs",			   	&(settings.l2_mshrs)              },
-	{"l2_replacement_policy",  	&(settings.l2_replacement_policy) },
-	{"l2_lookup_time",		 	&(settings.l2_lookup_time)        },
-	{"l2_infinite",		   	    &(settings.l2_infinite)           },
+    {"l2_cache_type",            offsetof (Sim_settings, l2_cache_type),           SETT_INT},
+	{"l2_cache_size",            offsetof (Sim_settings, l2_cache_size),           SETT_INT},
+	{"l2_cache_assoc",           offsetof (Sim_settings, l2_cache_assoc),          SETT_INT},
+	{"l2_hit_time",              offsetof (Sim_settings, l2_hit_time),             SETT_INT},
+	{"l2_mshrs",                 offsetof (Sim_settings, l2_mshrs),                SETT_INT},
+	{"l2_replacement_policy",    offsetof (Sim_settings, l2_replacement_policy),   SETT_INT},
+	{"l2_lookup_time",           offsetof (Sim_settings, l2_lookup_time),          SETT_INT},
+	{"l2_infinite",              offsetof (Sim_settings, l2_infinite),             SETT_BOOL},
 
     /** L3 cache.  */
-    {"l3_cache_type",           &(settings.l3_cache_type)         },
-	{"l3_cache_size",		   	&(settings.l3_cache_size)         },
-	{"l3_cache_assoc",		   	&(settings.l3_cache_assoc)        },
-	{"l3_hit_time",			   	&(settings.l3_hit_time)           },
-	{"l3_mshrs",			   	&(settings.l3_mshrs)              },
-	{"l3_replacement_policy",  	&(settings.l3_replacement_policy) },
-	{"l3_lookup_time",		 	&(settings.l3_lookup_time)        },
-	{"l3_infinite",		   	    &(settings.l3_infinite)           },
-
-    /** Directory.  */
-	{"dir_tiers",			    &(settings.dir_tiers)             },
-	{"dir_coherence_policy",	&(settings.dir_coherence_policy)  },
-    {"dir_mode",                &(settings.dir_mode)              },
+    {"l3_cache_type",            offsetof (Sim_settings, l3_cache_type),           SETT_INT},
+	{"l3_cache_size",            offsetof (Sim_settings, l3_cache_size),           SETT_INT},
+	{"l3_cache_assoc",           offsetof (Sim_settings, l3_cache_assoc),          SETT_INT},
+	{"l3_hit_time",              offsetof (Sim_settings, l3_hit_time),             SETT_INT},
+	{"l3_mshrs",                 offsetof (Sim_settings, l3_mshrs),                SETT_INT},
+	{"l3_replacement_policy",    offsetof (Sim_settings, l3_replacement_policy),   SETT_INT},
+	{"l3_lookup_time",           offsetof (Sim_settings, l3_lookup_time),          SETT_INT},
+	{"l3_infinite",              offsetof (Sim_settings, l3_infinite),             SETT_BOOL},
+
+    /** Directory.  dir_enabled replaces the bus with home directories on a mesh.  */
+	{"dir_enabled",              offsetof (Sim_settings, dir_enabled),             SETT_BOOL},
+	{"dir_tiers",                offsetof (Sim_settings, dir_tiers),               SETT_INT},
+	{"dir_coherence_policy",     offsetof (Sim_settings, dir_coherence_policy),    SETT_INT_ARRAY},
+    {"dir_mode",                 offsetof (Sim_settings, dir_mode),                SETT_INT},
     
     /** Make sure home bits don't overlap with index bits.  */
-    {"dir_addr_per_node_log2",  &(settings.dir_addr_per_node_log2)},
+    {"dir_addr_per_node_log2",   offsetof (Sim_settings, dir_addr_per_node_log2),  SETT_INT},
 
     /** Set index and directory home node swizzle.  */
-	{"cache_index_swizzle",	    &(settings.cache_index_swizzle)   },
-	{"dir_home_swizzle",	    &(settings.dir_home_swizzle)      },
+	{"cache_index_swizzle",      offsetof (Sim_settings, cache_index_swizzle),     SETT_ADDR},
+	{"dir_home_swizzle",         offsetof (Sim_settings, dir_home_swizzle),        SETT_ADDR},
 
     /** Dynamic home node remapping.  */
-    {"qsets_enabled",           &(settings.qsets_enabled)         },
-    {"qsets_interval",          &(settings.qsets_interval)        },
-    {"remap_table_size",        &(settings.remap_table_size)      },
+    {"qsets_enabled",            offsetof (Sim_settings, qsets_enabled),           SETT_BOOL},
+    {"qsets_interval",           offsetof (Sim_settings, qsets_interval),          SETT_INT},
+    {"remap_table_size",         offsetof (Sim_settings, remap_table_size),        SETT_INT},
 
     /** Selective Replication predictor.  */
-    {"sel_rep_pred",            &(settings.sel_rep_pred)          },
-    {"sel_rep_pred_scope",      &(settings.sel_rep_pred_scope)    },
-    {"train_on_loads",          &(settings.train_on_loads)        },
-    {"train_on_stores",         &(settings.train_on_stores)       },
-    {"sel_rep_pred_threshold",  &(settings.sel_rep_pred_threshold)},
+    {"sel_rep_pred",             offsetof (Sim_settings, sel_rep_pred),            SETT_INT},
+    {"sel_rep_pred_scope",       offsetof (Sim_settings, sel_rep_pred_scope),      SETT_INT},
+    {"train_on_loads",           offsetof (Sim_settings, train_on_loads),          SETT_BOOL},
+    {"train_on_stores",          offsetof (Sim_settings, train_on_stores),         SETT_BOOL},
+    {"sel_rep_pred_threshold",   offsetof (Sim_settings, sel_rep_pred_threshold),  SETT_INT},
 
     /** Sim Analysis flags.  */
-    {"sim_analysis_enabled",    &(settings.sim_analysis_enabled)  },
-    {"ro_tracker_gran",         &(settings.ro_tracker_gran)       },
-    {"ro_tracker_entries",      &(settings.ro_tracker_entries)    },
-	{"data_graph",				&(settings.data_graph)			  },
-
+    {"sim_analysis_enabled",     offsetof (Sim_settings, sim_analysis_enabled),    SETT_BOOL},
+    {"ro_tracker_gran",          offsetof (Sim_settings, ro_tracker_gran),         SETT_INT},
+    {"ro_tracker_entries",       offsetof (Sim_settings, ro_tracker_entries),      SETT_INT},
+	{"data_graph",               offsetof (Sim_settings, data_graph),              SETT_BOOL},
+
+
+	/** Snooping bus: split address/data phases and how many may be in flight.  */
+	{"bus_split_transaction",    offsetof (Sim_settings, bus_split_transaction),   SETT_BOOL},
+	{"bus_max_outstanding",      offsetof (Sim_settings, bus_max_outstanding),     SETT_INT},
+	{"upgrade_enabled",          offsetof (Sim_settings, upgrade_enabled),         SETT_BOOL},
+	{"bus_width",                offsetof (Sim_settings, bus_width),               SETT_INT},
+	{"bus_word_size",            offsetof (Sim_settings, bus_word_size),           SETT_INT},
+	{"migratory_enabled",        offsetof (Sim_settings, migratory_enabled),       SETT_BOOL},
+	{"migratory_entries",        offsetof (Sim_settings, migratory_entries),       SETT_INT},
+	{"migratory_threshold",      offsetof (Sim_settings, migratory_threshold),     SETT_INT},
 
 	/** Express Link and VC Stuff */
-    {"network_topology",        &(settings.network_topology)      },
-	{"express_link_len",		&(settings.express_link_len)	  },
-	{"express_link_active",		&(settings.express_link_active)	  },
-
-	/** DO NOT SET IN CONFIG FILE: These are set automagically by net_infinite_bw **/
-	{"num_virtual_channels",	&(settings.num_virtual_channels)  },
-	{"buffer_entries_per_vc",	&(settings.buffer_entries_per_vc) },
-	{"debug_addr",	            &(settings.debug_addr)            },
-    {"test_addr",               &(settings.test_addr)            },
+    {"network_topology",         offsetof (Sim_settings, network_topology),        SETT_INT},
+	{"net_router_stages",        offsetof (Sim_settings, net_router_stages),       SETT_INT},
+	{"express_link_len",         offsetof (Sim_settings, express_link_len),        SETT_INT},
+	{"express_link_active",      offsetof (Sim_settings, express_link_active),     SETT_BOOL},
+
+	/** Router input buffers: VCs per port and flits per VC.  A torus needs 2+ VCs.  */
+	{"num_virtual_channels",     offsetof (Sim_settings, num_virtual_channels),    SETT_INT},
+	{"buffer_entries_per_vc",    offsetof (Sim_settings, buffer_entries_per_vc),   SETT_INT},
+	{"debug_addr",               offsetof (Sim_settings, debug_addr),              SETT_ADDR},
+    {"test_addr",                offsetof (Sim_settings, test_addr),               SETT_ADDR},
+
+	/** Host threads for the per-core tick phases.  */
+	{"sim_threads",              offsetof (Sim_settings, sim_threads),             SETT_INT},
+	{"trace_prefetch",           offsetof (Sim_settings, trace_prefetch),          SETT_BOOL},
+	{"trace_prefetch_entries",   offsetof (Sim_settings, trace_prefetch_entries),  SETT_INT},
+
+	/** Synthetic workload.  synth_mix_* weigh the patterns of synth_pattern=7.  */
+	{"synth_pattern",            offsetof (Sim_settings, synth_pattern),           SETT_INT},
+	{"synth_cores",              offsetof (Sim_settings, synth_cores),             SETT_INT},
+	{"synth_refs",               offsetof (Sim_settings, synth_refs),              SETT_LLONG},
+	{"synth_footprint",          offsetof (Sim_settings, synth_footprint),         SETT_INT},
+	{"synth_write_pct",          offsetof (Sim_settings, synth_write_pct),         SETT_INT},
+	{"synth_locks",              offsetof (Sim_settings, synth_locks),             SETT_INT},
+	{"synth_seed",               offsetof (Sim_settings, synth_seed),              SETT_INT},
+	{"synth_mix_private",        offsetof (Sim_settings, synth_mix[SYNTH_PRIVATE]),           SETT_INT},
+	{"synth_mix_read_mostly",    offsetof (Sim_settings, synth_mix[SYNTH_READ_MOSTLY]),       SETT_INT},
+	{"synth_mix_migratory",      offsetof (Sim_settings, synth_mix[SYNTH_MIGRATORY]),         SETT_INT},
+	{"synth_mix_prod_cons",      offsetof (Sim_settings, synth_mix[SYNTH_PRODUCER_CONSUMER]), SETT_INT},
+	{"synth_mix_lock",           offsetof (Sim_settings, synth_mix[SYNTH_LOCK]),              SETT_INT},
+	{"synth_mix_false_sharing",  offsetof (Sim_settings, synth_mix[SYNTH_FALSE_SHARING]),     SETT_INT},
 
 	/** report generation, tell simulator to output to cerr, cout, or null for no output **/
-	{"report_output",           &(settings.report_output)         },
+	{"report_output",            offsetof (Sim_settings, report_output),           SETT_INT},
 
 	/** Sampling Rate for statistics that are collected in intervals (i.e. avg sharer stat **/
-	{"sampling_interval",		&(settings.sampling_interval)	  },
+	{"sampling_interval",        offsetof (Sim_settings, sampling_interval),       SETT_LLONG},
 
     /** Invalid.  */
-    {"end",						NULL                                  }
+    {"end",                      0,                                                SETT_NONE}
 };
 
 Sim_settings::Sim_settings (void)
@@ -165,6 +209,67 @@ Sim_settings::~Sim_settings (void)
     //yylex_destroy();
 }
 
+/** Override one setting by name, e.g. from "-o l1_cache_size=8192".
+ *  Integer arrays are given as a comma separated list.  */
+bool Sim_settings::set_setting (const char *name, const char *value)
+{
+    setts *id;
+    char *field;
+    char *end;
+
+    for (id = identifiers; id->type != SETT_NONE; id++)
+        if (!strcmp (id->name, name))
+            break;
+
+    if (id->type == SETT_NONE)
+        return false;
+
+    field = (char *)this + id->offset;
+
+    switch (id->type) {
+    case SETT_INT:
+        *(int *)field = strtol (value, &end, 0);
+        break;
+    case SETT_BOOL:
+        if (!strcmp (value, "true") || !strcmp (value, "1"))
+            *(bool *)field = true;
+        else if (!strcmp (value, "false") || !strcmp (value, "0"))
+            *(bool *)field = false;
+        else
+            return false;
+        end = (char *)value + strlen (value);
+        break;
+    case SETT_LLONG:
+        *(long long int *)field = strtoll (value, &end, 0);
+        break;
+    case SETT_ADDR:
+        *(paddr_t *)field = strtoull (value, &end, 0);
+        break;
+    case SETT_INT_ARRAY:
+    {
+        int count = 1;
+        int *array;
+
+        for (const char *c = value; *c; c++)
+            if (*c == ',')
+                count++;
+
+        array = new int[count];
+        end = (char *)value;
+        for (int i = 0; i < count; i++)
+            array[i] = strtol (end + (i ? 1 : 0), &end, 0);
+
+        delete [] *(int **)field;
+        *(int **)field = array;
+        break;
+    }
+    default:
+        return false;
+    }
+
+    return *end == '\0';
+}
+
 void Sim_settings::print_settings (void) 
 {
     fprintf (stderr, "SIM Settings:\n");
@@ -177,6 +282,8 @@ void Sim_settings::print_settings (void)
     fprintf (stderr, "nhood_y_blocking_factor %16d\n", nhood_y_blocking_factor);
 
 	fprintf (stderr, " num_mem_ctrls:         %16d\n", num_mem_ctrls);
+	fprintf (stderr, " mem_interleave:        %16d\n", mem_interleave);
+	fprintf (stderr, " mem_page_size:         %16d\n", mem_page_size);
 
 
 	fprintf (stderr, " net_infinite_bw:       %16s\n", net_infinite_bw == true ? "true" : "false");
@@ -186,6 +293,14 @@ void Sim_settings::print_settings (void)
     fprintf (stderr, " heartrate              %16d\n", heartrate);
 	fprintf (stderr, " processor_affinity:    %16s\n", processor_affinity == true ? "true" : "false");
     fprintf (stderr, " mem_model_enabled:     %16s\n", mem_model_enabled == true ? "true" : "false");
+    fprintf (stderr, " mem_hit_time:          %16d\n", mem_hit_time);
+    fprintf (stderr, " dram_banks:            %16d\n", dram_banks);
+    fprintf (stderr, " dram_row_size:         %16d\n", dram_row_size);
+    fprintf (stderr, " dram_t_cas:            %16d\n", dram_t_cas);
+    fprintf (stderr, " dram_t_rcd:            %16d\n", dram_t_rcd);
+    fprintf (stderr, " dram_t_rp:             %16d\n", dram_t_rp);
+    fprintf (stderr, " dram_t_burst:          %16d\n", dram_t_burst);
+    fprintf (stderr, " dram_scheduler:        %16d\n", dram_scheduler);
 	fprintf (stderr, " regression_test:       %16s\n", regression_test == true ? "true" : "false");
 
 	fprintf (stderr, " sesc_rabbit:           %16lld\n", sesc_rabbit);
@@ -217,6 +332,7 @@ void Sim_settings::print_settings (void)
 	fprintf (stderr, " l1_cache_assoc:        %16d\n", l1_cache_assoc);
 	fprintf (stderr, " l1_hit_time:           %16d\n", l1_hit_time);
 	fprintf (stderr, " l1_mshrs:              %16d\n", l1_mshrs);
+	fprintf (stderr, " l1_wb_entries:         %16d\n", l1_wb_entries);
 	fprintf (stderr, " l1_replacement_policy: %16d\n", l1_replacement_policy);
 	fprintf (stderr, " l1_coherence_policy:   %16d\n", l1_coherence_policy);
 	fprintf (stderr, " l1_cache_policy:       %16d\n", l1_cache_policy);
@@ -245,6 +361,7 @@ void Sim_settings::print_settings (void)
 	fprintf (stderr, " l3_lookup_time:        %16d\n", l3_lookup_time);
 	fprintf (stderr, " l2_infinite:           %16s\n", l2_infinite == true ? "true" : "false");
 
+	fprintf (stderr, " dir_enabled:           %16s\n", dir_enabled == true ? "true" : "false");
 	fprintf (stderr, " dir_tiers:             %16d\n", dir_tiers);
     fprintf (stderr, " dir_mode:              %16d\n", dir_mode);
     fprintf (stderr, " dir_addr_per_node_log2:%16d\n", dir_addr_per_node_log2);
@@ -283,7 +400,17 @@ void Sim_settings::print_settings (void)
 		int hdd_hit_time;
 	*/
 
+	fprintf (stderr, " bus_split_transaction: %16s\n", bus_split_transaction == true ? "true" : "false");
+	fprintf (stderr, " bus_max_outstanding:   %16d\n", bus_max_outstanding);
+	fprintf (stderr, " upgrade_enabled:       %16s\n", upgrade_enabled == true ? "true" : "false");
+	fprintf (stderr, " bus_width:             %16d\n", bus_width);
+	fprintf (stderr, " bus_word_size:         %16d\n", bus_word_size);
+	fprintf (stderr, " migratory_enabled:     %16s\n", migratory_enabled == true ? "true" : "false");
+	fprintf (stderr, " migratory_entries:     %16d\n", migratory_entries);
+	fprintf (stderr, " migratory_threshold:   %16d\n", migratory_threshold);
+
     fprintf (stderr, " network_topology:      %16d\n", network_topology);
+    fprintf (stderr, " net_router_stages:     %16d\n", net_router_stages);
 	fprintf (stderr, " express_link_len:	  %16d\n", express_link_len);
 	fprintf (stderr, " express_link_active:   %16d\n", express_link_active);
 	fprintf (stderr, " num_virtual_channels:  %16d\n", num_virtual_channels);
@@ -292,6 +419,16 @@ void Sim_settings::print_settings (void)
     fprintf (stderr, " test_addr:             0x%14llx\n", (unsigned long long int) test_addr);
 
 	fprintf (stderr, " sampling_interval:     %lld\n", sampling_interval);
+	fprintf (stderr, " sim_threads:           %16d\n", sim_threads);
+	fprintf (stderr, " trace_prefetch:        %16d\n", trace_prefetch);
+	fprintf (stderr, " trace_prefetch_entries:%16d\n", trace_prefetch_entries);
+	fprintf (stderr, " synth_pattern:         %16d\n", synth_pattern);
+	fprintf (stderr, " synth_cores:           %16d\n", synth_cores);
+	fprintf (stderr, " synth_refs:            %16lld\n", synth_refs);
+	fprintf (stderr, " synth_footprint:       %16d\n", synth_footprint);
+	fprintf (stderr, " synth_write_pct:       %16d\n", synth_write_pct);
+	fprintf (stderr, " synth_locks:           %16d\n", synth_locks);
+	fprintf (stderr, " synth_seed:            %16d\n", synth_seed);
 }
 
 void Sim_settings::set_defaults (void)
@@ -304,7 +441,9 @@ void Sim_settings::set_defaults (void)
     nhood_x_blocking_factor = 0;
     nhood_y_blocking_factor = 0;
 
-    num_mem_ctrls           = 4;
+    num_mem_ctrls           = 1;        /** One controller behind the bus, as in the validation runs.  */
+    mem_interleave          = MEM_INTERLEAVE_LINE;
+    mem_page_size           = 4096;
 
     assert (mem_ctrl_array == NULL);
  
@@ -321,6 +460,15 @@ void Sim_settings::set_defaults (void)
     livelock_check			= true;
     processor_affinity		= true;
     mem_model_enabled       = false;
+
+    mem_hit_time            = 100;
+    dram_banks              = 8;
+    dram_row_size           = 2048;
+    dram_t_cas              = 30;
+    dram_t_rcd              = 30;
+    dram_t_rp               = 30;
+    dram_t_burst            = 8;
+    dram_scheduler          = DRAM_FR_FCFS;
     regression_test         = false;
     sesc_rabbit				= 1000000000;
     sesc_nsim               = 0;
@@ -334,7 +482,7 @@ void Sim_settings::set_defaults (void)
     cache_line_size			= 64;
     
     LSQ_dependence          = true;
-    mshrs_per_processor     = 2;
+    mshrs_per_processor     = 1;        /** Blocking cores by default, as in the validation runs.  */
     threads_per_processor   = 1;
     thread_map_policy       = ROUND_ROBIN_MAP;
 
@@ -348,12 +496,13 @@ void Sim_settings::set_defaults (void)
     l1_cache_size           = 32768;
     l1_cache_assoc          = 4;
     l1_hit_time             = 2;
-    l1_mshrs                = 2;
+    l1_mshrs                = 1;
+    l1_wb_entries           = 8;
     l1_replacement_policy	= RP_LRU;
     l1_coherence_policy		= MESI;
     l1_cache_policy			= CACHE_PRIVATE;
     l1_lookup_time			= 3;
-    l1_infinite             = false;
+    l1_infinite             = true;     /** Finite L1 is opt-in: it changes the validation runs.  */
     
     l2_cache_type           = CACHE_DATA;
     l2_cache_size           = 65536;
@@ -375,6 +524,7 @@ void Sim_settings::set_defaults (void)
     l3_lookup_time			= 3;
     l3_infinite             = false;
 
+    dir_enabled             = false;    /** Snooping bus by default, as in the validation runs.  */
     dir_tiers               = 1;
     dir_coherence_policy    = new int[1];
     dir_coherence_policy[0] = MESI;
@@ -400,13 +550,34 @@ void Sim_settings::set_defaults (void)
     ro_tracker_gran         = cache_line_size;
     ro_tracker_entries      = (1 << 14);
 
+    bus_split_transaction   = false;    /** Atomic bus by default: the validation runs assume it.  */
+    bus_max_outstanding     = 8;
+    upgrade_enabled         = false;    /** S to M stores send GETMs in the validation runs.  */
+    bus_width               = 0;        /** Bytes per bus cycle, 0 gives every phase one cycle.  */
+    bus_word_size           = 8;        /** Bytes a BUSUPD carries.  */
+    migratory_enabled       = false;    /** MESI and MOESI hand lines out shared on a GETS.  */
+    migratory_entries       = 1024;
+    migratory_threshold     = 1;        /** Handoffs seen before a line counts as migratory.  */
+
     network_topology        = MESH;
+    net_router_stages       = 3;
 	express_link_len		= 4;
 	express_link_active		= false;
 	num_virtual_channels	= 16;
 	buffer_entries_per_vc	= 6;
 
 	sampling_interval	    = 1 << 10;
+	sim_threads             = 1;
+
+	synth_pattern           = SYNTH_NONE;
+	synth_cores             = 16;
+	synth_refs              = 100000;
+	synth_footprint         = 1024;
+	synth_write_pct         = 30;
+	synth_locks             = 4;
+	synth_seed              = 1;
+	for (int p = 0; p < SYNTH_NUM_PATTERNS; p++)
+		synth_mix[p]        = 1;
 
     debug_addr              = 0x0;
     test_addr               = 0x0;
@@ -416,5 +587,10 @@ void Sim_settings::set_defaults (void)
     report_output           = OUTPUT_FMT_CSV;
 
     trace_dir               = NULL;
+    binary_traces           = false;
+    trace_prefetch          = true;
+    trace_prefetch_entries  = 4096;
+    event_log               = NULL;
+    text_log                = NULL;
 }
 
@@ -4,9 +4,20 @@
 #include "enums.h"
 #include "types.h"
 
+/** How a setting is parsed from a "name=value" override.  */
+typedef enum {
+	SETT_NONE = 0,
+	SETT_INT,
+	SETT_BOOL,
+	SETT_LLONG,
+	SETT_ADDR,
+	SETT_INT_ARRAY
+} setts_type_t;
+
 typedef struct setts {
 	char name[50];
-	void *pointer;
+	size_t offset;
+	setts_type_t type;
 } setts;
 
 /**
@@ -25,6 +36,18 @@ public:
 
     int                  num_mem_ctrls;
     int*                 mem_ctrl_array;
+    mem_interleave_t     mem_interleave;
+    int                  mem_page_size;
+
+    // Memory.  Flat mem_hit_time unless mem_model_enabled picks the DRAM model.
+    int                  mem_hit_time;
+    int                  dram_banks;
+    int                  dram_row_size;
+    int                  dram_t_cas;
+    int                  dram_t_rcd;
+    int                  dram_t_rp;
+    int                  dram_t_burst;
+    dram_scheduler_t     dram_scheduler;
 
     unsigned int         heartrate;
 
@@ -71,6 +94,7 @@ public:
 	int	   	             l1_cache_assoc;
 	int                  l1_hit_time;
     int                  l1_mshrs;
+    int                  l1_wb_entries;
 	replacement_policy_t l1_replacement_policy;
 	coherence_policy_t	 l1_coherence_policy;
 	cache_policy_t		 l1_cache_policy;
@@ -102,6 +126,7 @@ public:
     bool                 l3_infinite;
 
     // Directory
+    bool                 dir_enabled;
     int                  dir_tiers;
     int*                 dir_coherence_policy;
     dir_mode_t           dir_mode;
@@ -130,22 +155,53 @@ public:
     unsigned int         ro_tracker_entries;
 	bool				 data_graph;
 
+	// Bus
+	bool                 bus_split_transaction;
+	int                  bus_max_outstanding;
+	bool                 upgrade_enabled;
+	int                  bus_width;
+	int                  bus_word_size;
+	bool                 migratory_enabled;
+	int                  migratory_entries;
+	int                  migratory_threshold;
+
 	// Network
     network_topology_t   network_topology;
+    int                  net_router_stages;
     int					 express_link_len;
 	bool				 express_link_active;
-	// These are set by net_infinite_bandwidth and not the config file
+	// Router buffers, unused with net_infinite_bw
 	int					 num_virtual_channels;
 	int					 buffer_entries_per_vc;
 
 	long long int		 sampling_interval;
 
+    // Host threads ticking the cores, results match a single thread
+    int                  sim_threads;
+
 	sim_output_mode_t    report_output;
 
 	paddr_t              debug_addr;
     paddr_t              test_addr;
 
+    // Built in workload instead of trace files, see synthetic.h
+    synth_pattern_t      synth_pattern;
+    int                  synth_cores;
+    long long int        synth_refs;         /** Per core.  */
+    int                  synth_footprint;    /** Lines per region.  */
+    int                  synth_write_pct;
+    int                  synth_locks;
+    int                  synth_seed;
+    int                  synth_mix[SYNTH_NUM_PATTERNS];
+
     char                 *trace_dir;
+    bool                 binary_traces;
+
+    // Decode trace files on a background thread, see prefetch.h
+    bool                 trace_prefetch;
+    int                  trace_prefetch_entries;     /** Per core, a power of two.  */
+    char                 *event_log;
+    char                 *text_log;          /** All text output goes here instead of stderr/stdout.  */
 
     protocol_t protocol;
     bool debug;
@@ -155,6 +211,7 @@ public:
 
     void set_defaults (void);  
   	void get_settings (void);
+    bool set_setting (const char *name, const char *value);
     void get_topology (void);
     void print_settings (void);
 };
@@ -162,7 +219,7 @@ public:
 // Debug
 #define GENERAL_DEBUG         false
 #define TICK_TOCK_DEBUG       false
-#define ADDR_DEBUG            (request->addr == Sim.settings.debug_addr)
+#define ADDR_DEBUG            (request->addr == sim->settings.debug_addr)
 #define LOGIC_DEBUG           false
 #define DIR_HISTORY           false
 
@@ -182,7 +239,7 @@ public:
 
 #define PACKET_OVERHEAD       64
 //#define MIN_LINK_WIDTH        8
-#define MAX_FLITS_PER_PACKET (((Sim.settings.cache_line_size << 3)+ PACKET_OVERHEAD) / LINK_FLIT_WIDTH)
+#define MAX_FLITS_PER_PACKET(line_size) ((((line_size) << 3) + PACKET_OVERHEAD + LINK_FLIT_WIDTH - 1) / LINK_FLIT_WIDTH)
 
 #define NAME_ID_CHAR_BUFF        10
 
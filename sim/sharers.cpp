@@ -4,18 +4,11 @@
 #include "sim.h"
 #include "settings.h"
 
-extern Sim_settings settings;
-extern Simulator *Sim;
-
 /********************************
  * Constructor/destructor.
  ********************************/
 Sharers::Sharers (void)
 {
-    if (settings.num_nodes > 512) 
-    {
-        fatal_error ("Sharers hard coded to 512 nodes..  fix .h file!");
-    }
     owner = -1;
 	sharers.reset();
 }
@@ -171,15 +164,15 @@ int Sharers::nearest_sharer (int id, bool owner_is_local_p)
     return -1;
 }
 
-int abs_distance (int id1, int id2) 
+int abs_distance (int id1, int id2, int y_dim) 
 {
     int id1_x_coor, id1_y_coor, id2_x_coor, id2_y_coor;
     int distance;
  
-    id1_x_coor = id1 % settings.network_y_dimension;
-    id1_y_coor = id1 / settings.network_y_dimension;
-    id2_x_coor = id2 % settings.network_y_dimension;
-    id2_y_coor = id2 / settings.network_y_dimension;
+    id1_x_coor = id1 % y_dim;
+    id1_y_coor = id1 / y_dim;
+    id2_x_coor = id2 % y_dim;
+    id2_y_coor = id2 / y_dim;
  
     distance = (id1_x_coor > id2_x_coor) ? id1_x_coor - id2_x_coor : id2_x_coor - id1_x_coor;
     distance += (id1_y_coor > id2_y_coor) ? id1_y_coor - id2_y_coor : id2_y_coor - id1_y_coor;
@@ -6,7 +6,10 @@
 #include <bitset>
 using namespace std;
 
-int abs_distance (int id1, int id2) ;
+/** Most nodes a directory can track.  */
+#define MAX_SHARERS 512
+
+int abs_distance (int id1, int id2, int y_dim) ;
 
 class Sharers {
 public:
@@ -15,7 +18,7 @@ public:
 
     int owner;
     /** Warning: This blows...  */
-    bitset<512> sharers;
+    bitset<MAX_SHARERS> sharers;
 
     Sharers& operator= (Sharers sharers);
 
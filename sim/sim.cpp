@@ -3,22 +3,32 @@
 #include <stdio.h>
 #include <strings.h>
 
+#include "compress.h"
+#include "directory.h"
+#include "event_log.h"
 #include "hash_table.h"
 #include "processor.h"
 #include "memory.h"
 #include "module.h"
 #include "mreq.h"
+#include "mtrace.h"
+#include "network.h"
+#include "prefetch.h"
 #include "settings.h"
 #include "sim.h"
+#include "synthetic.h"
+#include "trace.h"
 #include "types.h"
 
-extern Sim_settings settings;
-
 /** Fatal Error.  */
 void fatal_error (const char *fmt, ...)
 {
     va_list ap;
 
+    /** Get everything logged so far out ahead of the error.  */
+    if (Event_log::current)
+        Event_log::current->flush ();
+
     va_start (ap, fmt);
     vfprintf (stderr, fmt, ap);
     va_end (ap);
@@ -28,7 +38,8 @@ void fatal_error (const char *fmt, ...)
     exit (-1);
 }
 
-Simulator::Simulator ()
+Simulator::Simulator (const Sim_settings &settings, const Trace_set *traces)
+    : settings (settings)
 {
     /** Seed random number generator.  */
     srandom (1023);
@@ -36,38 +47,116 @@ Simulator::Simulator ()
     /** Set global_clock to cycle zero.  */
     global_clock = 0;
 
+    /** Trace output, binary or to a file of its own if asked for.  */
+    log = new Event_log (this);
+    if (settings.event_log)
+        log->open_binary (settings.event_log);
+    else if (settings.text_log)
+        log->open_text (settings.text_log);
+
     /** Allocate bus.  */
-    bus = new Bus ();
+    bus = new Bus (this);
     assert (bus && "Sim error: Unable to alloc bus.");
 
-    Nd = new Node*[settings.num_nodes+1];
+    /** Cores are nodes 0..num_nodes-1, memory controllers follow.  */
+    if (settings.num_mem_ctrls < 1)
+        fatal_error ("Sim error: need at least one memory controller\n");
+    total_nodes = settings.num_nodes + settings.num_mem_ctrls;
+
+    mc_index_bits = 0;
+    while ((1 << mc_index_bits) < settings.num_mem_ctrls)
+        mc_index_bits++;
+
+    dir_index_bits = 0;
+    while ((1 << dir_index_bits) < settings.num_nodes)
+        dir_index_bits++;
+
+    Nd = new Node*[total_nodes];
+
+    /** Trace files come out of the directory's trace.mtrace if it has one,
+     *  else one file per core, and are decoded ahead of the cores unless
+     *  asked not to.  */
+    VECTOR<Trace_reader *> sources;
+
+    merged = NULL;
+    prefetcher = NULL;
+    if (!traces && settings.synth_pattern == SYNTH_NONE)
+    {
+        char *merged_file = find_merged_trace (settings.trace_dir);
+        int spare = spare_cpus (settings.sim_threads + settings.trace_prefetch);
+
+        if (merged_file)
+            merged = new Merged_trace (merged_file);
+        free (merged_file);
+
+        for (int node = 0; node < settings.num_nodes; node++)
+            sources.push_back (merged ? merged->reader (node) :
+                               open_trace (settings.trace_dir, node, settings.binary_traces, node < spare));
+
+        if (settings.trace_prefetch)
+            prefetcher = new Trace_prefetcher (this, sources, settings.trace_prefetch_entries);
+    }
 
     /** Allocate processors.  */
     for (int node = 0; node < settings.num_nodes; node++)
     {
-        char trace_file[100];
-        sprintf (trace_file, "%s/p%d.trace", settings.trace_dir, node);
+        Trace_reader *trace;
+
+        if (traces)
+            trace = traces->reader (node);
+        else if (settings.synth_pattern != SYNTH_NONE)
+            trace = new Synthetic_trace_reader (settings, node);
+        else if (prefetcher)
+            trace = prefetcher->reader (node);
+        else
+            trace = sources[node];
 
-        Nd[node] = new Node (node);
-        Nd[node]->build_processor (trace_file);
+        Nd[node] = new Node (this, node);
+        Nd[node]->build_processor (trace);
     }
 
     /** Allocate memory controllers.  */
-    Nd[settings.num_nodes] = new Node (settings.num_nodes);
-    Nd[settings.num_nodes]->build_memory_controller ();
+    for (int node = settings.num_nodes; node < total_nodes; node++)
+    {
+        Nd[node] = new Node (this, node);
+        Nd[node]->build_memory_controller ();
+    }
 
-    cache_misses = 0;
-    silent_upgrades = 0;
-    cache_to_cache_transfers = 0;
-    cache_accesses = 0;
+    /** Directory mode: a directory on every core, every node on the mesh.  */
+    network = NULL;
+    if (settings.dir_enabled)
+    {
+        if (settings.dir_mode != DIR_1L)
+            fatal_error ("Sim error: only the single level directory (dir_mode=%d) is modelled\n", DIR_1L);
+
+        if (settings.num_nodes > MAX_SHARERS)
+            fatal_error ("Sim error: the directory tracks at most %d cores\n", MAX_SHARERS);
+
+        network = new Network (this, total_nodes);
+
+        for (int node = 0; node < total_nodes; node++)
+        {
+            Nd[node]->build_network_interface ();
+            if (node < settings.num_nodes)
+                Nd[node]->build_directory ();
+        }
+    }
+
+    parallel_phase = false;
 }
 
 Simulator::~Simulator ()
 {
-    for (int i = 0; i < settings.num_nodes; i++)
+    delete prefetcher;
+
+    for (int i = 0; i < total_nodes; i++)
         delete Nd[i];
+    delete merged;
 
     delete [] Nd;    
+    delete network;
+    delete bus;
+    delete log;
 }
 
 void Simulator::dump_stats ()
@@ -76,25 +165,68 @@ void Simulator::dump_stats ()
     {
     	get_L1(i)->dump_hash_table();
     }
-    fprintf(stderr,"\nRun Time:         %8lld cycles\n",global_clock);
-    fprintf(stderr,"Cache Misses:     %8ld misses\n",cache_misses);
-    fprintf(stderr,"Cache Accesses:   %8ld accesses\n",cache_accesses);
-    fprintf(stderr,"Silent Upgrades:  %8ld upgrades\n",silent_upgrades);
-    fprintf(stderr,"$-to-$ Transfers: %8ld transfers\n",cache_to_cache_transfers);
+    log->text(stderr,"\nRun Time:         %8lld cycles\n",(long long)global_clock);
+    log->text(stderr,"Cache Misses:     %8lld misses\n",(long long)cache_misses.total());
+    log->text(stderr,"Cache Accesses:   %8lld accesses\n",(long long)cache_accesses.total());
+    log->text(stderr,"Silent Upgrades:  %8lld upgrades\n",(long long)silent_upgrades.total());
+    log->text(stderr,"$-to-$ Transfers: %8lld transfers\n",(long long)cache_to_cache_transfers.total());
+    if (!settings.l1_infinite)
+    {
+        counter_t writebacks = 0;
+
+        for (int i = settings.num_nodes; i < total_nodes; i++)
+            writebacks += get_MC(i)->writes;
+        log->text(stderr,"Evictions:        %8lld evictions\n",(long long)evictions.total());
+        log->text(stderr,"Writebacks:       %8lld lines\n",(long long)writebacks);
+    }
+    if (settings.l1_mshrs > 1)
+        log->text(stderr,"Coalesced Misses: %8lld misses\n",(long long)secondary_misses.total());
+    if (settings.upgrade_enabled)
+        log->text(stderr,"Upgrades:         %8lld upgrades\n",(long long)upgrades.total());
+    if (settings.protocol == DRAGON_PRO || settings.protocol == FIREFLY_PRO)
+        log->text(stderr,"Bus Updates:      %8lld updates\n",(long long)bus_updates.total());
+    if (settings.migratory_enabled)
+        log->text(stderr,"Migratory:        %8lld handoffs\n",(long long)migratory_handoffs.total());
+    if (settings.bus_width && !settings.dir_enabled)
+    {
+        log->text(stderr,"Bus Busy:         %8lld cycles\n",(long long)bus->busy_cycles);
+        log->text(stderr,"Bus Data:         %8lld bytes\n",(long long)bus->data_bytes);
+    }
+    if (settings.mem_model_enabled)
+        for (int i = settings.num_nodes; i < total_nodes; i++)
+            get_MC(i)->print_stats();
+    if (settings.dir_enabled)
+    {
+        counter_t forwards = 0;
+
+        for (int i = 0; i < settings.num_nodes; i++)
+            forwards += get_DIR(i)->forwards;
+        log->text(stderr,"Dir Forwards:     %8lld snoops\n",(long long)forwards);
+        network->print_stats();
+    }
 }
 
 void Simulator::run ()
 {
     int sched;
     bool done;
+    Tick_pool *pool = NULL;
 
     /** This must match what's in enums.h.  */
-    const char *cp_str[9] = {"CACHE_PRO","MI_PRO","MSI_PRO","MESI_PRO",
-							 "MOESI_PRO","MOSI_PRO","MOESIF_PRO","NULL_PRO","MEM_PRO"};
+    const char *cp_str[11] = {"CACHE_PRO","MI_PRO","MSI_PRO","MESI_PRO",
+							 "MOESI_PRO","MOSI_PRO","MOESIF_PRO","DRAGON_PRO","FIREFLY_PRO",
+							 "NULL_PRO","MEM_PRO"};
+
+    Event_log::current = log;
 
-    fprintf (stderr, "CSX290 Sim - Begins  ");
-    fprintf (stderr, " Cores: %d", settings.num_nodes);
-    fprintf (stderr, " Protocol: %s\n", cp_str[settings.protocol]);
+    log->text (stderr, "CSX290 Sim - Begins  ");
+    log->text (stderr, " Cores: %d", settings.num_nodes);
+    log->text (stderr, " Protocol: %s\n", cp_str[settings.protocol]);
+
+    /** The core phases go to worker threads, the few memory controllers
+     *  are ticked on the main thread.  */
+    if (settings.sim_threads > 1)
+        pool = new Tick_pool (this, settings.sim_threads, settings.num_nodes);
 
     /** Main run loop.  */
     sched = 0;
@@ -102,18 +234,38 @@ void Simulator::run ()
     while (!done)
     {
         bus->tick ();
+        if (network)
+            network->tick ();
+
+        if (pool)
+        {
+            pool->run (PHASE_TICK_CACHE);
+            pool->run (PHASE_TICK_PR);
+            if (settings.dir_enabled)
+                pool->run (PHASE_TICK_DIR);
 
-        for (int i = 0; i <= settings.num_nodes; i++)
-            Nd[i]->tick_cache ();
+            for (int i = settings.num_nodes; i < total_nodes; i++)
+                Nd[i]->tick_mc ();
 
-        for (int i = 0; i <= settings.num_nodes; i++)
-            Nd[i]->tick_pr ();
+            pool->run (PHASE_TOCK_PR);
+        }
+        else
+        {
+            for (int i = 0; i < total_nodes; i++)
+                Nd[i]->tick_cache ();
 
-        for (int i = 0; i <= settings.num_nodes; i++)
-            Nd[i]->tick_mc ();
-        
-        for (int i = 0; i <= settings.num_nodes; i++)
-			Nd[i]->tock_pr ();
+            for (int i = 0; i < total_nodes; i++)
+                Nd[i]->tick_pr ();
+
+            for (int i = 0; i < total_nodes; i++)
+                Nd[i]->tick_dir ();
+
+            for (int i = 0; i < total_nodes; i++)
+                Nd[i]->tick_mc ();
+
+            for (int i = 0; i < total_nodes; i++)
+                Nd[i]->tock_pr ();
+        }
 
         global_clock++;
 
@@ -124,10 +276,74 @@ void Simulator::run ()
                 done = false;
                 break;        
             }
+
+        /** Jump the clock over cycles in which no module has any work.  */
+        if (!done)
+            global_clock = next_event ();
     }
 
-    fprintf(stderr,"\n\nSimulation Finished\n");
+    delete pool;
+
+    log->text(stderr,"\n\nSimulation Finished\n");
     dump_stats();
+    log->flush();
+}
+
+/** Earliest cycle at which the bus or any node has something to do.  */
+timestamp_t Simulator::next_event (void)
+{
+    timestamp_t next = bus->next_event ();
+
+    if (network)
+        next = min (next, network->next_event ());
+
+    for (int i = 0; i < total_nodes && next > global_clock; i++)
+        next = min (next, Nd[i]->next_event ());
+
+    if (next == NEVER)
+        fatal_error ("Sim error: no pending events at clock %lld\n", (long long)global_clock);
+
+    return max (next, global_clock);
+}
+
+/** Node of the memory controller that owns addr's slice of memory.  */
+int Simulator::home_mc (paddr_t addr)
+{
+    paddr_t line = addr >> settings.cache_line_size_log2;
+    paddr_t fold;
+
+    switch (settings.mem_interleave) {
+    case MEM_INTERLEAVE_LINE:
+        break;
+    case MEM_INTERLEAVE_PAGE:
+        line = addr / settings.mem_page_size;
+        break;
+    case MEM_INTERLEAVE_XOR:
+        /** Fold the swizzled bits onto the line number so that power of two
+         *  strides still spread across controllers.  */
+        fold = (addr & settings.dir_home_swizzle) >> settings.cache_line_size_log2;
+        for ( ; fold && mc_index_bits; fold >>= mc_index_bits)
+            line ^= fold;
+        break;
+    default:
+        fatal_error ("Sim error: unknown memory interleave %d\n", settings.mem_interleave);
+    }
+
+    return settings.num_nodes + (int)(line % settings.num_mem_ctrls);
+}
+
+/** Core whose directory is home for addr.  Blocks of
+ *  2^dir_addr_per_node_log2 bytes go round robin over the cores, with the
+ *  dir_home_swizzle bits of the address folded onto the block number.  */
+int Simulator::home_dir (paddr_t addr)
+{
+    paddr_t block = addr >> settings.dir_addr_per_node_log2;
+    paddr_t fold = (addr & settings.dir_home_swizzle) >> settings.dir_addr_per_node_log2;
+
+    for ( ; fold && dir_index_bits; fold >>= dir_index_bits)
+        block ^= fold;
+
+    return (int)(block % settings.num_nodes);
 }
 
 Processor* Simulator::get_PR (int node)
@@ -142,6 +358,14 @@ Memory_controller* Simulator::get_MC (int node)
 {
     return (Memory_controller *)(Nd[node]->mod[MC_M]);
 }
+Network_interface* Simulator::get_NI (int node)
+{
+    return (Network_interface *)(Nd[node]->mod[NI_M]);
+}
+Directory* Simulator::get_DIR (int node)
+{
+    return (Directory *)(Nd[node]->mod[DIR_M]);
+}
 
 /** Debug.  */
 void Simulator::dump_processors (void)
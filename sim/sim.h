@@ -4,47 +4,98 @@
 #include "bus.h"
 #include "enums.h"
 #include "node.h"
+#include "parallel.h"
 #include "settings.h"
 #include "types.h"
 
-#define Global_Clock Sim->global_clock
+/** Current cycle of the simulation that sim points to.  */
+#define Global_Clock (sim->global_clock)
 
 class Node;
 class Processor;
 class Hash_table;
 class L1_cache;
 class Memory_controller;
+class Event_log;
+class Network;
+class Network_interface;
+class Directory;
+class Trace_set;
+class Trace_prefetcher;
+class Merged_trace;
 
 void fatal_error (const char *fmt, ...) __attribute__ ((noreturn));
 
+/**
+ * One simulation.  Everything it touches hangs off this object, which is
+ * handed to each module as it is built, so several simulations can run in
+ * one process at the same time, each on its own thread.
+ */
 class Simulator {
 public:
-    Simulator ();
+    /** References come from traces if given, else from the files in
+     *  settings.trace_dir.  */
+    Simulator (const Sim_settings &settings, const Trace_set *traces = NULL);
     ~Simulator ();
 
+    /** Owned by the caller, must outlive the simulation.  */
+    const Sim_settings &settings;
+
     timestamp_t global_clock;
 
     Node **Nd;
     Bus *bus;
 
+    /** Directory mode interconnect, NULL on the bus.  */
+    Network *network;
+
+    /** Cores plus memory controllers.  */
+    int total_nodes;
+    int mc_index_bits;
+    int dir_index_bits;
+
+    /** Trace output.  */
+    Event_log *log;
+
+    /** Background decoding of the trace files, NULL if not used.  */
+    Trace_prefetcher *prefetcher;
+
+    /** The trace directory's trace.mtrace, NULL if it has none.  */
+    Merged_trace *merged;
+
     /** Run/Fini for simulator.  */
     void run (void);
     void dump_stats (void);
 
+    /** Event-driven time skipping.  */
+    timestamp_t next_event (void);
+
     /** Accessor functions */
     Processor *get_PR (int node);
     Hash_table *get_L1 (int node);
     Memory_controller *get_MC (int node);
+    Network_interface *get_NI (int node);
+    Directory *get_DIR (int node);
+    int home_mc (paddr_t addr);
+    int home_dir (paddr_t addr);
 
     /** Debug.  */
     void dump_processors (void);
 	void dump_outstanding_requests (int nodeID);
     void dump_cache_block (int nodeID, paddr_t addr);
 
-    unsigned long int cache_misses;
-    unsigned long int cache_accesses;
-    unsigned long int silent_upgrades;
-    unsigned long int cache_to_cache_transfers;
+    /** Set while worker threads run a phase, see Tick_pool.  */
+    bool parallel_phase;
+
+    Sim_counter cache_misses;
+    Sim_counter cache_accesses;
+    Sim_counter silent_upgrades;
+    Sim_counter cache_to_cache_transfers;
+    Sim_counter evictions;
+    Sim_counter secondary_misses;
+    Sim_counter upgrades;
+    Sim_counter bus_updates;
+    Sim_counter migratory_handoffs;
 };
 
 #endif
@@ -0,0 +1,149 @@
+#include "sim.h"
+#include "synthetic.h"
+
+Synthetic_trace_reader::Synthetic_trace_reader (const Sim_settings &settings, int node)
+    : settings (settings)
+{
+    int sum = 0;
+
+    if (settings.synth_pattern <= SYNTH_NONE || settings.synth_pattern >= SYNTH_NUM_PATTERNS)
+        fatal_error ("Synthetic: unknown pattern %d\n", settings.synth_pattern);
+    if (settings.synth_footprint < 1 || settings.synth_locks < 1)
+        fatal_error ("Synthetic: synth_footprint and synth_locks must be at least 1\n");
+    if ((paddr_t)settings.synth_footprint * settings.cache_line_size > SYNTH_REGION_SIZE)
+        fatal_error ("Synthetic: synth_footprint of %d lines overflows a region\n", settings.synth_footprint);
+    if (settings.synth_cores < 1 || (paddr_t)settings.synth_cores > SYNTH_MAX_CORES)
+        fatal_error ("Synthetic: synth_cores must be 1 to %llu, not %d\n",
+                     (unsigned long long)SYNTH_MAX_CORES, settings.synth_cores);
+
+    this->node = node;
+    remaining = settings.synth_refs;
+    line_size = settings.cache_line_size;
+    stream_pos = 0;
+    queue_pos = 0;
+
+    /** xorshift64* must not start at zero.  */
+    rng = ((uint64_t)settings.synth_seed << 32) ^ ((uint64_t)(node + 1) * 0x9e3779b97f4a7c15ULL);
+    if (!rng)
+        rng = 1;
+
+    for (int p = 0; p < SYNTH_NUM_PATTERNS; p++)
+    {
+        if (p > SYNTH_NONE && p < SYNTH_MIX)
+            sum += max (settings.synth_mix[p], 0);
+        weight_sum[p] = sum;
+    }
+    if (settings.synth_pattern == SYNTH_MIX && sum == 0)
+        fatal_error ("Synthetic: every synth_mix weight is zero\n");
+}
+
+uint64_t Synthetic_trace_reader::random (void)
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545f4914f6cdd1dULL;
+}
+
+int Synthetic_trace_reader::random_below (int n)
+{
+    return (int)((random () >> 33) % n);
+}
+
+void Synthetic_trace_reader::push (char op, paddr_t addr)
+{
+    trace_ref_t ref;
+
+    ref.op = op;
+    ref.gap = 0;
+    ref.addr = addr;
+    episode.push_back (ref);
+}
+
+void Synthetic_trace_reader::start_episode (synth_pattern_t pattern)
+{
+    int footprint = settings.synth_footprint;
+    int cores = settings.num_nodes;
+    bool write = random_below (100) < settings.synth_write_pct;
+    paddr_t addr;
+
+    switch (pattern) {
+    case SYNTH_PRIVATE:
+        addr = SYNTH_PRIVATE_BASE + node * SYNTH_REGION_SIZE + (stream_pos++ % footprint) * line_size;
+        push (write ? 'w' : 'r', addr);
+        break;
+
+    case SYNTH_READ_MOSTLY:
+        addr = SYNTH_SHARED_BASE + random_below (footprint) * line_size;
+        push (random_below (SYNTH_READ_MOSTLY_WRITES) ? 'r' : 'w', addr);
+        break;
+
+    case SYNTH_MIGRATORY:
+        addr = SYNTH_MIGRATORY_BASE + random_below (footprint) * line_size;
+        push ('r', addr);
+        push ('w', addr);
+        break;
+
+    case SYNTH_PRODUCER_CONSUMER:
+    {
+        paddr_t slot = (queue_pos++ % footprint) * line_size;
+        int producer = (node + cores - 1) % cores;
+
+        push ('w', SYNTH_QUEUE_BASE + node * SYNTH_REGION_SIZE + slot);
+        push ('r', SYNTH_QUEUE_BASE + producer * SYNTH_REGION_SIZE + slot);
+        break;
+    }
+
+    case SYNTH_LOCK:
+    {
+        /** The lock and the data it guards sit on neighbouring lines.  */
+        paddr_t lock = SYNTH_LOCK_BASE + random_below (settings.synth_locks) * 2 * line_size;
+        int spins = 1 + random_below (4);
+
+        for (int i = 0; i < spins; i++)
+            push ('r', lock);
+        push ('w', lock);
+        push ('r', lock + line_size);
+        push ('w', lock + line_size);
+        push ('w', lock);
+        break;
+    }
+
+    case SYNTH_FALSE_SHARING:
+    {
+        paddr_t word = (node * sizeof (uint64_t)) % line_size;
+
+        addr = SYNTH_FALSE_BASE + random_below (footprint) * line_size + word;
+        push (write ? 'w' : 'r', addr);
+        break;
+    }
+
+    case SYNTH_MIX:
+    {
+        int pick = random_below (weight_sum[SYNTH_MIX]);
+        int p = SYNTH_PRIVATE;
+
+        while (pick >= weight_sum[p])
+            p++;
+        start_episode ((synth_pattern_t)p);
+        break;
+    }
+
+    default:
+        fatal_error ("Synthetic: unknown pattern %d\n", pattern);
+    }
+}
+
+bool Synthetic_trace_reader::next (trace_ref_t *ref)
+{
+    if (remaining <= 0)
+        return false;
+
+    if (episode.empty ())
+        start_episode (settings.synth_pattern);
+
+    *ref = episode.front ();
+    episode.pop_front ();
+    remaining--;
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef SYNTHETIC_H_
+#define SYNTHETIC_H_
+
+#include "enums.h"
+#include "settings.h"
+#include "trace.h"
+#include "types.h"
+
+/** Where each pattern's lines live.  Private and queue regions are per
+ *  core, the queues of up to SYNTH_MAX_CORES cores fit below the first
+ *  private region.  */
+#define SYNTH_SHARED_BASE       0x10000000ULL
+#define SYNTH_MIGRATORY_BASE    0x20000000ULL
+#define SYNTH_LOCK_BASE         0x30000000ULL
+#define SYNTH_FALSE_BASE        0x40000000ULL
+#define SYNTH_QUEUE_BASE        0x100000000ULL
+#define SYNTH_PRIVATE_BASE      0x100000000000ULL
+#define SYNTH_REGION_SIZE       0x10000000ULL
+#define SYNTH_MAX_CORES         ((SYNTH_PRIVATE_BASE - SYNTH_QUEUE_BASE) / SYNTH_REGION_SIZE)
+
+/** One in this many read-mostly references is a write.  */
+#define SYNTH_READ_MOSTLY_WRITES 64
+
+/**
+ * Generated per-core workload, so a run needs no trace files.
+ *
+ * References are made up an episode at a time and handed out one by one.
+ * An episode is one access of the chosen pattern:
+ *  - private:        next line of a stream over the core's own lines
+ *  - read-mostly:    a random shared line, rarely written
+ *  - migratory:      read then write a random shared object
+ *  - producer-consumer: write the next slot of the core's queue, then read
+ *                    the same slot of the previous core's queue
+ *  - lock:           spin reading a random lock, take it, touch the data
+ *                    it guards and release it
+ *  - false sharing:  write or read the core's own word of a line every
+ *                    core uses
+ *  - mix:            a pattern picked per episode by the synth_mix_* weights
+ *
+ * Each core has its own random stream seeded from synth_seed, so a run is
+ * the same every time and cores do not depend on each other.
+ */
+class Synthetic_trace_reader : public Trace_reader {
+public:
+    Synthetic_trace_reader (const Sim_settings &settings, int node);
+
+    const Sim_settings &settings;
+    int node;
+    uint64_t rng;
+    long long int remaining;
+    paddr_t line_size;
+
+    /** Per pattern position.  */
+    long long int stream_pos;
+    long long int queue_pos;
+
+    /** Rest of the current episode.  */
+    DEQUE<trace_ref_t> episode;
+
+    /** Running sum of the mix weights, by pattern.  */
+    int weight_sum[SYNTH_NUM_PATTERNS];
+
+    uint64_t random (void);
+    int random_below (int n);
+    void push (char op, paddr_t addr);
+    void start_episode (synth_pattern_t pattern);
+
+    bool next (trace_ref_t *ref);
+};
+
+#endif // SYNTHETIC_H_
@@ -0,0 +1,265 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compress.h"
+#include "mtrace.h"
+#include "sim.h"
+#include "trace.h"
+
+Trace_reader::~Trace_reader ()
+{
+}
+
+/*************************
+ * Text traces.
+ *************************/
+Text_trace_reader::Text_trace_reader (const char *trace_file)
+{
+    this->trace_file = strdup (trace_file);
+    infile = fopen (trace_file, "r");
+    if (!infile)
+        fatal_error ("Trace: unable to open %s\n", trace_file);
+}
+
+Text_trace_reader::~Text_trace_reader ()
+{
+    fclose (infile);
+    free (trace_file);
+}
+
+bool Text_trace_reader::next (trace_ref_t *ref)
+{
+    char line[256];
+    unsigned long long int addr;
+    unsigned int gap = 0;
+    int n;
+
+    do {
+        if (!fgets (line, sizeof (line), infile))
+            return false;
+    } while ((n = sscanf (line, " %c 0x%llx %u", &ref->op, &addr, &gap)) == EOF);
+
+    if (n < 2)
+        fatal_error ("Trace: %s - bad line %s", trace_file, line);
+
+    ref->addr = (paddr_t)addr;
+    ref->gap = gap;
+    return true;
+}
+
+/*************************
+ * Binary traces.
+ *************************/
+Binary_trace_reader::Binary_trace_reader (const char *trace_file)
+{
+    struct stat st;
+    const btrace_header_t *header;
+    int fd;
+
+    fd = open (trace_file, O_RDONLY);
+    if (fd < 0 || fstat (fd, &st) < 0)
+        fatal_error ("Trace: unable to open %s\n", trace_file);
+
+    if ((size_t)st.st_size < sizeof (btrace_header_t))
+        fatal_error ("Trace: %s is too short to be a binary trace\n", trace_file);
+
+    map_size = st.st_size;
+    map = (const uint8_t *)mmap (NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+
+    if (map == MAP_FAILED)
+        fatal_error ("Trace: unable to map %s\n", trace_file);
+
+    madvise ((void *)map, map_size, MADV_SEQUENTIAL);
+
+    header = (const btrace_header_t *)map;
+    if (memcmp (header->magic, BTRACE_MAGIC, sizeof (header->magic)) ||
+        header->version < 1 || header->version > BTRACE_VERSION)
+        fatal_error ("Trace: %s is not a version 1-%d binary trace\n", trace_file, BTRACE_VERSION);
+    version = header->version;
+
+    cur = map + sizeof (btrace_header_t);
+    end = map + map_size;
+    prev_addr = 0;
+}
+
+Binary_trace_reader::~Binary_trace_reader ()
+{
+    munmap ((void *)map, map_size);
+}
+
+/** LEB128 varint.  */
+uint64_t Binary_trace_reader::read_varint (void)
+{
+    uint64_t v = 0;
+    int shift = 0;
+
+    do {
+        if (cur >= end)
+            fatal_error ("Trace: truncated binary trace\n");
+        v |= (uint64_t)(*cur & 0x7f) << shift;
+        shift += 7;
+    } while (*cur++ & 0x80);
+
+    return v;
+}
+
+bool Binary_trace_reader::next (trace_ref_t *ref)
+{
+    if (cur >= end)
+        return false;
+
+    if (btrace_unpack (read_varint (), version, &prev_addr, ref))
+        ref->gap = (uint32_t)read_varint ();
+    return true;
+}
+
+/*************************
+ * Traces in memory.
+ *************************/
+Buffered_trace_reader::Buffered_trace_reader (const VECTOR<trace_ref_t> *refs)
+{
+    this->refs = refs;
+    pos = 0;
+}
+
+bool Buffered_trace_reader::next (trace_ref_t *ref)
+{
+    if (pos >= refs->size ())
+        return false;
+
+    *ref = (*refs)[pos++];
+    return true;
+}
+
+Trace_set::Trace_set (const char *trace_dir, int num_nodes, bool binary_traces)
+{
+    char *merged_file = find_merged_trace (trace_dir);
+    Merged_trace *merged = merged_file ? new Merged_trace (merged_file) : NULL;
+
+    refs.resize (num_nodes);
+
+    for (int node = 0; node < num_nodes; node++)
+    {
+        Trace_reader *in = merged ? merged->reader (node) :
+                           open_trace (trace_dir, node, binary_traces, spare_cpus (1) > 0);
+        trace_ref_t ref;
+
+        while (in->next (&ref))
+            refs[node].push_back (ref);
+        delete in;
+    }
+
+    delete merged;
+    free (merged_file);
+}
+
+Trace_reader *Trace_set::reader (int node) const
+{
+    return new Buffered_trace_reader (&refs[node]);
+}
+
+int read_num_nodes (const char *trace_dir)
+{
+    char config_path[1000];
+    char *merged_file;
+    FILE *config_file;
+    int num_nodes = 0;
+
+    sprintf(config_path,"%s/config",trace_dir);
+    config_file = fopen (config_path,"r");
+    if (config_file)
+    {
+        if (fscanf(config_file,"%d\n",&num_nodes) != 1)
+            fatal_error("Config File should contain number of traces\n");
+        fclose (config_file);
+    }
+    else if ((merged_file = find_merged_trace (trace_dir)))
+    {
+        Merged_trace merged (merged_file);
+
+        num_nodes = merged.header->num_cores;
+        free (merged_file);
+    }
+    else
+    	fatal_error("Config File should contain number of traces\n");
+
+    if (num_nodes == 0)
+        fatal_error ("Error: number of processors is zero.\n");
+
+    return num_nodes;
+}
+
+Trace_reader *open_trace_file (const char *trace_file, bool binary, bool threaded)
+{
+    Byte_source *source;
+
+    if (access (trace_file, F_OK) && (source = open_compressed (trace_file, threaded)))
+        return new Stream_trace_reader (source, binary, trace_file);
+
+    if (binary)
+        return new Binary_trace_reader (trace_file);
+    return new Text_trace_reader (trace_file);
+}
+
+Trace_reader *open_trace (const char *trace_dir, int node, bool binary_traces, bool threaded)
+{
+    char trace_file[1000];
+
+    snprintf (trace_file, sizeof (trace_file), binary_traces ? "%s/p%d.btrace" : "%s/p%d.trace", trace_dir, node);
+    return open_trace_file (trace_file, binary_traces, threaded);
+}
+
+Binary_trace_writer::Binary_trace_writer (const char *trace_file)
+{
+    btrace_header_t header;
+
+    outfile = fopen (trace_file, "wb");
+    if (!outfile)
+        fatal_error ("Trace: unable to create %s\n", trace_file);
+
+    /** Count is patched in on close.  */
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, BTRACE_MAGIC, sizeof (header.magic));
+    header.version = BTRACE_VERSION;
+    fwrite (&header, sizeof (header), 1, outfile);
+
+    prev_addr = 0;
+    num_refs = 0;
+}
+
+Binary_trace_writer::~Binary_trace_writer ()
+{
+    fseek (outfile, offsetof (btrace_header_t, num_refs), SEEK_SET);
+    fwrite (&num_refs, sizeof (num_refs), 1, outfile);
+    fclose (outfile);
+}
+
+void Binary_trace_writer::write (const trace_ref_t *ref)
+{
+    uint8_t buf[20];
+    int len = btrace_pack (ref, &prev_addr, buf);
+
+    fwrite (buf, 1, len, outfile);
+    num_refs++;
+}
+
+uint64_t convert_trace (const char *text_file, const char *binary_file)
+{
+    Trace_reader *in = open_trace_file (text_file, false, spare_cpus (1) > 0);
+    Binary_trace_writer out (binary_file);
+    trace_ref_t ref;
+
+    while (in->next (&ref))
+    {
+        if (ref.op != 'r' && ref.op != 'w')
+            fatal_error ("Trace: %s - unknown operation %c\n", text_file, ref.op);
+        out.write (&ref);
+    }
+
+    delete in;
+    return out.num_refs;
+}
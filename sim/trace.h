@@ -0,0 +1,183 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "types.h"
+
+/** A single memory reference from a per-core trace.  */
+typedef struct {
+    char op;                 /** 'r' or 'w'.  */
+    uint32_t gap;            /** Cycles of other work before it issues.  */
+    paddr_t addr;
+} trace_ref_t;
+
+/**
+ * Source of references for a Processor.
+ */
+class Trace_reader {
+public:
+    virtual ~Trace_reader ();
+
+    /** Fetch the next reference.  Returns false at end of trace.  */
+    virtual bool next (trace_ref_t *ref) =0;
+};
+
+/**
+ * Plain text pN.trace files: one "r|w 0xADDR [gap]" per line.  The
+ * optional gap is the number of cycles the core spends on non-memory
+ * work before it issues the reference, 0 if left out.
+ */
+class Text_trace_reader : public Trace_reader {
+public:
+    Text_trace_reader (const char *trace_file);
+    ~Text_trace_reader ();
+
+    char *trace_file;
+    FILE *infile;
+
+    bool next (trace_ref_t *ref);
+};
+
+/**
+ * Binary pN.btrace files.
+ *
+ * Layout:  header (magic, version, record count) followed by one LEB128
+ * varint per reference holding (zigzag (addr - prev_addr) << 2) |
+ * has_gap << 1 | is_write, and a second varint with the gap if has_gap.
+ * Deltas must fit in 61 bits, which covers any physical address we trace.
+ * Version 1 files, without the has_gap bit, are still read.
+ * The reader maps the whole file and decodes straight out of the mapping.
+ */
+#define BTRACE_MAGIC       "CSXTRACE"
+#define BTRACE_VERSION     2
+
+static inline uint64_t zigzag_encode (int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t zigzag_decode (uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_refs;
+} btrace_header_t;
+
+/** LEB128 varint, returns its length.  */
+static inline int put_varint (uint8_t *buf, uint64_t v)
+{
+    int len = 0;
+
+    do {
+        buf[len] = v & 0x7f;
+        v >>= 7;
+        if (v)
+            buf[len] |= 0x80;
+        len++;
+    } while (v);
+
+    return len;
+}
+
+/** Encode ref as a version 2 record into buf, at most 20 bytes.  */
+static inline int btrace_pack (const trace_ref_t *ref, paddr_t *prev_addr, uint8_t *buf)
+{
+    uint64_t v = (zigzag_encode ((int64_t)(ref->addr - *prev_addr)) << 2) | ((ref->gap != 0) << 1) | (ref->op == 'w');
+    int len = put_varint (buf, v);
+
+    if (ref->gap)
+        len += put_varint (buf + len, ref->gap);
+    *prev_addr = ref->addr;
+    return len;
+}
+
+/** Fill ref from the leading varint v of a record, true if a gap follows.  */
+static inline bool btrace_unpack (uint64_t v, uint32_t version, paddr_t *prev_addr, trace_ref_t *ref)
+{
+    int flag_bits = (version == 1) ? 1 : 2;
+
+    ref->op = (v & 1) ? 'w' : 'r';
+    ref->gap = 0;
+    ref->addr = *prev_addr + zigzag_decode (v >> flag_bits);
+    *prev_addr = ref->addr;
+    return flag_bits == 2 && (v & 2);
+}
+
+class Binary_trace_reader : public Trace_reader {
+public:
+    Binary_trace_reader (const char *trace_file);
+    ~Binary_trace_reader ();
+
+    const uint8_t *map;
+    size_t map_size;
+
+    const uint8_t *cur;
+    const uint8_t *end;
+    paddr_t prev_addr;
+    uint32_t version;
+
+    uint64_t read_varint (void);
+
+    bool next (trace_ref_t *ref);
+};
+
+/** Reads references out of memory, see Trace_set.  */
+class Buffered_trace_reader : public Trace_reader {
+public:
+    Buffered_trace_reader (const VECTOR<trace_ref_t> *refs);
+
+    const VECTOR<trace_ref_t> *refs;
+    size_t pos;
+
+    bool next (trace_ref_t *ref);
+};
+
+/**
+ * Every core's trace from one directory, decoded once into memory.  It is
+ * read only once built, so the simulations of a protocol sweep share it,
+ * each core of each run walking it with a reader of its own.
+ */
+class Trace_set {
+public:
+    Trace_set (const char *trace_dir, int num_nodes, bool binary_traces);
+
+    VECTOR< VECTOR<trace_ref_t> > refs;
+
+    Trace_reader *reader (int node) const;
+};
+
+class Binary_trace_writer {
+public:
+    Binary_trace_writer (const char *trace_file);
+    ~Binary_trace_writer ();
+
+    FILE *outfile;
+    paddr_t prev_addr;
+    uint64_t num_refs;
+
+    void write (const trace_ref_t *ref);
+};
+
+/**
+ * Reader for a trace file, or for its compressed form if only that is
+ * there, see compress.h.  threaded decompresses on a thread of its own.
+ */
+Trace_reader *open_trace_file (const char *trace_file, bool binary, bool threaded = false);
+
+/** Number of cores, from the config file or else the trace.mtrace in trace_dir.  */
+int read_num_nodes (const char *trace_dir);
+
+/** Reader for core node's pN.trace or pN.btrace file in trace_dir.  */
+Trace_reader *open_trace (const char *trace_dir, int node, bool binary_traces, bool threaded = false);
+
+/** Convert a text trace to the binary format, returns the number of references.  */
+uint64_t convert_trace (const char *text_file, const char *binary_file);
+
+#endif // TRACE_H_
@@ -26,6 +26,9 @@ typedef uint64_t paddr_t;
 typedef uint64_t timestamp_t;
 typedef uint64_t counter_t;
 
+/** Timestamp returned by next_event () when a module has nothing scheduled.  */
+#define NEVER ((timestamp_t) ~0ULL)
+
 class Hash_table;
 class Hash_set;
 class Hash_entry;